@@ -28,8 +28,22 @@
 // Die Funktion "setupFS();" muss im Setup aufgerufen werden.
 /**************************************************************************************/
 
-#include <list>
-#include <tuple>
+#include <coredecls.h>                                                                 // crc32()
+
+#define STATIC_CACHE_SIZE 16                                                           // number of cached file lookups
+#define STATIC_MAX_AGE_ASSETS "max-age=86400"                                          // css, icons: cache for one day
+#define STATIC_MAX_AGE_HTML "no-cache"                                                 // html: always revalidate (ETag)
+
+struct StaticFileEntry {                                                               // cached metadata of a requested path
+  char path[32];                                                                       // requested path, empty = unused
+  bool plain;                                                                          // path exists
+  bool gzip;                                                                           // path + ".gz" exists
+  uint32_t etagPlain;                                                                  // CRC32 of the file content
+  uint32_t etagGzip;
+  uint16_t hits;                                                                       // lookups since caching, the entry with the fewest hits is replaced
+};
+StaticFileEntry staticFileCache[STATIC_CACHE_SIZE + 1];                                // last entry is used for paths too long to cache
+ListEntry listEntries[LIST_MAX_ENTRIES];                                               // sorted listing, reserved once (no heap allocation per request)
 
 const char WARNING[] PROGMEM = R"(<h2>Der Sketch wurde mit "FS:none" kompilliert!)";
 const char HELPER[] PROGMEM = R"(<form method="POST" action="/upload" enctype="multipart/form-data">
@@ -37,63 +51,81 @@ const char HELPER[] PROGMEM = R"(<form method="POST" action="/upload" enctype="m
 
 void setupFS() {                                                                       // Funktionsaufruf "setupFS();" muss im Setup eingebunden werden
   LittleFS.begin();
+  static const char* headerKeys[] = {"If-None-Match", "Accept-Encoding", "Content-Length"};   // headers needed by handleStaticFile() and the uploads
+  server.collectHeaders(headerKeys, 3);
   server.on("/format", formatFS);
-  server.on("/upload", HTTP_POST, sendResponce, handleUpload);
+  server.on("/upload", HTTP_POST, handleUploadResponse, handleUpload);
   server.onNotFound([]() {
     if (!handleFile(server.urlDecode(server.uri())))
       server.send(404, "text/plain", "FileNotFound");
   });
 }
 
-bool handleList() {                                                                    // Senden aller Daten an den Client
+bool handleList() {                                                                    // Senden aller Daten an den Client, als JSON gestreamt (chunked)
   FSInfo fs_info;  LittleFS.info(fs_info);                                             // Füllt FSInfo Struktur mit Informationen über das Dateisystem
-  Dir dir = LittleFS.openDir("/");
-  using namespace std;
-  using records = tuple<String, String, int>;
-  list<records> dirList;
-  while (dir.next()) {                                                                 // Ordner und Dateien zur Liste hinzufügen
-    if (dir.isDirectory()) {
-      uint8_t ran {0};
-      Dir fold = LittleFS.openDir(dir.fileName());
-      while (fold.next())  {
-        ran++;
-        dirList.emplace_back(dir.fileName(), fold.fileName(), fold.fileSize());
+  auto forEachEntry = [](auto visit) {                                                 // Ordner und Dateien durchlaufen, Ordner mit ihrem Inhalt zusammen
+    Dir dir = LittleFS.openDir("/");
+    while (dir.next()) {
+      if (dir.isDirectory()) {
+        bool empty = true;
+        Dir fold = LittleFS.openDir(dir.fileName());
+        while (fold.next())  {
+          empty = false;
+          visit(dir.fileName(), fold.fileName(), fold.fileSize());
+        }
+        if (empty) visit(dir.fileName(), String(), 0);
       }
-      if (!ran) dirList.emplace_back(dir.fileName(), "", 0);
-    }
-    else {
-      dirList.emplace_back("", dir.fileName(), dir.fileSize());
-    }
-  }
-  dirList.sort([](const records & f, const records & l) {                              // Dateien sortieren
-    if (server.arg(0) == "1") {
-      return get<2>(f) > get<2>(l);
-    } else {
-      for (uint8_t i = 0; i < 31; i++) {
-        if (tolower(get<1>(f)[i]) < tolower(get<1>(l)[i])) return true;
-        else if (tolower(get<1>(f)[i]) > tolower(get<1>(l)[i])) return false;
+      else {
+        visit(String(), dir.fileName(), dir.fileSize());
       }
-      return false;
     }
-  });
-  dirList.sort([](const records & f, const records & l) {                              // Ordner sortieren
-    if (get<0>(f)[0] != 0x00 || get<0>(l)[0] != 0x00) {
-      for (uint8_t i = 0; i < 31; i++) {
-          if (tolower(get<0>(f)[i]) < tolower(get<0>(l)[i])) return true;
-          else if (tolower(get<0>(f)[i]) > tolower(get<0>(l)[i])) return false;
+  };
+  char size[16];
+  char buffer[JSON_CHUNK_SIZE];
+  JsonWriter json(buffer, sizeof(buffer), sendJsonChunk);
+  auto writeEntry = [&](const char *folder, const char *name, size_t bytes) {
+    formatBytes(bytes, size, sizeof(size));
+    json.beginObject().member("folder", folder).member("name", name).member("size", size).endObject();
+  };
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  json.beginArray();
+
+  const bool bySize = server.arg("sort") == "1";                                       // 1: nach Größe, sonst nach Name, "none": unsortiert
+  bool sorted = false;
+  if (server.arg("sort") != "none") {                                                  // Einträge in vorab reserviertes Feld fester Größe
+    uint16_t count = 0;
+    bool overflow = false;
+    forEachEntry([&](const String &folder, const String &name, size_t bytes) {
+      if (count >= LIST_MAX_ENTRIES) {
+        overflow = true;
+        return;
       }
+      strlcpy(listEntries[count].folder, folder.c_str(), sizeof(listEntries[count].folder));
+      strlcpy(listEntries[count].name, name.c_str(), sizeof(listEntries[count].name));
+      listEntries[count].size = bytes;
+      count++;
+    });
+    if (!overflow) {
+      sortListEntries(listEntries, count, bySize);                                     // Ordner, dann Dateien sortieren (ein Durchlauf, listentry.h)
+      for (uint16_t i = 0; i < count; i++) writeEntry(listEntries[i].folder, listEntries[i].name, listEntries[i].size);
+      sorted = true;
     }
-    return false;
-  });
-  String temp = "[";
-  for (auto& t : dirList) {
-    if (temp != "[") temp += ',';
-    temp += "{\"folder\":\"" + get<0>(t) + "\",\"name\":\"" + get<1>(t) + "\",\"size\":\"" + formatBytes(get<2>(t)) + "\"}";
   }
-  temp += ",{\"usedBytes\":\"" + formatBytes(fs_info.usedBytes) +                      // Berechnet den verwendeten Speicherplatz
-          "\",\"totalBytes\":\"" + formatBytes(fs_info.totalBytes) +                   // Zeigt die Größe des Speichers
-          "\",\"freeBytes\":\"" + (fs_info.totalBytes - fs_info.usedBytes) + "\"}]";   // Berechnet den freien Speicherplatz
-  server.send(200, "application/json", temp);
+  if (!sorted) {                                                                       // unsortiert direkt aus Dir::next() streamen (auch bei mehr als LIST_MAX_ENTRIES)
+    forEachEntry([&](const String &folder, const String &name, size_t bytes) { writeEntry(folder.c_str(), name.c_str(), bytes); });
+  }
+
+  json.beginObject();
+  formatBytes(fs_info.usedBytes, size, sizeof(size));                                  // Berechnet den verwendeten Speicherplatz
+  json.member("usedBytes", size);
+  formatBytes(fs_info.totalBytes, size, sizeof(size));                                 // Zeigt die Größe des Speichers
+  json.member("totalBytes", size);
+  json.key("freeBytes").valuef("%u", (unsigned int)(fs_info.totalBytes - fs_info.usedBytes));   // Berechnet den freien Speicherplatz
+  json.endObject();
+  json.endArray();
+  json.flush();
+  server.sendContent("");
   return true;
 }
 
@@ -118,35 +150,110 @@ bool handleFile(String &&path) {
   if (server.hasArg("sort")) return handleList();
   if (server.hasArg("delete")) {
     deleteRecursive(server.arg("delete"));
+    invalidateStaticFileCache();
     sendResponce();
     return true;
   }
-  if (!LittleFS.exists("fs.html")) server.send(200, "text/html", LittleFS.begin() ? HELPER : WARNING);     // ermöglicht das hochladen der fs.html
+  if (!staticFileCache[lookupStaticFile(String("/fs.html"))].plain) server.send(200, "text/html", LittleFS.begin() ? HELPER : WARNING);     // ermöglicht das hochladen der fs.html
   if (path.endsWith("/")) path += "index.html";
   if (path == "/spiffs.html") sendResponce(); // Vorrübergehend für den Admin Tab
-  return LittleFS.exists(path) ? ({File f = LittleFS.open(path, "r"); server.streamFile(f, mime::getContentType(path)); f.close(); true;}) : false;
+  return handleStaticFile(path);
+}
+
+bool handleStaticFile(const String &path) {                                            // prefers the .gz sibling, answers If-None-Match with 304
+  const StaticFileEntry &entry = staticFileCache[lookupStaticFile(path)];
+  if (!entry.plain && !entry.gzip) return false;
+  bool useGzip = entry.gzip && (!entry.plain || server.header("Accept-Encoding").indexOf("gzip") >= 0);
+  char etag[12];
+  snprintf(etag, sizeof(etag), "\"%08x\"", (unsigned int)(useGzip ? entry.etagGzip : entry.etagPlain));
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", path.endsWith(".html") ? STATIC_MAX_AGE_HTML : STATIC_MAX_AGE_ASSETS);
+  if (entry.gzip && entry.plain) server.sendHeader("Vary", "Accept-Encoding");
+  if (server.header("If-None-Match") == etag) {                                        // client has the current version
+    server.send(304);
+    return true;
+  }
+  File f = LittleFS.open(useGzip ? path + ".gz" : path, "r");
+  server.streamFile(f, mime::getContentType(path));                                    // adds "Content-Encoding: gzip" for .gz files
+  f.close();
+  return true;
 }
 
-void handleUpload() {                                                                  // Dateien ins Filesystem schreiben
-  static File fsUploadFile;
+uint8_t lookupStaticFile(const String &path) {                                         // index of the metadata of path in staticFileCache
+  uint8_t index = 0;
+  for (uint8_t i = 0; i < STATIC_CACHE_SIZE; i++) {
+    StaticFileEntry &cached = staticFileCache[i];
+    if (cached.path[0] && path == cached.path) {
+      if (++cached.hits == UINT16_MAX) {                                               // age all entries, so old favourites can be replaced
+        for (uint8_t j = 0; j < STATIC_CACHE_SIZE; j++) staticFileCache[j].hits /= 2;
+      }
+      return i;
+    }
+    if (!cached.path[0]) cached.hits = 0;
+    if (cached.hits < staticFileCache[index].hits) index = i;                         // unused or least used entry (/fs.html is looked up on every request and stays)
+  }
+  if (path.length() >= sizeof(staticFileCache[0].path)) index = STATIC_CACHE_SIZE;
+  StaticFileEntry &entry = staticFileCache[index];
+  entry.hits = 1;
+  strncpy(entry.path, path.c_str(), sizeof(entry.path) - 1);
+  entry.path[sizeof(entry.path) - 1] = '\0';
+  entry.plain = LittleFS.exists(path);
+  entry.gzip = LittleFS.exists(path + ".gz");
+  entry.etagPlain = entry.plain ? calcFileETag(path) : 0;
+  entry.etagGzip = entry.gzip ? calcFileETag(path + ".gz") : 0;
+  if (index == STATIC_CACHE_SIZE) entry.path[0] = '\0';
+  return index;
+}
+
+uint32_t calcFileETag(const String &path) {                                            // CRC32 of the file content
+  File f = LittleFS.open(path, "r");
+  if (!f || f.isDirectory()) return 0;
+  uint8_t buffer[256];
+  uint32_t crc = 0xffffffff;
+  int length;
+  while ((length = f.read(buffer, sizeof(buffer))) > 0) {
+    crc = crc32(buffer, length, crc);
+  }
+  f.close();
+  return crc;
+}
+
+void invalidateStaticFileCache() {                                                     // after every change of the filesystem
+  for (auto& entry : staticFileCache) entry.path[0] = '\0';
+}
+
+void handleUpload() {                                                                  // Dateien ins Filesystem schreiben (gepuffert, optional ?md5=<hex>&size=<n> prüfen)
   HTTPUpload& upload = server.upload();
   if (upload.status == UPLOAD_FILE_START) {
     if (upload.filename.length() > 31) {  // Dateinamen kürzen
       upload.filename = upload.filename.substring(upload.filename.length() - 31, upload.filename.length());
     }
-    printf(PSTR("handleFileUpload Name: /%s\n"), upload.filename.c_str());
-    fsUploadFile = LittleFS.open(server.arg(0) + "/" + server.urlDecode(upload.filename), "w");
+    String path = server.arg("f") + "/" + server.urlDecode(upload.filename);
+    logger.logf(LOG_INFO, "Upload file: %s", path.c_str());
+    uploadPipeline.begin(UPLOAD_TARGET_FILE, path.c_str(), server.arg("size").toInt(), server.arg("md5").c_str(), server.header("Content-Length").toInt());
   } else if (upload.status == UPLOAD_FILE_WRITE) {
-    printf(PSTR("handleFileUpload Data: %u\n"), upload.currentSize);
-    fsUploadFile.write(upload.buf, upload.currentSize);
+    uploadPipeline.write(upload.buf, upload.currentSize);
+    showUploadProgress();
   } else if (upload.status == UPLOAD_FILE_END) {
-    printf(PSTR("handleFileUpload Size: %u\n"), upload.totalSize);
-    fsUploadFile.close();
+    if (uploadPipeline.end()) {
+      String path = uploadPipeline.getPath();
+      if (!path.endsWith(".gz")) LittleFS.remove(path + ".gz");                         // a stale compressed version would be served instead
+    }
+    logUploadResult();
+    invalidateStaticFileCache();
+  } else if (upload.status == UPLOAD_FILE_ABORTED) {
+    uploadPipeline.abort();
+    logUploadResult();
   }
 }
-
+void handleUploadResponse() {                                                          // Antwort nach dem Hochladen
+  clearUploadProgress();
+  if (uploadPipeline.getState() == UPLOAD_FAILED) server.send(400, "text/plain", uploadPipeline.getError());
+  else sendResponce();
+}
 void formatFS() {                                                                      // Formatiert das Filesystem
   LittleFS.format();
+  invalidateStaticFileCache();
   sendResponce();
 }
 
@@ -155,6 +262,11 @@ void sendResponce() {
   server.send(303, "message/http");
 }
 
-const String formatBytes(size_t const& bytes) {                                        // lesbare Anzeige der Speichergrößen
-  return bytes < 1024 ? static_cast<String>(bytes) + " Byte" : bytes < 1048576 ? static_cast<String>(bytes / 1024.0) + " KB" : static_cast<String>(bytes / 1048576.0) + " MB";
+void formatBytes(size_t bytes, char *text, size_t size) {                              // lesbare Anzeige der Speichergrößen (zwei Nachkommastellen, gerundet)
+  if (bytes < 1024) snprintf(text, size, "%u Byte", (unsigned int)bytes);
+  else {
+    bool mega = bytes >= 1048576;
+    uint32_t hundredths = ((uint64_t)bytes * 100 + (mega ? 524288 : 512)) >> (mega ? 20 : 10);
+    snprintf(text, size, "%u.%02u %s", (unsigned int)(hundredths / 100), (unsigned int)(hundredths % 100), mega ? "MB" : "KB");
+  }
 }
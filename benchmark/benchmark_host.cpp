@@ -0,0 +1,60 @@
+/**
+ * @file benchmark_host.cpp
+ * @brief Host build of the benchmarks of the hot paths (see benchmarks.h)
+ *
+ * The rendering functions of the sketch are compiled unchanged against the thin mocks in
+ * mock/, the LED rings use the Adafruit NeoPixel driver without output. The results
+ * are in nanoseconds per operation of the host CPU, so they are only comparable between
+ * runs on the same machine.
+ *
+ * Usage: make run [SAMPLES=200]
+ */
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include "../constants.h"
+#include "../udplogger.h"
+#include "../leddrivers.h"
+#include "../ledrings.h"
+#include "../metrics.h"
+#include "../benchmarks.h"
+
+UDPLogger logger;
+Adafruit_NeoPixel outer_ring(OUTER_RING_LED_COUNT, OUTER_RING_LED_PIN, NEO_GRB + NEO_KHZ800);
+Adafruit_NeoPixel inner_ring(INNER_RING_LED_COUNT, INNER_RING_LED_PIN, NEO_GRB + NEO_KHZ800);
+AdafruitNeoPixelDriver outer_ring_driver(&outer_ring);
+AdafruitNeoPixelDriver inner_ring_driver(&inner_ring);
+LEDRings ledrings(&outer_ring_driver, &inner_ring_driver, &logger);
+
+#include "../ringclockfunctions.ino"
+
+static uint32_t readNanoseconds(){
+    return ESP.getCycleCount();
+}
+
+static void printResult(const BenchmarkResult &result){
+    char line[BENCHMARK_LINE_MAX];
+    Benchmarks::formatResult(result, line, sizeof(line));
+    fputs(line, stdout);
+}
+
+int main(int argc, char** argv){
+    long samples = argc > 1 ? atol(argv[1]) : 100;
+    if(samples < 1 || samples > UINT16_MAX){
+        fprintf(stderr, "usage: %s [samples 1-65535]\n", argv[0]);
+        return 2;
+    }
+
+    ledrings.setupRings();
+    ledrings.setBrightnessOuterRing(255);
+    ledrings.setBrightnessInnerRing(255);
+
+    char line[BENCHMARK_LINE_MAX];
+    Benchmarks::formatHeader("ns", line, sizeof(line));
+    fputs(line, stdout);
+    if(!Benchmarks::run(readNanoseconds, samples, printResult)){
+        fprintf(stderr, "not enough memory\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file Adafruit_NeoPixel.h
+ * @brief Thin host mock of the Adafruit NeoPixel library, the pixels are only stored
+ */
+
+#ifndef Adafruit_NeoPixel_h
+#define Adafruit_NeoPixel_h
+
+#include <Arduino.h>
+#include <vector>
+
+#define NEO_GRB 0x52
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel{
+    public:
+        Adafruit_NeoPixel(uint16_t count, int16_t pin, uint16_t type) : _pixels(count) {}
+        void begin() {}
+        uint16_t numPixels() const { return _pixels.size(); }
+        void setBrightness(uint8_t brightness) { _brightness = brightness; }
+        void setPixelColor(uint16_t pixel, uint32_t color) { if(pixel < _pixels.size()) _pixels[pixel] = color; }
+        uint32_t getPixelColor(uint16_t pixel) const { return pixel < _pixels.size() ? _pixels[pixel] : 0; }
+        void clear() { std::fill(_pixels.begin(), _pixels.end(), 0); }
+        bool canShow() { return true; }
+        void show() { _shown++; }
+
+    private:
+        std::vector<uint32_t> _pixels;
+        uint8_t _brightness = 255;
+        uint32_t _shown = 0;
+};
+
+#endif
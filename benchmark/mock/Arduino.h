@@ -0,0 +1,90 @@
+/**
+ * @file Arduino.h
+ * @brief Thin host mock of the Arduino core, only what the benchmarked modules use
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#define PROGMEM
+#define IRAM_ATTR
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#define pgm_read_dword(address) (*(const uint32_t*)(address))
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+template<class T> T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+inline uint16_t word(uint8_t high, uint8_t low) { return high << 8 | low; }
+
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size);
+
+/**
+ * @brief String based on std::string
+ *
+ */
+class String{
+    public:
+        String() {}
+        String(const char* text) : _text(text ? text : "") {}
+        explicit String(int value) : _text(std::to_string(value)) {}
+        explicit String(unsigned int value) : _text(std::to_string(value)) {}
+        explicit String(long value) : _text(std::to_string(value)) {}
+        explicit String(unsigned long value) : _text(std::to_string(value)) {}
+        const char* c_str() const { return _text.c_str(); }
+        unsigned int length() const { return _text.length(); }
+        String& operator+=(const String &other) { _text += other._text; return *this; }
+        friend String operator+(const String &a, const String &b) { String result(a); result += b; return result; }
+        friend String operator+(const char* a, const String &b) { return String(a) + b; }
+        bool operator==(const String &other) const { return _text == other._text; }
+        bool operator!=(const String &other) const { return _text != other._text; }
+        bool equals(const String &other) const { return _text == other._text; }
+
+    private:
+        std::string _text;
+};
+
+#include "IPAddress.h"
+
+class Print{
+    public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t data) = 0;
+        virtual size_t write(const uint8_t* buffer, size_t size);
+        virtual int availableForWrite() { return 0; }
+};
+
+class HardwareSerial : public Print{
+    public:
+        void begin(unsigned long baud) {}
+        size_t write(uint8_t data) override { return 1; }
+        using Print::write;
+        int availableForWrite() override { return 128; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass{
+    public:
+        uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+#endif
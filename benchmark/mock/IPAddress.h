@@ -0,0 +1,25 @@
+/**
+ * @file IPAddress.h
+ * @brief Thin host mock of the IPv4 address of the Arduino core
+ */
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+
+class IPAddress{
+    public:
+        IPAddress() : _address(0) {}
+        IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+        IPAddress(uint32_t address) : _address(address) {}
+        operator uint32_t() const { return _address; }
+        bool operator==(const IPAddress &other) const { return _address == other._address; }
+        bool operator!=(const IPAddress &other) const { return _address != other._address; }
+        bool isSet() const { return _address != 0; }
+
+    private:
+        uint32_t _address;
+};
+
+#endif
@@ -0,0 +1,31 @@
+/**
+ * @file WiFiUdp.h
+ * @brief Thin host mock of the UDP socket, nothing is sent or received
+ */
+
+#ifndef WiFiUdp_h
+#define WiFiUdp_h
+
+#include <Arduino.h>
+
+class UDP{
+    public:
+        virtual ~UDP() {}
+        virtual uint8_t begin(uint16_t port) { return 1; }
+        virtual void stop() {}
+        virtual int beginPacket(IPAddress ip, uint16_t port) { return 1; }
+        virtual int endPacket() { return 1; }
+        virtual size_t write(const uint8_t* buffer, size_t size) { return size; }
+        virtual int parsePacket() { return 0; }
+        virtual int read(unsigned char* buffer, size_t size) { return 0; }
+        virtual void flush() {}
+        virtual IPAddress remoteIP() { return IPAddress(); }
+};
+
+class WiFiUDP : public UDP{
+    public:
+        uint8_t beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port) { return 1; }
+        int beginPacketMulticast(IPAddress multicastAddress, uint16_t port, IPAddress interfaceAddress) { return 1; }
+};
+
+#endif
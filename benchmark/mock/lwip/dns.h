@@ -0,0 +1,21 @@
+/**
+ * @file dns.h
+ * @brief Thin host mock of the lwIP DNS resolver, there is no network
+ */
+
+#ifndef lwip_dns_h
+#define lwip_dns_h
+
+#include <IPAddress.h>
+
+typedef int8_t err_t;
+typedef uint32_t ip_addr_t;
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+inline err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg) { return ERR_ARG; }
+
+#endif
@@ -0,0 +1,58 @@
+#include <Arduino.h>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+unsigned long millis(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms){
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield(){
+}
+
+long random(long max){
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max){
+    return max > min ? min + rand() % (max - min) : min;
+}
+
+extern "C" size_t strlcpy(char* dst, const char* src, size_t size){
+    size_t length = strlen(src);
+    if(size > 0){
+        size_t copy = length < size - 1 ? length : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return length;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size){
+    size_t written = 0;
+    while(size--){
+        written += write(*buffer++);
+    }
+    return written;
+}
+
+/**
+ * @brief Nanoseconds of the steady clock instead of CPU cycles
+ *
+ * @return uint32_t free running counter
+ */
+uint32_t EspClass::getCycleCount(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
@@ -0,0 +1,222 @@
+#include "benchmarks.h"
+#include <new>
+#include <WiFiUdp.h>
+#include "ledrings.h"
+#include "ntp_client_plus.h"
+#include "calendar.h"
+#include "tokenizer.h"
+#include "commands.h"
+#include "listentry.h"
+
+// defined in the sketch (ringclock_esp8266.ino, ringclockfunctions.ino) or the host benchmark
+extern LEDRings ledrings;
+void showMinutes(uint8_t minutes, uint16_t millisOfMinute, uint32_t colorMinutes, uint32_t colorSeconds);
+
+/**
+ * @brief One benchmark case: prepare() is called before each sample (not measured),
+ * operation() batch times per sample with a running index
+ *
+ */
+struct BenchmarkCase {
+    const char* name;
+    uint16_t batch;
+    void (*prepare)(uint16_t sample);
+    void (*operation)(uint32_t index);
+};
+
+static const uint32_t benchmarkColorMinutes = 0xFFC000;
+static const uint32_t benchmarkColorSeconds = 0x0040FF;
+static const char benchmarkCommands[] = "col_hours=255-0-0&col_minutes=0-255-0&col_seconds=0-0-255&setting=22-0-7-0-100-120&ledoff=0";
+static const char* const benchmarkFolders[] = {"css", "img", "Data", "js"};
+
+// state of the cases, only allocated while the benchmarks run
+static WiFiUDP* benchmarkUDP = nullptr;
+static NTPClientPlus* benchmarkNTP = nullptr;
+static ListEntry* benchmarkEntries = nullptr;
+static uint64_t benchmarkEpochMillis = 0;       // 29. Mar. 2026 00:00 UTC, the day of the DST change
+static volatile uint32_t benchmarkSink = 0;     // results of the operations, so they are not optimized away
+
+static void prepareNone(uint16_t sample){
+}
+
+static void benchmarkInterpolateColor(uint32_t index){
+    benchmarkSink += LEDRingsBase::interpolateColor24bit(0xFF2000 + (index & 0xFF), 0x0020FF, (index & 63) / 64.0f);
+}
+
+static void benchmarkShowMinutes(uint32_t index){
+    showMinutes((index / 7) % 60, (index * 997) % 60000, benchmarkColorMinutes, benchmarkColorSeconds);
+}
+
+static void prepareNextMinute(uint16_t sample){
+    showMinutes(sample % 60, 0, benchmarkColorMinutes, benchmarkColorSeconds);
+}
+
+static void benchmarkDrawSmooth(uint32_t index){
+    ledrings.drawOnRingsSmooth(0.1f);
+}
+
+static void benchmarkDrawInstant(uint32_t index){
+    ledrings.drawOnRingsInstant();
+}
+
+static void prepareTimeRestored(uint16_t sample){
+    benchmarkNTP->restoreTime(benchmarkEpochMillis, 0, 0);
+    benchmarkNTP->calcDate();
+    benchmarkNTP->updateSWChange();
+}
+
+static void benchmarkCalcDateCached(uint32_t index){
+    benchmarkNTP->calcDate();
+}
+
+static void benchmarkCalcDateNewDay(uint32_t index){
+    benchmarkNTP->restoreTime(benchmarkEpochMillis + (uint64_t)(index % 4000) * 86400000ULL, 0, 0);
+    benchmarkNTP->calcDate();
+}
+
+static void benchmarkSWChangeCached(uint32_t index){
+    benchmarkSink += benchmarkNTP->updateSWChange();
+}
+
+static void benchmarkSWChangeNewYear(uint32_t index){
+    benchmarkNTP->restoreTime(benchmarkEpochMillis + (uint64_t)(index % 40) * 366 * 86400000ULL, 0, 0);
+    benchmarkSink += benchmarkNTP->updateSWChange();
+}
+
+static void benchmarkParseCommands(uint32_t index){
+    char buffer[sizeof(benchmarkCommands)];
+    memcpy(buffer, benchmarkCommands, sizeof(benchmarkCommands));
+    PendingCommands commands;
+    CommandParser::clear(commands);
+    const char* failedCommand = "";
+    CommandParser parser(nullptr);
+    benchmarkSink += parser.parseList(commands, buffer, sizeof(benchmarkCommands) - 1, &failedCommand);
+}
+
+static void benchmarkTokenize(uint32_t index){
+    char buffer[sizeof(benchmarkCommands)];
+    memcpy(buffer, benchmarkCommands, sizeof(benchmarkCommands));
+    Tokenizer tokenizer(buffer);
+    while(char* command = tokenizer.next("&")){
+        benchmarkSink += command[0];
+    }
+}
+
+static void prepareListEntries(uint16_t sample){
+    // same pseudo random listing for every sample
+    uint32_t state = 0x2545F491;
+    for(uint16_t i = 0; i < LIST_MAX_ENTRIES; i++){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        ListEntry &entry = benchmarkEntries[i];
+        uint8_t folder = state % 10;
+        strlcpy(entry.folder, folder < 4 ? benchmarkFolders[folder] : "", sizeof(entry.folder));
+        snprintf(entry.name, sizeof(entry.name), (state & 0x100) ? "File%05lu.json" : "icon%05lu.png", (unsigned long)(state >> 16) % 100000);
+        entry.size = state >> 12;
+    }
+}
+
+static void benchmarkSortByName(uint32_t index){
+    sortListEntries(benchmarkEntries, LIST_MAX_ENTRIES, false);
+}
+
+static void benchmarkSortBySize(uint32_t index){
+    sortListEntries(benchmarkEntries, LIST_MAX_ENTRIES, true);
+}
+
+static const BenchmarkCase benchmarkCases[] = {
+    {"interpolateColor24bit", 64, prepareNone, benchmarkInterpolateColor},
+    {"showMinutes", 60, prepareNone, benchmarkShowMinutes},
+    {"drawOnRingsSmooth", 1, prepareNextMinute, benchmarkDrawSmooth},
+    {"drawOnRingsInstant", 1, prepareNextMinute, benchmarkDrawInstant},
+    {"calcDate (cached)", 64, prepareTimeRestored, benchmarkCalcDateCached},
+    {"calcDate (new day)", 64, prepareTimeRestored, benchmarkCalcDateNewDay},
+    {"updateSWChange (cached)", 64, prepareTimeRestored, benchmarkSWChangeCached},
+    {"updateSWChange (new year)", 64, prepareTimeRestored, benchmarkSWChangeNewYear},
+    {"CommandParser::parseList", 16, prepareNone, benchmarkParseCommands},
+    {"Tokenizer::next", 16, prepareNone, benchmarkTokenize},
+    {"sort list by name", 1, prepareListEntries, benchmarkSortByName},
+    {"sort list by size", 1, prepareListEntries, benchmarkSortBySize},
+};
+
+/**
+ * @brief Run all benchmark cases, blocks until all are done
+ *
+ * @param clock free running counter for the measurement
+ * @param samples number of measured samples per case
+ * @param report called with the result of each case
+ * @return true if all cases were run, false if there is not enough memory
+ */
+bool Benchmarks::run(BenchmarkClock clock, uint16_t samples, BenchmarkReport report){
+    benchmarkUDP = new (std::nothrow) WiFiUDP();
+    benchmarkNTP = benchmarkUDP ? new (std::nothrow) NTPClientPlus(*benchmarkUDP, "pool.ntp.org", 1, true) : nullptr;
+    benchmarkEntries = new (std::nothrow) ListEntry[LIST_MAX_ENTRIES];
+    bool ready = benchmarkUDP && benchmarkNTP && benchmarkEntries && samples > 0;
+
+    benchmarkEpochMillis = (uint64_t)Calendar::daysFromCivil(2026, 3, 29) * 86400000ULL;
+    uint32_t index = 0;
+    for(uint8_t i = 0; ready && i < getCaseCount(); i++){
+        const BenchmarkCase &benchmarkCase = benchmarkCases[i];
+        uint32_t minTicks = UINT32_MAX;
+        uint32_t maxTicks = 0;
+        uint64_t sumTicks = 0;
+        for(uint16_t sample = 0; sample < samples; sample++){
+            benchmarkCase.prepare(sample);
+            uint32_t start = clock();
+            for(uint16_t operation = 0; operation < benchmarkCase.batch; operation++){
+                benchmarkCase.operation(index++);
+            }
+            uint32_t ticks = (clock() - start) / benchmarkCase.batch;
+            sumTicks += ticks;
+            if(ticks < minTicks) minTicks = ticks;
+            if(ticks > maxTicks) maxTicks = ticks;
+            // keep the watchdog and the WiFi stack alive on the ESP8266
+            yield();
+        }
+        BenchmarkResult result = {benchmarkCase.name, samples, benchmarkCase.batch, minTicks, (uint32_t)(sumTicks / samples), maxTicks};
+        report(result);
+    }
+
+    delete[] benchmarkEntries;
+    delete benchmarkNTP;
+    delete benchmarkUDP;
+    benchmarkEntries = nullptr;
+    benchmarkNTP = nullptr;
+    benchmarkUDP = nullptr;
+    return ready;
+}
+
+/**
+ * @brief Get the number of benchmark cases
+ *
+ * @return uint8_t number of cases
+ */
+uint8_t Benchmarks::getCaseCount(){
+    return sizeof(benchmarkCases) / sizeof(benchmarkCases[0]);
+}
+
+/**
+ * @brief Format the header line of the result table
+ *
+ * @param unit unit of the clock ticks, e.g. "cycles"
+ * @param buffer buffer for the line (incl. newline)
+ * @param size size of the buffer (BENCHMARK_LINE_MAX)
+ * @return int length of the line (like snprintf)
+ */
+int Benchmarks::formatHeader(const char* unit, char* buffer, size_t size){
+    return snprintf(buffer, size, "%-26s %7s %5s %10s %10s %10s  (%s/op)\n", "case", "samples", "batch", "min", "avg", "max", unit);
+}
+
+/**
+ * @brief Format the result of one case as line of the result table
+ *
+ * @param result result of the case
+ * @param buffer buffer for the line (incl. newline)
+ * @param size size of the buffer (BENCHMARK_LINE_MAX)
+ * @return int length of the line (like snprintf)
+ */
+int Benchmarks::formatResult(const BenchmarkResult &result, char* buffer, size_t size){
+    return snprintf(buffer, size, "%-26s %7u %5u %10lu %10lu %10lu\n", result.name, result.samples, result.batch,
+                    (unsigned long)result.minTicks, (unsigned long)result.avgTicks, (unsigned long)result.maxTicks);
+}
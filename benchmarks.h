@@ -0,0 +1,47 @@
+/**
+ * @file benchmarks.h
+ * @brief Microbenchmarks of the hot paths (rendering, calendar, command parsing, file listing)
+ *
+ * The same cases run on the ESP8266 ("/benchmark" with BENCHMARK_ENABLED, CPU cycles from
+ * ESP.getCycleCount()) and on the host (benchmark/, nanoseconds from the steady clock),
+ * so a regression of the render loop shows up before the firmware is flashed.
+ *
+ * Each case is measured in samples of a fixed batch of operations, the results are per
+ * operation. The maximum is usually the first sample (cold flash cache on the ESP8266).
+ * The rendering cases draw on the global LED rings, so the clock shows a short flicker
+ * on the device.
+ */
+
+#ifndef benchmarks_h
+#define benchmarks_h
+
+#include <Arduino.h>
+
+#define BENCHMARK_LINE_MAX 96           // maximum length of one formatted result line
+
+/**
+ * @brief Result of one benchmark case, times per operation in ticks of the clock
+ *
+ */
+struct BenchmarkResult {
+    const char* name;
+    uint16_t samples;                   // measured samples
+    uint16_t batch;                     // operations per sample
+    uint32_t minTicks;
+    uint32_t avgTicks;
+    uint32_t maxTicks;
+};
+
+typedef uint32_t (*BenchmarkClock)();   // free running counter, e.g. ESP.getCycleCount()
+typedef void (*BenchmarkReport)(const BenchmarkResult &result);
+
+class Benchmarks{
+
+    public:
+        static bool run(BenchmarkClock clock, uint16_t samples, BenchmarkReport report);
+        static uint8_t getCaseCount();
+        static int formatHeader(const char* unit, char* buffer, size_t size);
+        static int formatResult(const BenchmarkResult &result, char* buffer, size_t size);
+};
+
+#endif
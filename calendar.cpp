@@ -0,0 +1,124 @@
+#include "calendar.h"
+
+/**
+ * @brief Convert a date to the number of days since 1. Jan. 1970
+ * 
+ * @param year year
+ * @param month month (1-12)
+ * @param day day of month (1-31)
+ * @return int32_t days since 1. Jan. 1970 (negative before)
+ */
+int32_t Calendar::daysFromCivil(int16_t year, uint8_t month, uint8_t day){
+    int32_t y = year - (month <= 2);
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);                                   // [0, 399]
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // [0, 365]
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                       // [0, 146096]
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+/**
+ * @brief Convert the number of days since 1. Jan. 1970 to a date
+ * 
+ * @param days days since 1. Jan. 1970
+ * @return CivilDate date
+ */
+CivilDate Calendar::civilFromDays(int32_t days){
+    days += 719468;
+    int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(days - era * 146097);                             // [0, 146096]
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;       // [0, 399]
+    int32_t y = (int32_t)yoe + era * 400;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                     // [0, 365]
+    uint32_t mp = (5 * doy + 2) / 153;                                          // [0, 11]
+    CivilDate date;
+    date.day = doy - (153 * mp + 2) / 5 + 1;
+    date.month = mp < 10 ? mp + 3 : mp - 9;
+    date.year = y + (date.month <= 2);
+    return date;
+}
+
+/**
+ * @brief Get the weekday of a day
+ * 
+ * @param days days since 1. Jan. 1970
+ * @return uint8_t weekday (Monday = 1 ... Sunday = 7)
+ */
+uint8_t Calendar::weekdayFromDays(int32_t days){
+    // 1. Jan. 1970 was a thursday
+    return ((days + 3) % 7 + 7) % 7 + 1;
+}
+
+/**
+ * @brief Check if a year is a leap year
+ * 
+ * @param year year
+ * @return true leap year
+ * @return false no leap year
+ */
+bool Calendar::isLeapYear(int16_t year){
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+/**
+ * @brief Get the day of the year of a date
+ * 
+ * @param date date
+ * @return uint16_t day of year (1-366)
+ */
+uint16_t Calendar::dayOfYear(const CivilDate &date){
+    return daysFromCivil(date.year, date.month, date.day) - daysFromCivil(date.year, 1, 1) + 1;
+}
+
+/**
+ * @brief Get the last Sunday of a month
+ * 
+ * @param year year
+ * @param month month (1-12)
+ * @return int32_t days since 1. Jan. 1970
+ */
+int32_t Calendar::lastSundayOfMonth(int16_t year, uint8_t month){
+    int32_t lastDay = month == 12 ? daysFromCivil(year + 1, 1, 1) - 1 : daysFromCivil(year, month + 1, 1) - 1;
+    return lastDay - weekdayFromDays(lastDay) % 7;
+}
+
+/**
+ * @brief Get the n-th Sunday of a month
+ * 
+ * @param year year
+ * @param month month (1-12)
+ * @param n number of the Sunday (1 = first)
+ * @return int32_t days since 1. Jan. 1970
+ */
+int32_t Calendar::nthSundayOfMonth(int16_t year, uint8_t month, uint8_t n){
+    int32_t firstDay = daysFromCivil(year, month, 1);
+    int32_t firstSunday = firstDay + (7 - weekdayFromDays(firstDay)) % 7;
+    return firstSunday + 7 * (n - 1);
+}
+
+/**
+ * @brief Calculate the transitions of the daylight saving time of a year
+ * 
+ * @param rule daylight saving time rule
+ * @param year year
+ * @param standardOffset offset of the standard time to UTC in seconds (used by local time rules)
+ * @param start UTC epoch seconds of the begin of the daylight saving time
+ * @param end UTC epoch seconds of the end of the daylight saving time
+ * @return true rule has daylight saving time
+ * @return false no daylight saving time
+ */
+bool Calendar::calcDSTTransitions(DSTRule rule, int16_t year, long standardOffset, uint32_t &start, uint32_t &end){
+    switch(rule){
+        case DST_EU:
+            start = lastSundayOfMonth(year, 3) * 86400UL + 3600;
+            end = lastSundayOfMonth(year, 10) * 86400UL + 3600;
+            return true;
+        case DST_US:
+            // 02:00 local standard time / 02:00 local daylight time
+            start = nthSundayOfMonth(year, 3, 2) * 86400UL + 7200 - standardOffset;
+            end = nthSundayOfMonth(year, 11, 1) * 86400UL + 7200 - (standardOffset + 3600);
+            return true;
+        default:
+            return false;
+    }
+}
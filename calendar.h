@@ -0,0 +1,49 @@
+/**
+ * @file calendar.h
+ * @brief Closed-form civil calendar and daylight saving time rules
+ * 
+ * All conversions are O(1) (no loops over days or years), based on the 
+ * days_from_civil/civil_from_days algorithms of Howard Hinnant 
+ * (http://howardhinnant.github.io/date_algorithms.html). Days are counted 
+ * since 1. Jan. 1970, weekday numbering is Monday = 1 ... Sunday = 7.
+ */
+
+#ifndef calendar_h
+#define calendar_h
+
+#include <Arduino.h>
+
+/**
+ * @brief Daylight saving time rules
+ * 
+ */
+enum DSTRule {
+    DST_NONE,                           // no daylight saving time
+    DST_EU,                             // last Sunday of March 01:00 UTC - last Sunday of October 01:00 UTC
+    DST_US                              // second Sunday of March 02:00 local - first Sunday of November 02:00 local
+};
+
+/**
+ * @brief Date of the proleptic gregorian calendar
+ * 
+ */
+struct CivilDate {
+    int16_t year;
+    uint8_t month;                      // 1-12
+    uint8_t day;                        // 1-31
+};
+
+class Calendar{
+
+    public:
+        static int32_t daysFromCivil(int16_t year, uint8_t month, uint8_t day);
+        static CivilDate civilFromDays(int32_t days);
+        static uint8_t weekdayFromDays(int32_t days);
+        static bool isLeapYear(int16_t year);
+        static uint16_t dayOfYear(const CivilDate &date);
+        static int32_t lastSundayOfMonth(int16_t year, uint8_t month);
+        static int32_t nthSundayOfMonth(int16_t year, uint8_t month, uint8_t n);
+        static bool calcDSTTransitions(DSTRule rule, int16_t year, long standardOffset, uint32_t &start, uint32_t &end);
+};
+
+#endif
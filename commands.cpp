@@ -0,0 +1,116 @@
+#include "commands.h"
+#include "tokenizer.h"
+#include "fleet.h"
+#include "telemetry.h"
+
+/**
+ * @brief Construct a new CommandParser
+ * 
+ * @param logger logger for the parsed commands (LOG_DEBUG), may be nullptr
+ */
+CommandParser::CommandParser(UDPLogger *logger){
+    this->logger = logger;
+}
+
+/**
+ * @brief Reset the collected commands
+ * 
+ * @param commands collected commands
+ */
+void CommandParser::clear(PendingCommands &commands){
+    memset(&commands, 0, sizeof(commands));
+}
+
+/**
+ * @brief Parse a list of commands (e.g. "col_hours=255-0-0&ledoff=1", separated by '&' or 
+ * newlines) in place and collect them with parse()
+ * 
+ * @param commands collected commands
+ * @param text commands, is modified, text[length] has to be writable
+ * @param length length of the text
+ * @param failedCommand set to the name of the first unknown or invalid command
+ * @return true all commands are valid
+ * @return false at least one command is unknown or invalid
+ */
+bool CommandParser::parseList(PendingCommands &commands, char *text, size_t length, const char **failedCommand){
+    Tokenizer list(text, length);
+    char *command;
+    while((command = list.next("&\n")) != nullptr){
+        if(command[0] == '\0') continue;
+        Tokenizer parts(command);
+        char *name = parts.next("=");
+        char *value = parts.hasNext() ? parts.next("") : name + strlen(name);
+        if(!parse(commands, name, value)){
+            *failedCommand = name;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Validate one command and collect it
+ * 
+ * @param commands collected commands
+ * @param name name of the command (e.g. "col_hours")
+ * @param value value of the command (e.g. "255-0-0"), is modified
+ * @return true command is valid
+ * @return false unknown command or invalid value
+ */
+bool CommandParser::parse(PendingCommands &commands, const char *name, char *value){
+    long numbers[6];
+    if(logger != nullptr){
+        logger->logf(LOG_DEBUG, "Command %s: %s", name, value);
+    }
+    if(strcmp(name, "col_hours") == 0 || strcmp(name, "col_minutes") == 0 || strcmp(name, "col_seconds") == 0){
+        // color for hours, minutes or seconds
+        uint8_t ring = name[4] == 'h' ? 0 : (name[4] == 'm' ? 1 : 2);
+        if(Tokenizer::parseNumbers(value, '-', numbers, 3) != 3) return false;
+        for(uint8_t i = 0; i < 3; i++){
+            if(numbers[i] < 0 || numbers[i] > 255) return false;
+            commands.colors[ring][i] = numbers[i];
+        }
+        commands.colorMask |= (1 << ring);
+    }
+    else if(strcmp(name, "ledoff") == 0){
+        commands.hasLedOff = true;
+        commands.ledOff = strcmp(value, "1") == 0;
+    }
+    else if(strcmp(name, "setting") == 0){
+        if(Tokenizer::parseNumbers(value, '-', numbers, 6) != 6) return false;
+        for(uint8_t i = 0; i < 6; i++){
+            commands.setting[i] = constrain(numbers[i], 0L, 255L);
+        }
+        commands.hasSetting = true;
+    }
+    else if(strcmp(name, "telemetry") == 0){
+        // period of the telemetry packets in ms, 0 = off
+        char *valueEnd;
+        commands.telemetryPeriod = strtol(value, &valueEnd, 10);
+        if(valueEnd == value || *valueEnd != '\0' || commands.telemetryPeriod < 0 || commands.telemetryPeriod > TELEMETRY_PERIOD_MAX) return false;
+        commands.hasTelemetry = true;
+    }
+    else if(strcmp(name, "timesync") == 0){
+        // mode of the time beacons: off, auto, leader, follower
+        uint8_t mode = 0;
+        while(mode < TIMESYNC_MODE_COUNT && strcmp(value, TimeBeacon::getModeName((TimeSyncMode)mode)) != 0) mode++;
+        if(mode == TIMESYNC_MODE_COUNT) return false;
+        commands.timeSyncMode = (TimeSyncMode)mode;
+        commands.hasTimeSync = true;
+    }
+    else if(strcmp(name, "group") == 0){
+        // group for the bulk configuration (0..31)
+        char *valueEnd;
+        long group = strtol(value, &valueEnd, 10);
+        if(valueEnd == value || *valueEnd != '\0' || group < 0 || group >= FLEET_GROUP_COUNT) return false;
+        commands.group = group;
+        commands.hasGroup = true;
+    }
+    else if(strcmp(name, "resetwifi") == 0){
+        commands.resetWifi = true;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
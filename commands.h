@@ -0,0 +1,49 @@
+/**
+ * @file commands.h
+ * @brief Parsing and validation of the commands of "/cmd", the WebSocket and the bulk 
+ * configuration (e.g. "col_hours=255-0-0&ledoff=1")
+ * 
+ * All commands of one request are collected in PendingCommands and only executed 
+ * (by the sketch) after every command is valid, so a request is applied atomically.
+ */
+
+#ifndef commands_h
+#define commands_h
+
+#include <Arduino.h>
+#include "udplogger.h"
+#include "timebeacon.h"
+
+/**
+ * @brief Commands of one request, collected by CommandParser
+ * 
+ */
+struct PendingCommands {
+    uint8_t colorMask;                  // bit 0: hours, bit 1: minutes, bit 2: seconds
+    uint8_t colors[3][3];               // rgb of hours, minutes, seconds
+    bool hasLedOff;
+    bool ledOff;
+    bool hasSetting;
+    uint8_t setting[6];                 // night mode start h/m, end h/m, brightness inner/outer ring
+    bool hasTelemetry;
+    long telemetryPeriod;
+    bool hasTimeSync;
+    TimeSyncMode timeSyncMode;
+    bool hasGroup;
+    uint8_t group;
+    bool resetWifi;
+};
+
+class CommandParser{
+
+    public:
+        CommandParser(UDPLogger *logger);
+        static void clear(PendingCommands &commands);
+        bool parseList(PendingCommands &commands, char *text, size_t length, const char **failedCommand);
+        bool parse(PendingCommands &commands, const char *name, char *value);
+
+    private:
+        UDPLogger *logger;
+};
+
+#endif
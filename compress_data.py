@@ -0,0 +1,74 @@
+"""
+Create gzip compressed copies of the web assets in the data/ folder.
+
+Run this script before uploading the data folder to the RingClock
+(Tools -> ESP8266 LittleFS Data Upload). The webserver prefers the .gz
+version of a file if the browser accepts gzip, which reduces the
+transferred size of index.html and style.css to about a fifth.
+
+The compression is deterministic (no timestamp in the header), so
+unchanged files keep their ETag after a new upload.
+
+Usage:
+    python compress_data.py                     # create/update the .gz files
+    python compress_data.py --remove-originals  # keep only the .gz files (saves flash)
+    python compress_data.py --clean             # remove all .gz files
+"""
+
+import argparse
+import gzip
+import os
+
+DATA_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'data')
+COMPRESS_EXTENSIONS = ('.html', '.css', '.js', '.svg', '.json')
+# fs.html is needed uncompressed, the webserver checks its existence to offer the file manager
+KEEP_ORIGINAL = ('fs.html',)
+
+
+def compress_file(path):
+    """Write path.gz, returns (original size, compressed size) or None if compression does not pay off"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    compressed = gzip.compress(data, compresslevel=9, mtime=0)
+    if len(compressed) >= len(data):
+        return None
+    with open(path + '.gz', 'wb') as f:
+        f.write(compressed)
+    return len(data), len(compressed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--remove-originals', action='store_true', help='delete the uncompressed files after compressing')
+    parser.add_argument('--clean', action='store_true', help='delete all .gz files')
+    args = parser.parse_args()
+
+    total_before = total_after = 0
+    for root, _, files in os.walk(DATA_DIR):
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            relpath = os.path.relpath(path, DATA_DIR)
+            if args.clean:
+                if name.endswith('.gz'):
+                    os.remove(path)
+                    print('removed', relpath)
+                continue
+            if not name.endswith(COMPRESS_EXTENSIONS):
+                continue
+            result = compress_file(path)
+            if result is None:
+                print('%-30s not compressed (no gain)' % relpath)
+                continue
+            before, after = result
+            total_before += before
+            total_after += after
+            print('%-30s %7d -> %7d bytes' % (relpath, before, after))
+            if args.remove_originals and name not in KEEP_ORIGINAL:
+                os.remove(path)
+
+    if not args.clean and total_before:
+        print('total %d -> %d bytes (%.0f%%)' % (total_before, total_after, 100.0 * total_after / total_before))
+
+
+if __name__ == '__main__':
+    main()
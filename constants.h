@@ -1,28 +1,64 @@
 #define OUTER_RING_LED_COUNT 91
 #define INNER_RING_LED_COUNT 12
+#define OUTER_RING_LED_OFFSET -5    // physical LED which shows pixel 0 of the outer ring
+#define INNER_RING_LED_OFFSET 0     // physical LED which shows pixel 0 of the inner ring
 #define OUTER_RING_LED_PIN 4
 #define INNER_RING_LED_PIN 5
-#define CURRENT_LIMIT_LED 1000
+
+// LED output drivers of the rings
+#define LED_DRIVER_ADAFRUIT 0       // bit-banged via Adafruit NeoPixel on OUTER_RING_LED_PIN/INNER_RING_LED_PIN (blocking)
+#define LED_DRIVER_ASYNC_UART1 1    // asynchronous via NeoPixelBus on UART1 (fixed pin GPIO2/D4)
+#define LED_DRIVER_ASYNC_DMA 2      // asynchronous via NeoPixelBus on I2S-DMA (fixed pin GPIO3/RX)
+#define OUTER_RING_LED_DRIVER LED_DRIVER_ADAFRUIT
+#define INNER_RING_LED_DRIVER LED_DRIVER_ADAFRUIT
+#define CURRENT_LIMIT_LED 1000      // in mA
+
+// calibration of LED current estimation (in µA)
+#define LED_CURRENT_RED_UA 20000        // red channel at full brightness
+#define LED_CURRENT_GREEN_UA 20000      // green channel at full brightness
+#define LED_CURRENT_BLUE_UA 20000       // blue channel at full brightness
+#define LED_CURRENT_QUIESCENT_UA 1000   // quiescent current of one LED
+
+#define LED_GAMMA_CORRECTION true       // apply gamma correction to the colors of the LEDs
+#define LED_DITHERING true              // use temporal dithering for smooth colors at low brightness
 
 #define PERIOD_HEARTBEAT 10000
 #define PERIOD_NTP_UPDATE 60000
-#define PERIOD_CLOCK_UPDATE 20
-#define PERIOD_LED_UPDATE 10
+#define PERIOD_NTP_POLL 2         // poll period for the NTP reply (reception time is part of the round trip measurement)
+#define PERIOD_LED_UPDATE 10        // minimum frame period (full frame rate during transitions and dithering)
+#define PERIOD_FRAME_MAX 250        // maximum frame period while the rings are settled
+#define FRAME_MAX_LEVEL_STEP 4      // output levels the fastest element of the clock face may advance per frame
+#define PERIOD_IDLE_MAX 5           // maximum time loop() sleeps while waiting for the next frame
 #define PERIOD_NIGHTMODE_CHECK 20000
+#define PERIOD_HANDLE_OTA 5
+#define PERIOD_HANDLE_HTTP 5
+#define PERIOD_TELEMETRY 1000       // period of the binary telemetry packets (0 = off), can be changed via /cmd?telemetry=<ms>
+#define PERIOD_STATE_PUSH 250         // period of checking the state for changes which are pushed to the WebSocket clients
+#define PERIOD_LOG_FLUSH 20          // period of sending the buffered log messages (UDP and Serial)
+#define PERIOD_SETTINGS_COMMIT 1000  // period of checking for changed settings to write to flash (see settings.h)
+#define PERIOD_UPLOAD_PROGRESS 200   // period of updating the upload progress on the outer ring
+#define PERIOD_POWER_CHECK 1000      // period of checking if the clock can go to POWER_SLEEP
+#define PERIOD_SLEEP_POLL 100        // period of the webserver, OTA, WebSocket and log tasks in POWER_SLEEP
+#define POWER_WAKE_HOLD 10000        // time the clock stays out of POWER_SLEEP after a HTTP request
+#define PERIOD_RTC_SNAPSHOT 1000     // period of writing the snapshot of time base and display mode to the RTC user memory
+#define PERIOD_MULTICAST_POLL 5     // period of checking for time beacons of other clocks (reception time is the sync point)
+#define PERIOD_WIFI_CHECK 100        // period of checking the WiFi connection (and handling the WiFi setup portal)
+
+// shared key of the signed bulk configuration via multicast (see fleet.h and fleet_config.py), empty: disabled
+#define FLEET_KEY ""
+
+// boot
+#define FASTBOOT_ENABLED true           // connect in one shot with the cached BSSID, channel and IP configuration of the last connection
+#define FASTBOOT_CONNECT_TIMEOUT 4000   // time for the one shot connection, then the cache is dropped and the normal connection (scan, DHCP) is used
+#define WIFI_CONNECT_TIMEOUT 20000      // time for the normal connection, then the WiFi setup portal is started (in the background)
+#define BOOT_LED_TEST true              // show the LED test after power on
+#define BOOT_SHOW_IP true               // show the last digits of the IP address after power on
+
+// instrumentation of the hot paths via "/metrics" (see metrics.h), 0: compiled out completely
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
 
-#define EEPROM_SIZE 30      // size of EEPROM to save persistent variables
-#define ADR_NM_START_H 0
-#define ADR_NM_END_H 4
-#define ADR_NM_START_M 8
-#define ADR_NM_END_M 12
-#define ADR_BRIGHTNESS_OUTER 16
-#define ADR_BRIGHTNESS_INNER 17
-#define ADR_CS_RED 18
-#define ADR_CS_GREEN 19
-#define ADR_CS_BLUE 20
-#define ADR_CM_RED 21
-#define ADR_CM_GREEN 22
-#define ADR_CM_BLUE 23
-#define ADR_CH_RED 24
-#define ADR_CH_GREEN 25
-#define ADR_CH_BLUE 26
+// on-device benchmarks of the hot paths via "/benchmark" (see benchmarks.h), blocks the clock for about one second per request
+#define BENCHMARK_ENABLED false
+#define BENCHMARK_SAMPLES 32            // measured samples per benchmark case
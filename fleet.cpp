@@ -0,0 +1,221 @@
+#include "fleet.h"
+#include <Crypto.h>
+
+Fleet::Fleet(){
+}
+
+/**
+ * @brief Set the id of this clock and the key for the signature of the config messages
+ * 
+ * @param id unique id (e.g. ESP.getChipId())
+ * @param key shared key (empty: config messages are rejected)
+ */
+void Fleet::begin(uint32_t id, const char* key){
+    _id = id;
+    _key = key;
+}
+
+void Fleet::setGroup(uint8_t group){
+    _group = group < FLEET_GROUP_COUNT ? group : 0;
+}
+
+uint8_t Fleet::getGroup() const{
+    return _group;
+}
+
+/**
+ * @brief Handle a received datagram of the multicast group
+ * 
+ * @param data datagram, the commands of a config message are kept in it (see getCommands())
+ * @param length length of the datagram
+ * @param timeValid own time is valid
+ * @param utcEpochMillis own time (UTC epoch ms)
+ * @return FleetRequest request to answer
+ */
+FleetRequest Fleet::handlePacket(uint8_t* data, size_t length, bool timeValid, uint64_t utcEpochMillis){
+    if(length < sizeof(FleetHeader)){
+        return FLEET_REQUEST_NONE;
+    }
+    FleetHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(header.magic != FLEET_MAGIC || header.version != FLEET_VERSION){
+        return FLEET_REQUEST_NONE;
+    }
+    bool addressed = (header.targetId == 0 || header.targetId == _id) && (header.groupMask & (1UL << _group));
+    if(!addressed){
+        return FLEET_REQUEST_NONE;
+    }
+
+    _nonce = header.nonce;
+    if(header.type == FLEET_DISCOVER){
+        return FLEET_REQUEST_DISCOVER;
+    }
+    if(header.type != FLEET_CONFIG){
+        return FLEET_REQUEST_NONE;
+    }
+    _status = checkConfig(data, length, timeValid, utcEpochMillis);
+    return _status == FLEET_STATUS_OK ? FLEET_REQUEST_CONFIG : FLEET_REQUEST_REJECTED;
+}
+
+/**
+ * @brief Get the commands of the last accepted config message (not terminated, see getCommandsLength())
+ * 
+ * @return char* commands in the packet buffer, may be modified (e.g. by the tokenizer)
+ */
+char* Fleet::getCommands() const{
+    return _commands;
+}
+
+size_t Fleet::getCommandsLength() const{
+    return _commandsLength;
+}
+
+/**
+ * @brief Get the result of the check of the last config message
+ * 
+ */
+FleetStatus Fleet::getStatus() const{
+    return _status;
+}
+
+/**
+ * @brief Write the answer to a discover request
+ * 
+ * @param buffer buffer for the packet
+ * @param size size of the buffer
+ * @param announce information about this clock
+ * @return size_t length of the packet (0 if the buffer is too small)
+ */
+size_t Fleet::buildAnnounce(uint8_t* buffer, size_t size, const FleetAnnounce &announce){
+    if(size < sizeof(FleetHeader) + sizeof(FleetAnnounce)){
+        return 0;
+    }
+    writeHeader(buffer, FLEET_ANNOUNCE);
+    memcpy(buffer + sizeof(FleetHeader), &announce, sizeof(announce));
+    return sizeof(FleetHeader) + sizeof(FleetAnnounce);
+}
+
+/**
+ * @brief Write the answer to a config message
+ * 
+ * @param buffer buffer for the packet
+ * @param size size of the buffer
+ * @param status result
+ * @return size_t length of the packet (0 if the buffer is too small)
+ */
+size_t Fleet::buildAck(uint8_t* buffer, size_t size, FleetStatus status){
+    if(size < sizeof(FleetHeader) + sizeof(FleetAck)){
+        return 0;
+    }
+    FleetAck ack = {};
+    ack.id = _id;
+    ack.status = status;
+    ack.group = _group;
+    writeHeader(buffer, FLEET_ACK);
+    memcpy(buffer + sizeof(FleetHeader), &ack, sizeof(ack));
+    return sizeof(FleetHeader) + sizeof(FleetAck);
+}
+
+/**
+ * @brief Get the name of the status
+ * 
+ * @param status status
+ * @return const char* name
+ */
+const char* Fleet::getStatusName(FleetStatus status){
+    switch(status){
+        case FLEET_STATUS_OK: return "ok";
+        case FLEET_STATUS_INVALID: return "invalid";
+        case FLEET_STATUS_AUTH: return "wrong signature";
+        case FLEET_STATUS_EXPIRED: return "expired";
+        case FLEET_STATUS_REPLAY: return "replayed";
+        case FLEET_STATUS_DISABLED: return "disabled";
+        default: return "no time";
+    }
+}
+
+/**
+ * @brief Restore the replay protection after a restart (from the snapshot in the RTC user memory)
+ * 
+ * @param timestampMillis value of getReplayFloor() before the restart
+ */
+void Fleet::restoreReplayFloor(uint64_t timestampMillis){
+    _lastTimestamp = timestampMillis > _lastTimestamp ? timestampMillis : _lastTimestamp;
+    _replayFloorKnown = true;
+}
+
+/**
+ * @brief Get the timestamp config messages have to be newer than: the last accepted one. 
+ * Without restored value (power on), messages captured before the boot are rejected by 
+ * starting with the time of the boot + FLEET_CONFIG_MAX_AGE. Should be saved regularly.
+ * 
+ * @param utcEpochMillis current time (UTC epoch ms), has to be valid
+ * @return uint64_t timestamp (UTC epoch ms)
+ */
+uint64_t Fleet::getReplayFloor(uint64_t utcEpochMillis){
+    if(!_replayFloorKnown){
+        uint64_t floor = utcEpochMillis - millis() + FLEET_CONFIG_MAX_AGE;
+        _lastTimestamp = floor > _lastTimestamp ? floor : _lastTimestamp;
+        _replayFloorKnown = true;
+    }
+    return _lastTimestamp;
+}
+
+/**
+ * @brief (private) Check length, signature and time of a config message
+ * 
+ */
+FleetStatus Fleet::checkConfig(uint8_t* data, size_t length, bool timeValid, uint64_t utcEpochMillis){
+    if(_key[0] == '\0'){
+        return FLEET_STATUS_DISABLED;
+    }
+    if(length < sizeof(FleetHeader) + sizeof(FleetConfig) + FLEET_HMAC_SIZE){
+        return FLEET_STATUS_INVALID;
+    }
+    FleetConfig config;
+    memcpy(&config, data + sizeof(FleetHeader), sizeof(config));
+    size_t signedLength = sizeof(FleetHeader) + sizeof(FleetConfig) + config.length;
+    if(signedLength + FLEET_HMAC_SIZE != length){
+        // also truncated datagrams
+        return FLEET_STATUS_INVALID;
+    }
+
+    // compare in constant time
+    uint8_t hmac[FLEET_HMAC_SIZE];
+    experimental::crypto::SHA256::hmac(data, signedLength, _key, strlen(_key), hmac, sizeof(hmac));
+    uint8_t difference = 0;
+    for(uint8_t i = 0; i < FLEET_HMAC_SIZE; i++){
+        difference |= hmac[i] ^ data[signedLength + i];
+    }
+    if(difference != 0){
+        return FLEET_STATUS_AUTH;
+    }
+
+    if(!timeValid){
+        return FLEET_STATUS_NO_TIME;
+    }
+    int64_t age = (int64_t)(utcEpochMillis - config.timestampMillis);
+    if(age > FLEET_CONFIG_MAX_AGE || age < -FLEET_CONFIG_MAX_AGE){
+        return FLEET_STATUS_EXPIRED;
+    }
+    if(config.timestampMillis <= getReplayFloor(utcEpochMillis)){
+        return FLEET_STATUS_REPLAY;
+    }
+    _lastTimestamp = config.timestampMillis;
+    _commands = (char*)(data + sizeof(FleetHeader) + sizeof(FleetConfig));
+    _commandsLength = config.length;
+    return FLEET_STATUS_OK;
+}
+
+/**
+ * @brief (private) Header of an answer, addressed to the tool with the nonce of its request
+ * 
+ */
+void Fleet::writeHeader(uint8_t* buffer, FleetMessageType type) const{
+    FleetHeader header = {};
+    header.magic = FLEET_MAGIC;
+    header.version = FLEET_VERSION;
+    header.type = type;
+    header.nonce = _nonce;
+    memcpy(buffer, &header, sizeof(header));
+}
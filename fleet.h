@@ -0,0 +1,129 @@
+/**
+ * @file fleet.h
+ * @brief Discovery and bulk configuration of several clocks via the multicast group of the UDPLogger
+ * 
+ * A tool (fleet_config.py) sends a FLEET_DISCOVER request, every clock answers with a 
+ * FLEET_ANNOUNCE. A FLEET_CONFIG message contains a list of commands in the format of "/cmd" 
+ * (e.g. "col_hours=255-0-0&setting=22-0-7-0-100-120"), which every addressed clock applies 
+ * atomically and confirms with a FLEET_ACK. Config messages are signed with HMAC-SHA256 
+ * with the shared key FLEET_KEY and carry the time of the tool, they are only accepted 
+ * within FLEET_CONFIG_MAX_AGE of the own time and only once (replay protection). The replay 
+ * protection survives restarts via the RTC user memory (see rtcstate.h), after a power on 
+ * only messages sent after boot + FLEET_CONFIG_MAX_AGE are accepted.
+ * 
+ * The clocks read datagrams up to FLEET_PACKET_MAX bytes, so the commands of one config 
+ * message are limited to FLEET_COMMANDS_MAX (198) bytes. Longer messages are truncated 
+ * and rejected as FLEET_STATUS_INVALID.
+ * 
+ * The packets have a fixed little endian layout without padding and start with the same 
+ * byte as the telemetry packet (invalid in UTF-8), see telemetry.h. All answers are sent 
+ * to the multicast group.
+ */
+
+#ifndef fleet_h
+#define fleet_h
+
+#include <Arduino.h>
+
+#define FLEET_MAGIC 0xC3AB              // sent as bytes 0xAB 0xC3
+#define FLEET_VERSION 1
+#define FLEET_HMAC_SIZE 32              // HMAC-SHA256
+#define FLEET_CONFIG_MAX_AGE 300000     // maximum difference (ms) between the time of a config message and the own time
+#define FLEET_GROUP_COUNT 32            // groups 0..31, selected by the bits of groupMask
+#define FLEET_NAME_MAX 24
+#define FLEET_PACKET_MAX 256            // maximum length of a received datagram (incl. header and HMAC)
+#define FLEET_COMMANDS_MAX 198          // maximum length of the commands of a config message (see static_assert below)
+
+enum FleetMessageType {
+    FLEET_DISCOVER = 1,             // tool -> clocks: request for FLEET_ANNOUNCE
+    FLEET_ANNOUNCE = 2,             // clock -> tool: id, group, hostname, version
+    FLEET_CONFIG = 3,               // tool -> clocks: signed list of commands
+    FLEET_ACK = 4                   // clock -> tool: result of a FLEET_CONFIG
+};
+
+enum FleetStatus {
+    FLEET_STATUS_OK,
+    FLEET_STATUS_INVALID,           // malformed message or invalid command
+    FLEET_STATUS_AUTH,              // wrong signature
+    FLEET_STATUS_EXPIRED,           // time of the message too far from the own time
+    FLEET_STATUS_REPLAY,            // message not newer than the last accepted one (or the boot, see getReplayFloor())
+    FLEET_STATUS_DISABLED,          // no FLEET_KEY configured
+    FLEET_STATUS_NO_TIME            // own time not valid yet
+};
+
+enum FleetRequest {
+    FLEET_REQUEST_NONE,             // no fleet message, or not addressed to this clock
+    FLEET_REQUEST_DISCOVER,         // answer with buildAnnounce()
+    FLEET_REQUEST_CONFIG,           // apply getCommands(), answer with buildAck()
+    FLEET_REQUEST_REJECTED          // config rejected, answer with buildAck(getStatus())
+};
+
+struct __attribute__((packed)) FleetHeader {
+    uint16_t magic;                 // FLEET_MAGIC
+    uint8_t  version;               // FLEET_VERSION
+    uint8_t  type;                  // FleetMessageType
+    uint32_t targetId;              // chip id of the addressed clock, 0 = all
+    uint32_t groupMask;             // bit n addresses the clocks of group n
+    uint32_t nonce;                 // chosen by the tool, copied into the answers
+};
+
+struct __attribute__((packed)) FleetAnnounce {
+    uint32_t id;                    // chip id
+    uint8_t  group;
+    uint8_t  ntpHealth;             // NTPHealth
+    uint8_t  timeSyncMode;          // TimeSyncMode
+    uint8_t  flags;                 // TELEMETRY_FLAG_* (see telemetry.h)
+    uint32_t uptime;                // ms
+    uint32_t settingsCommits;       // flash writes of the settings since boot
+    char     hostname[FLEET_NAME_MAX];
+    char     build[FLEET_NAME_MAX];
+};
+
+struct __attribute__((packed)) FleetConfig {
+    uint64_t timestampMillis;       // time of the tool (UTC epoch ms), increasing with every message
+    uint16_t length;                // length of the commands, followed by the commands and the HMAC
+};
+
+static_assert(sizeof(FleetHeader) + sizeof(FleetConfig) + FLEET_COMMANDS_MAX + FLEET_HMAC_SIZE == FLEET_PACKET_MAX, 
+              "FLEET_COMMANDS_MAX has to fill FLEET_PACKET_MAX");
+
+struct __attribute__((packed)) FleetAck {
+    uint32_t id;                    // chip id
+    uint8_t  status;                // FleetStatus
+    uint8_t  group;
+    uint16_t reserved;
+};
+
+class Fleet{
+
+    public:
+        Fleet();
+        void begin(uint32_t id, const char* key);
+        void setGroup(uint8_t group);
+        uint8_t getGroup() const;
+        FleetRequest handlePacket(uint8_t* data, size_t length, bool timeValid, uint64_t utcEpochMillis);
+        char* getCommands() const;
+        size_t getCommandsLength() const;
+        FleetStatus getStatus() const;
+        size_t buildAnnounce(uint8_t* buffer, size_t size, const FleetAnnounce &announce);
+        size_t buildAck(uint8_t* buffer, size_t size, FleetStatus status);
+        static const char* getStatusName(FleetStatus status);
+        void restoreReplayFloor(uint64_t timestampMillis);
+        uint64_t getReplayFloor(uint64_t utcEpochMillis);
+
+    private:
+        FleetStatus checkConfig(uint8_t* data, size_t length, bool timeValid, uint64_t utcEpochMillis);
+        void writeHeader(uint8_t* buffer, FleetMessageType type) const;
+
+        uint32_t _id = 0;
+        const char* _key = "";
+        uint8_t _group = 0;
+        uint32_t _nonce = 0;                // nonce of the current request
+        uint64_t _lastTimestamp = 0;        // timestamp of the last accepted config (or the replay floor after boot)
+        bool _replayFloorKnown = false;     // _lastTimestamp restored or initialized from the time of the boot
+        char* _commands = nullptr;          // commands of the current config (in the packet buffer)
+        size_t _commandsLength = 0;
+        FleetStatus _status = FLEET_STATUS_OK;
+};
+
+#endif
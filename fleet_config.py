@@ -0,0 +1,155 @@
+"""
+Discover the RingClocks in the local network and configure all of them (or a group)
+with one multicast message (protocol see fleet.h).
+
+The config messages are signed with HMAC-SHA256, the key has to match FLEET_KEY in
+constants.h of the clocks. The clocks only accept a message within 5 minutes of their
+own time, so the clock of this computer has to be synchronized as well.
+
+Usage:
+    python fleet_config.py discover
+    python fleet_config.py config "col_hours=255-0-0&setting=22-0-7-0-100-120" --key <key>
+    python fleet_config.py config "col_seconds=0-0-255" --group 1 --group 2 --key <key>
+    python fleet_config.py config "group=3" --id 00a1b2c3 --key <key>
+
+The key can also be set with the environment variable RINGCLOCK_FLEET_KEY.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import random
+import socket
+import struct
+import time
+
+MULTICAST_GROUP = '230.120.10.2'
+MULTICAST_PORT = 8123
+
+FLEET_MAGIC = 0xC3AB
+FLEET_VERSION = 1
+FLEET_DISCOVER = 1
+FLEET_ANNOUNCE = 2
+FLEET_CONFIG = 3
+FLEET_ACK = 4
+
+HEADER_FORMAT = '<HBBIII'          # magic, version, type, targetId, groupMask, nonce
+ANNOUNCE_FORMAT = '<IBBBBII24s24s'  # id, group, ntpHealth, timeSyncMode, flags, uptime, settingsCommits, hostname, build
+CONFIG_FORMAT = '<QH'              # timestampMillis, length
+ACK_FORMAT = '<IBBH'               # id, status, group, reserved
+
+STATUS_NAMES = ['ok', 'invalid', 'wrong signature', 'expired', 'replayed', 'disabled', 'no time']
+NTP_HEALTH_NAMES = ['unsynced', 'synced', 'degraded', 'free running']
+TIMESYNC_NAMES = ['off', 'auto', 'leader', 'follower']
+
+COMMANDS_MAX = 198                 # FLEET_COMMANDS_MAX, the clocks read datagrams up to 256 bytes
+
+
+def open_socket(interface):
+    """Socket which sends to and receives from the multicast group"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('', MULTICAST_PORT))
+    mreq = struct.pack('4s4s', socket.inet_aton(MULTICAST_GROUP), socket.inet_aton(interface))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(interface))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    return sock
+
+
+def header(message_type, target_id, group_mask, nonce):
+    return struct.pack(HEADER_FORMAT, FLEET_MAGIC, FLEET_VERSION, message_type, target_id, group_mask, nonce)
+
+
+def receive_answers(sock, message_type, nonce, timeout):
+    """Collect the answers of the given type to the request with the nonce"""
+    header_size = struct.calcsize(HEADER_FORMAT)
+    deadline = time.time() + timeout
+    while True:
+        remaining = deadline - time.time()
+        if remaining <= 0:
+            return
+        sock.settimeout(remaining)
+        try:
+            data, address = sock.recvfrom(1024)
+        except socket.timeout:
+            return
+        if len(data) < header_size:
+            continue
+        magic, version, answer_type, _, _, answer_nonce = struct.unpack_from(HEADER_FORMAT, data)
+        if magic == FLEET_MAGIC and version == FLEET_VERSION and answer_type == message_type and answer_nonce == nonce:
+            yield data[header_size:], address
+
+
+def discover(sock, args):
+    nonce = random.getrandbits(32)
+    sock.sendto(header(FLEET_DISCOVER, 0, 0xFFFFFFFF, nonce), (MULTICAST_GROUP, MULTICAST_PORT))
+    count = 0
+    for payload, address in receive_answers(sock, FLEET_ANNOUNCE, nonce, args.timeout):
+        if len(payload) < struct.calcsize(ANNOUNCE_FORMAT):
+            continue
+        (clock_id, group, ntp_health, timesync, flags, uptime, commits,
+         hostname, build) = struct.unpack_from(ANNOUNCE_FORMAT, payload)
+        count += 1
+        print('%08x  %-16s %-20s group %2d  ntp %-12s timesync %-8s uptime %6ds  build %s' % (
+            clock_id, address[0], hostname.rstrip(b'\0').decode(), group,
+            NTP_HEALTH_NAMES[ntp_health] if ntp_health < len(NTP_HEALTH_NAMES) else ntp_health,
+            TIMESYNC_NAMES[timesync] if timesync < len(TIMESYNC_NAMES) else timesync,
+            uptime // 1000, build.rstrip(b'\0').decode()))
+    print('%d clock(s) found' % count)
+
+
+def config(sock, args):
+    if not args.key:
+        raise SystemExit('no key given (--key or RINGCLOCK_FLEET_KEY)')
+    commands = args.commands.encode()
+    if len(commands) > COMMANDS_MAX:
+        raise SystemExit('commands too long (%d bytes, the clocks accept up to %d bytes per message), '
+                         'split them into several messages' % (len(commands), COMMANDS_MAX))
+    group_mask = 0
+    for group in args.group or []:
+        group_mask |= 1 << group
+    if not group_mask:
+        group_mask = 0xFFFFFFFF
+    target_id = int(args.id, 16) if args.id else 0
+    nonce = random.getrandbits(32)
+
+    message = header(FLEET_CONFIG, target_id, group_mask, nonce)
+    message += struct.pack(CONFIG_FORMAT, int(time.time() * 1000), len(commands)) + commands
+    message += hmac.new(args.key.encode(), message, hashlib.sha256).digest()
+    sock.sendto(message, (MULTICAST_GROUP, MULTICAST_PORT))
+
+    count = 0
+    for payload, address in receive_answers(sock, FLEET_ACK, nonce, args.timeout):
+        if len(payload) < struct.calcsize(ACK_FORMAT):
+            continue
+        clock_id, status, group, _ = struct.unpack_from(ACK_FORMAT, payload)
+        count += 1
+        print('%08x  %-16s group %2d  %s' % (clock_id, address[0], group,
+              STATUS_NAMES[status] if status < len(STATUS_NAMES) else status))
+    print('%d clock(s) answered' % count)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Discover and configure RingClocks via multicast')
+    parser.add_argument('--interface', default='0.0.0.0', help='ip address of the network interface')
+    parser.add_argument('--timeout', type=float, default=2.0, help='time to wait for the answers (s)')
+    commands = parser.add_subparsers(dest='command', required=True)
+    commands.add_parser('discover', help='list all clocks')
+    config_parser = commands.add_parser('config', help='send commands (format of /cmd) to all clocks or a group')
+    config_parser.add_argument('commands', help='e.g. "col_hours=255-0-0&setting=22-0-7-0-100-120"')
+    config_parser.add_argument('--group', type=int, action='append', choices=range(32), help='only clocks of this group (repeatable)')
+    config_parser.add_argument('--id', help='only the clock with this id (hex, see discover)')
+    config_parser.add_argument('--key', default=os.environ.get('RINGCLOCK_FLEET_KEY'), help='FLEET_KEY of the clocks')
+    args = parser.parse_args()
+
+    sock = open_socket(args.interface)
+    if args.command == 'discover':
+        discover(sock, args)
+    else:
+        config(sock, args)
+
+
+if __name__ == '__main__':
+    main()
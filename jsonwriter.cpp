@@ -0,0 +1,230 @@
+#include "jsonwriter.h"
+
+/**
+ * @brief Construct a new JsonWriter
+ * 
+ * @param buffer output buffer
+ * @param size size of the buffer
+ * @param flushFunction called with the buffer content when the buffer is full and on flush(), 
+ * nullptr: the document has to fit into the buffer (see hasOverflowed())
+ */
+JsonWriter::JsonWriter(char* buffer, size_t size, JsonFlushFunction flushFunction){
+    _buffer = buffer;
+    _size = size;
+    _flushFunction = flushFunction;
+}
+
+JsonWriter& JsonWriter::beginObject(){
+    beginContainer('{');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginObject(const char* name){
+    return key(name).beginObject();
+}
+
+JsonWriter& JsonWriter::endObject(){
+    endContainer('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(){
+    beginContainer('[');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* name){
+    return key(name).beginArray();
+}
+
+JsonWriter& JsonWriter::endArray(){
+    endContainer(']');
+    return *this;
+}
+
+/**
+ * @brief Write the key of the next member of an object
+ * 
+ * @param name key
+ */
+JsonWriter& JsonWriter::key(const char* name){
+    separator();
+    write('"');
+    writeEscaped(name);
+    write("\":", 2);
+    _afterKey = true;
+    return *this;
+}
+
+/**
+ * @brief Write a string value (escaped)
+ * 
+ */
+JsonWriter& JsonWriter::value(const char* text){
+    separator();
+    write('"');
+    writeEscaped(text);
+    write('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long number){
+    char digits[24];
+    separator();
+    write(digits, snprintf(digits, sizeof(digits), "%ld", number));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned long number){
+    char digits[24];
+    separator();
+    write(digits, snprintf(digits, sizeof(digits), "%lu", number));
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int number){
+    return value((long)number);
+}
+
+JsonWriter& JsonWriter::value(unsigned int number){
+    return value((unsigned long)number);
+}
+
+JsonWriter& JsonWriter::value(bool flag){
+    separator();
+    if(flag) write("true", 4);
+    else write("false", 5);
+    return *this;
+}
+
+/**
+ * @brief Write a printf-style formatted string value (not escaped, max. 63 characters)
+ * 
+ */
+JsonWriter& JsonWriter::valuef(const char* format, ...){
+    char text[64];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if(length >= (int)sizeof(text)) length = sizeof(text) - 1;
+    separator();
+    write('"');
+    write(text, length);
+    write('"');
+    return *this;
+}
+
+/**
+ * @brief Pass the buffered text to the flush function
+ * 
+ */
+void JsonWriter::flush(){
+    if(_flushFunction && _length > 0){
+        _flushFunction(_buffer, _length);
+        _length = 0;
+    }
+}
+
+/**
+ * @brief Get the buffered text (without flush function: the complete document)
+ * 
+ * @return const char* null terminated text
+ */
+const char* JsonWriter::c_str(){
+    _buffer[_length < _size ? _length : _size - 1] = '\0';
+    return _buffer;
+}
+
+size_t JsonWriter::length() const{
+    return _length;
+}
+
+/**
+ * @brief Check if text was lost because the buffer was full and no flush function is set, 
+ * or because the nesting exceeded JSON_MAX_DEPTH
+ * 
+ */
+bool JsonWriter::hasOverflowed() const{
+    return _overflow;
+}
+
+/**
+ * @brief (private) Insert a comma before the second and following members of a container
+ * 
+ */
+void JsonWriter::separator(){
+    if(_afterKey){
+        _afterKey = false;
+        return;
+    }
+    if(_hasMembers & (1 << _depth)){
+        write(',');
+    }
+    _hasMembers |= (1 << _depth);
+}
+
+/**
+ * @brief (private) Open an object or array. Beyond JSON_MAX_DEPTH the member bits would be 
+ * shared with the outer container, so the container is not written and the writer overflows
+ * 
+ */
+void JsonWriter::beginContainer(char bracket){
+    separator();
+    if(_excessDepth > 0 || _depth >= JSON_MAX_DEPTH - 1){
+        _excessDepth++;
+        _overflow = true;
+        return;
+    }
+    write(bracket);
+    _depth++;
+    _hasMembers &= ~(1 << _depth);
+}
+
+/**
+ * @brief (private) Close an object or array opened with beginContainer()
+ * 
+ */
+void JsonWriter::endContainer(char bracket){
+    if(_excessDepth > 0){
+        _excessDepth--;
+        return;
+    }
+    write(bracket);
+    if(_depth > 0) _depth--;
+}
+
+void JsonWriter::write(char c){
+    // one byte is kept free for the terminating null of c_str()
+    if(_length + 1 >= _size){
+        flush();
+        if(_length + 1 >= _size){
+            _overflow = true;
+            return;
+        }
+    }
+    _buffer[_length++] = c;
+}
+
+void JsonWriter::write(const char* text, size_t length){
+    for(size_t i = 0; i < length; i++){
+        write(text[i]);
+    }
+}
+
+void JsonWriter::writeEscaped(const char* text){
+    for(; *text; text++){
+        char c = *text;
+        if(c == '"' || c == '\\'){
+            write('\\');
+            write(c);
+        }
+        else if((uint8_t)c < 0x20){
+            char escaped[7];
+            write(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", c));
+        }
+        else {
+            write(c);
+        }
+    }
+}
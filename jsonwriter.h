@@ -0,0 +1,63 @@
+/**
+ * @file jsonwriter.h
+ * @brief Small streaming JSON writer without heap allocation
+ * 
+ * The JSON text is written into a caller provided (stack) buffer. If a flush function is 
+ * given, the buffer is passed to it whenever it is full, so documents of any size can be 
+ * sent in chunks (e.g. with chunked transfer encoding). Commas between members are 
+ * inserted automatically.
+ */
+
+#ifndef jsonwriter_h
+#define jsonwriter_h
+
+#include <Arduino.h>
+
+#define JSON_MAX_DEPTH 8            // maximum nesting of objects and arrays (deeper ones are not written, see hasOverflowed())
+
+typedef void (*JsonFlushFunction)(const char* data, size_t length);
+
+class JsonWriter{
+
+    public:
+        JsonWriter(char* buffer, size_t size, JsonFlushFunction flushFunction = nullptr);
+        JsonWriter& beginObject();
+        JsonWriter& beginObject(const char* key);
+        JsonWriter& endObject();
+        JsonWriter& beginArray();
+        JsonWriter& beginArray(const char* key);
+        JsonWriter& endArray();
+        JsonWriter& key(const char* key);
+        JsonWriter& value(const char* value);
+        JsonWriter& value(long value);
+        JsonWriter& value(unsigned long value);
+        JsonWriter& value(int value);
+        JsonWriter& value(unsigned int value);
+        JsonWriter& value(bool value);
+        JsonWriter& valuef(const char* format, ...) __attribute__((format(printf, 2, 3)));
+        template <class T> JsonWriter& member(const char* name, T memberValue) { return key(name).value(memberValue); }
+        void flush();
+        const char* c_str();
+        size_t length() const;
+        bool hasOverflowed() const;
+
+    private:
+        void separator();
+        void beginContainer(char bracket);
+        void endContainer(char bracket);
+        void write(char c);
+        void write(const char* text, size_t length);
+        void writeEscaped(const char* text);
+
+        char* _buffer;
+        size_t _size;
+        size_t _length = 0;
+        JsonFlushFunction _flushFunction;
+        uint8_t _depth = 0;
+        uint8_t _hasMembers = 0;    // bit n: current container at depth n already has a member
+        uint8_t _excessDepth = 0;   // containers beyond JSON_MAX_DEPTH which were not written
+        bool _afterKey = false;
+        bool _overflow = false;
+};
+
+#endif
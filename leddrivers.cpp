@@ -0,0 +1,71 @@
+#include "leddrivers.h"
+
+/**
+ * @brief Construct a new output driver for an Adafruit NeoPixel strip
+ * 
+ * @param strip Adafruit NeoPixel object of the ring
+ */
+AdafruitNeoPixelDriver::AdafruitNeoPixelDriver(Adafruit_NeoPixel *strip){
+    this->strip = strip;
+}
+
+/**
+ * @brief Initialize the output pin of the strip
+ * 
+ */
+void AdafruitNeoPixelDriver::begin(){
+    strip->begin();
+}
+
+/**
+ * @brief Get the number of pixels of the strip
+ * 
+ * @return uint16_t number of pixels
+ */
+uint16_t AdafruitNeoPixelDriver::numPixels(){
+    return strip->numPixels();
+}
+
+/**
+ * @brief Set the brightness of the strip
+ * 
+ * @param brightness brightness value (0-255)
+ */
+void AdafruitNeoPixelDriver::setBrightness(uint8_t brightness){
+    strip->setBrightness(brightness);
+}
+
+/**
+ * @brief Set the color of one pixel
+ * 
+ * @param pixel pixel number
+ * @param color 24bit color value
+ */
+void AdafruitNeoPixelDriver::setPixelColor(uint16_t pixel, uint32_t color){
+    strip->setPixelColor(pixel, color);
+}
+
+/**
+ * @brief Set all pixels to black
+ * 
+ */
+void AdafruitNeoPixelDriver::clear(){
+    strip->clear();
+}
+
+/**
+ * @brief Check if the latch time of the previous frame is over
+ * 
+ * @return true if a new frame can be shown without waiting
+ */
+bool AdafruitNeoPixelDriver::canShow(){
+    return strip->canShow();
+}
+
+/**
+ * @brief Send the pixel data to the LEDs (blocking)
+ * 
+ */
+void AdafruitNeoPixelDriver::show(){
+    strip->show();
+}
@@ -0,0 +1,115 @@
+/**
+ * @file leddrivers.h
+ * @brief Output drivers which push the pixel data of one LED ring to the LEDs
+ * 
+ * LEDRings only talks to the abstract LEDOutputDriver, so the way how the data 
+ * is sent to the LEDs can be chosen per ring:
+ * - AdafruitNeoPixelDriver: bit-banged output via Adafruit NeoPixel library (blocking, 
+ *   interrupts are disabled while sending), works on any pin
+ * - NeoPixelBusDriver: asynchronous output via NeoPixelBus library (UART1 on GPIO2 
+ *   or I2S-DMA on GPIO3), the frame is sent in the background while loop() continues
+ */
+
+#ifndef leddrivers_h
+#define leddrivers_h
+
+#include <Adafruit_NeoPixel.h>          // NeoPixel library used to run the NeoPixel LEDs
+#include "constants.h"
+
+#if OUTER_RING_LED_DRIVER != LED_DRIVER_ADAFRUIT || INNER_RING_LED_DRIVER != LED_DRIVER_ADAFRUIT
+#include <NeoPixelBus.h>                // https://github.com/Makuna/NeoPixelBus (only needed for asynchronous drivers)
+#endif
+
+/**
+ * @brief Interface of an output driver for one LED ring
+ * 
+ */
+class LEDOutputDriver{
+    public:
+        virtual ~LEDOutputDriver() {}
+        virtual void begin() = 0;
+        virtual uint16_t numPixels() = 0;
+        virtual void setBrightness(uint8_t brightness) = 0;
+        virtual void setPixelColor(uint16_t pixel, uint32_t color) = 0;
+        virtual void clear() = 0;
+        // returns true if the previous frame is completely sent and a new frame can be shown
+        virtual bool canShow() = 0;
+        virtual void show() = 0;
+};
+
+/**
+ * @brief Output driver based on the bit-banged Adafruit NeoPixel library
+ * 
+ */
+class AdafruitNeoPixelDriver : public LEDOutputDriver{
+    public:
+        AdafruitNeoPixelDriver(Adafruit_NeoPixel *strip);
+        void begin();
+        uint16_t numPixels();
+        void setBrightness(uint8_t brightness);
+        void setPixelColor(uint16_t pixel, uint32_t color);
+        void clear();
+        bool canShow();
+        void show();
+
+    private:
+        Adafruit_NeoPixel *strip;
+};
+
+#if OUTER_RING_LED_DRIVER != LED_DRIVER_ADAFRUIT || INNER_RING_LED_DRIVER != LED_DRIVER_ADAFRUIT
+/**
+ * @brief Asynchronous output driver based on the NeoPixelBus library
+ * 
+ * The method defines the hardware which is used, e.g.:
+ * - NeoEsp8266AsyncUart1Ws2812xMethod (UART1, GPIO2)
+ * - NeoEsp8266DmaWs2812xMethod (I2S-DMA, GPIO3)
+ * 
+ * Show() only hands the frame over to the background encoder, the brightness 
+ * is applied in software as NeoPixelBus has no global brightness.
+ * 
+ * @tparam T_METHOD NeoPixelBus method
+ */
+template<typename T_METHOD> class NeoPixelBusDriver : public LEDOutputDriver{
+    public:
+        NeoPixelBusDriver(uint16_t countPixels) : strip(countPixels), brightness(255) {}
+
+        void begin(){
+            strip.Begin();
+        }
+
+        uint16_t numPixels(){
+            return strip.PixelCount();
+        }
+
+        void setBrightness(uint8_t brightness){
+            this->brightness = brightness;
+        }
+
+        void setPixelColor(uint16_t pixel, uint32_t color){
+            // scale brightness the same way as the Adafruit library does
+            uint16_t scale = brightness + 1;
+            uint8_t red = (((color >> 16) & 0xFF) * scale) >> 8;
+            uint8_t green = (((color >> 8) & 0xFF) * scale) >> 8;
+            uint8_t blue = ((color & 0xFF) * scale) >> 8;
+            strip.SetPixelColor(pixel, RgbColor(red, green, blue));
+        }
+
+        void clear(){
+            strip.ClearTo(RgbColor(0, 0, 0));
+        }
+
+        bool canShow(){
+            return strip.CanShow();
+        }
+
+        void show(){
+            strip.Show();
+        }
+
+    private:
+        NeoPixelBus<NeoGrbFeature, T_METHOD> strip;
+        uint8_t brightness;
+};
+#endif
+
+#endif
@@ -1,12 +1,74 @@
 #include "ledrings.h"
-
-LEDRings::LEDRings(Adafruit_NeoPixel *outerRing, Adafruit_NeoPixel *innerRing, UDPLogger *logger){
+#include "metrics.h"
+
+// gamma correction table (gamma 2.2) from 8bit color value to 16bit output value:
+// gammaTable[i] = round((i/255)^2.2 * 65535)
+const uint16_t gammaTable[256] PROGMEM = {
+        0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,
+       79,    94,   111,   129,   148,   169,   192,   216,   242,   270,   299,   330,
+      362,   396,   432,   469,   508,   549,   591,   635,   681,   729,   779,   830,
+      883,   938,   995,  1053,  1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+     1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,  2334,  2427,  2521,  2618,
+     2717,  2817,  2920,  3024,  3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,
+     4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,  5115,  5257,  5401,  5547,
+     5695,  5845,  5998,  6152,  6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+     7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,  9111,  9305,  9501,  9699,
+     9900, 10102, 10307, 10515, 10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254,
+    12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140, 14386, 14635, 14885, 15138,
+    15394, 15652, 15912, 16174, 16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+    18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694, 20996, 21301, 21609, 21919,
+    22231, 22546, 22863, 23182, 23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826,
+    26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627, 28988, 29351, 29717, 30086,
+    30457, 30830, 31206, 31585, 31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+    35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981, 38402, 38825, 39252, 39680,
+    40112, 40546, 40982, 41421, 41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025,
+    45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793, 49275, 49761, 50249, 50739,
+    51232, 51728, 52226, 52727, 53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+    57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097, 61642, 62190, 62741, 63295,
+    63851, 64410, 64971, 65535
+};
+
+template<class OUTER, class INNER>
+LEDRingsT<OUTER, INNER>::LEDRingsT(LEDOutputDriver *outerRing, LEDOutputDriver *innerRing, UDPLogger *logger){
     this->outerRing = outerRing;
     this->innerRing = innerRing;
     this->logger = logger;
     currentLimit = DEFAULT_CURRENT_LIMIT;
     brightnessOuterRing = 255;
     brightnessInnerRing = 255;
+    easingCurve = EASING_EXPONENTIAL;
+    lastDrawMillis = millis();
+    lastBlendFactor = -1.0;
+    lastBlendElapsed = 0;
+    lastBlendWeight = BLEND_WEIGHT_MAX;
+    outerRingDirty = true;
+    innerRingDirty = true;
+    shownBrightnessOuterRing = 0;
+    shownBrightnessInnerRing = 0;
+    framesPushed = 0;
+    framesSkipped = 0;
+    flushCountOuterRing.fill(0);
+    flushCountInnerRing.fill(0);
+    layerBlendMode.fill(LAYER_BLEND_OVER);
+    layerVisible.fill(true);
+    dirtyOuterRing.fill({DIRTY_SPAN_EMPTY, 0});
+    dirtyInnerRing.fill({DIRTY_SPAN_EMPTY, 0});
+    outputEnabled = true;
+    outerRingSettled = true;
+    innerRingSettled = true;
+    colorCurrentOuterRing = 0;
+    colorCurrentInnerRing = 0;
+    limiterScale = LIMITER_SCALE_MAX;
+    limiterSettled = true;
+    estimatedCurrent = 0;
+    gammaCorrection = LED_GAMMA_CORRECTION;
+    ditheringEnabled = LED_DITHERING;
+    fractionOuterRing = false;
+    fractionInnerRing = false;
+    ditherFramesOuterRing = 0;
+    ditherFramesInnerRing = 0;
+    ditherPending = false;
+    setCurrentCalibration({LED_CURRENT_RED_UA, LED_CURRENT_GREEN_UA, LED_CURRENT_BLUE_UA, LED_CURRENT_QUIESCENT_UA});
 }
 
 /**
@@ -17,17 +79,85 @@ LEDRings::LEDRings(Adafruit_NeoPixel *outerRing, Adafruit_NeoPixel *innerRing, U
  * @param b blue value (0-255)
  * @return uint32_t 24bit color value
  */
-uint32_t LEDRings::Color24bit(uint8_t r, uint8_t g, uint8_t b){
+uint32_t LEDRingsBase::Color24bit(uint8_t r, uint8_t g, uint8_t b){
     return ((uint32_t)r << 16) | ((uint32_t)g <<  8) | b;
 }
 
+/**
+ * @brief Combine the color of a layer with the color of the layers below
+ * 
+ * @param below composited color of the layers below
+ * @param above color of the layer
+ * @param mode blend mode of the layer
+ * @return uint32_t composited 24bit color value
+ */
+uint32_t LEDRingsBase::composeColor24bit(uint32_t below, uint32_t above, LayerBlendMode mode){
+    switch(mode){
+        case LAYER_BLEND_ADD: {
+            // saturating addition of each channel
+            uint32_t result = 0;
+            for(int shift = 0; shift <= 16; shift += 8){
+                uint16_t sum = ((below >> shift) & 0xFF) + ((above >> shift) & 0xFF);
+                if(sum > 0xFF) sum = 0xFF;
+                result |= (uint32_t)sum << shift;
+            }
+            return result;
+        }
+        case LAYER_BLEND_MAX: {
+            // maximum of each channel
+            uint32_t result = 0;
+            for(int shift = 0; shift <= 16; shift += 8){
+                uint32_t mask = (uint32_t)0xFF << shift;
+                result |= ((below & mask) > (above & mask)) ? (below & mask) : (above & mask);
+            }
+            return result;
+        }
+        case LAYER_BLEND_OVER:
+        default:
+            // black pixels are transparent
+            return above != 0 ? above : below;
+    }
+}
+
+/**
+ * @brief Calculate the number of output levels the brightest channel of a color passes when it fades in
+ * 
+ * @param color 24bit color value
+ * @param brightness effective brightness (0-255)
+ * @param gamma true if gamma correction is applied
+ * @return uint16_t number of output levels
+ */
+uint16_t LEDRingsBase::calcOutputLevels(uint32_t color, uint8_t brightness, bool gamma){
+    uint8_t maxChannel = 0;
+    for(int shift = 0; shift <= 16; shift += 8){
+        uint8_t value = (color >> shift) & 0xFF;
+        if(value > maxChannel) maxChannel = value;
+    }
+    uint32_t value16 = gamma ? pgm_read_word(&gammaTable[maxChannel]) : (uint32_t)maxChannel << 8;
+    uint32_t levels = (value16 * (brightness + 1)) >> 16;
+    if(gamma) levels = levels * GAMMA_MAX_SLOPE_X10 / 10;
+    return levels;
+}
+
+/**
+ * @brief Expand a dirty span so that it contains the given pixel range
+ * 
+ * @param span dirty span (empty if first > last)
+ * @param first first pixel of the range
+ * @param last last pixel of the range
+ */
+void LEDRingsBase::expandDirtySpan(DirtySpan &span, uint16_t first, uint16_t last){
+    if(first < span.first) span.first = first;
+    if(last > span.last) span.last = last;
+}
+
 /**
  * @brief Input a value 0 to 255 to get a color value. The colors are a transition r - g - b - back to r.
  * 
  * @param WheelPos Value between 0 and 255
  * @return uint32_t return 24bit color of colorwheel
  */
-uint32_t LEDRings::Wheel(uint8_t WheelPos) {
+uint32_t LEDRingsBase::Wheel(uint8_t WheelPos) {
     WheelPos = 255 - WheelPos;
     if (WheelPos < 85)
     {
@@ -50,54 +180,148 @@ uint32_t LEDRings::Wheel(uint8_t WheelPos) {
  * @param factor which color is wanted on the path from start to end color
  * @return uint32_t interpolated color
  */
-uint32_t LEDRings::interpolateColor24bit(uint32_t color1, uint32_t color2, float factor){
-    uint8_t r1 = (color1 >> 16) & 0xFF;
-    uint8_t g1 = (color1 >> 8) & 0xFF;
-    uint8_t b1 = color1 & 0xFF;
+uint32_t LEDRingsBase::interpolateColor24bit(uint32_t color1, uint32_t color2, float factor){
+    if(factor <= 0.0) return color1;
+    if(factor >= 1.0) return color2;
+    return blendColor24bit(color1, color2, factor * BLEND_WEIGHT_MAX);
+}
 
-    uint8_t r2 = (color2 >> 16) & 0xFF;
-    uint8_t g2 = (color2 >> 8) & 0xFF;
-    uint8_t b2 = color2 & 0xFF;
+/**
+ * @brief Interpolates two colors24bit with a fixed point (Q8) weight
+ * 
+ * Red and blue channel are blended together in one multiplication (both channels are 
+ * 16 bit apart in the register, so they can not overflow into each other), green separately.
+ * No float arithmetic is used, which is important as the ESP8266 has no FPU.
+ * 
+ * @param color1 startcolor for interpolation
+ * @param color2 endcolor for interpolation
+ * @param weight weight of the endcolor (0 = color1, BLEND_WEIGHT_MAX = color2)
+ * @return uint32_t interpolated color
+ */
+uint32_t LEDRingsBase::blendColor24bit(uint32_t color1, uint32_t color2, uint16_t weight){
+    if(weight >= BLEND_WEIGHT_MAX) return color2 & 0xFFFFFF;
+    uint32_t inverseWeight = BLEND_WEIGHT_MAX - weight;
 
-    uint8_t r = r1 + (r2 - r1) * factor;
-    uint8_t g = g1 + (g2 - g1) * factor;
-    uint8_t b = b1 + (b2 - b1) * factor;
+    uint32_t redBlue = ((color1 & 0xFF00FF) * inverseWeight + (color2 & 0xFF00FF) * weight) >> 8;
+    uint32_t green = ((color1 & 0x00FF00) * inverseWeight + (color2 & 0x00FF00) * weight) >> 8;
 
-    return Color24bit(r, g, b);
+    return (redBlue & 0xFF00FF) | (green & 0x00FF00);
+}
+
+/**
+ * @brief Calc the blend weight for one frame from the elapsed time since the last frame
+ * 
+ * The factor defines which part of the remaining color difference is bridged within 
+ * one reference period (PERIOD_LED_UPDATE). This way the speed of a transition does not 
+ * depend on how often the rings are actually drawn.
+ * 
+ * @param factor transition factor per reference period (1.0 = instant, 0.1 = smooth)
+ * @param elapsedMillis time since the last frame in milliseconds
+ * @param curve easing curve to use
+ * @return uint16_t blend weight (0 - BLEND_WEIGHT_MAX)
+ */
+uint16_t LEDRingsBase::calcBlendWeight(float factor, uint32_t elapsedMillis, EasingCurve curve){
+    if(factor >= 1.0) return BLEND_WEIGHT_MAX;
+    if(factor <= 0.0) return 0;
+
+    float weight = 0.0;
+    float periods = (float)elapsedMillis / (float)PERIOD_LED_UPDATE;
+    if(curve == EASING_LINEAR) {
+        weight = factor * periods;
+    }
+    else {
+        weight = 1.0 - powf(1.0 - factor, periods);
+    }
+
+    if(weight >= 1.0) return BLEND_WEIGHT_MAX;
+    return weight * BLEND_WEIGHT_MAX;
+}
+
+/**
+ * @brief Move each channel of a color one step towards the target color
+ * 
+ * Used to finish transitions where the remaining difference is too small for the blend weight.
+ * 
+ * @param color current color
+ * @param target target color
+ * @return uint32_t color one step closer to the target
+ */
+uint32_t LEDRingsBase::stepColor24bit(uint32_t color, uint32_t target){
+    uint32_t result = 0;
+    for(uint8_t shift = 0; shift <= 16; shift += 8){
+        uint8_t c = (color >> shift) & 0xFF;
+        uint8_t t = (target >> shift) & 0xFF;
+        if(c < t) c++;
+        else if(c > t) c--;
+        result |= (uint32_t)c << shift;
+    }
+    return result;
+}
+
+/**
+ * @brief Convert a 24bit color to the color which is sent to the LEDs
+ * 
+ * Gamma correction and brightness are calculated with 16bit per channel. The result is 
+ * either rounded to 8bit or temporally dithered: the fractional part is accumulated 
+ * in the residual of the channel and added in the next frame, so the average over 
+ * several frames corresponds to the 16bit value.
+ * 
+ * @param color 24bit color value
+ * @param brightnessScale brightness + 1 (1-256), 1 is always black
+ * @param gamma apply gamma correction
+ * @param residual dither residuals of the three channels of the pixel (nullptr = no dithering)
+ * @param hasFraction set to true if the 16bit value of any channel can not be displayed exactly with 8bit
+ * @return uint32_t 24bit output color
+ */
+uint32_t LEDRingsBase::calcOutputColor(uint32_t color, uint16_t brightnessScale, bool gamma, uint8_t *residual, bool &hasFraction){
+    // brightness 0 is off, the rounding must not light up bright channels
+    if(brightnessScale <= 1) return 0;
+    uint32_t result = 0;
+    for(uint8_t channel = 0; channel < 3; channel++){
+        uint8_t shift = 16 - channel * 8;
+        uint8_t value = (color >> shift) & 0xFF;
+        uint32_t value16 = gamma ? pgm_read_word(&gammaTable[value]) : (uint32_t)value << 8;
+        value16 = (value16 * brightnessScale) >> 8;
+        if(value16 & 0xFF) hasFraction = true;
+
+        if(residual != nullptr){
+            value16 += residual[channel];
+            residual[channel] = value16 & 0xFF;
+        }
+        else {
+            value16 += 0x80;
+        }
+        uint8_t output = value16 > 0xFFFF ? 0xFF : value16 >> 8;
+        result |= (uint32_t)output << shift;
+    }
+    return result;
 }
 
 /**
  * @brief Setup the LED rings
  * 
 */
-void LEDRings::setupRings(){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setupRings(){
     outerRing->begin();
     innerRing->begin();
-    outerRing->setBrightness(brightnessOuterRing);
-    innerRing->setBrightness(brightnessInnerRing);
+    // brightness is applied by LEDRings itself (with higher bit depth), so the drivers always run at full brightness
+    outerRing->setBrightness(255);
+    innerRing->setBrightness(255);
     outerRing->show();
     innerRing->show();
 }
 
-/**
- * @brief Set the offsets of the rings
- * 
- * @param offsetOuterRing offset of the outer ring
- * @param offsetInnerRing offset of the inner ring
- */
-void LEDRings::setOffsets(int offsetOuterRing, int offsetInnerRing){
-    this->offsetOuterRing = offsetOuterRing;
-    this->offsetInnerRing = offsetInnerRing;
-}
-
 /**
  * @brief Set the brightness of the outer ring
  * 
  * @param brightness brightness value (0-255)
  */
-void LEDRings::setBrightnessOuterRing(uint8_t brightness){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setBrightnessOuterRing(uint8_t brightness){
     brightnessOuterRing = brightness;
-    outerRing->setBrightness(brightness);
+    // new brightness is applied with the next frame
+    outerRingDirty = true;
 }
 
 
@@ -106,9 +330,11 @@ void LEDRings::setBrightnessOuterRing(uint8_t brightness){
  * 
  * @param brightness brightness value (0-255)
  */
-void LEDRings::setBrightnessInnerRing(uint8_t brightness){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setBrightnessInnerRing(uint8_t brightness){
     brightnessInnerRing = brightness;
-    innerRing->setBrightness(brightness);
+    // new brightness is applied with the next frame
+    innerRingDirty = true;
 }
 
 /**
@@ -116,16 +342,54 @@ void LEDRings::setBrightnessInnerRing(uint8_t brightness){
  * 
  * @param currentLimit current limit value (0-9999)
  */
-void LEDRings::setCurrentLimit(uint16_t currentLimit){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setCurrentLimit(uint16_t currentLimit){
     this->currentLimit = currentLimit;
 }
 
+/**
+ * @brief Enable or disable the gamma correction of the output colors
+ * 
+ * @param enabled true = gamma correction active
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setGammaCorrection(bool enabled){
+    gammaCorrection = enabled;
+    outerRingDirty = true;
+    innerRingDirty = true;
+    // current estimation is based on the output values
+    recalcCurrentSums();
+}
+
+/**
+ * @brief Enable or disable temporal dithering for low brightness (<= DITHER_BRIGHTNESS_LIMIT)
+ * 
+ * @param enabled true = dithering active
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setDithering(bool enabled){
+    ditheringEnabled = enabled;
+    outerRingDirty = true;
+    innerRingDirty = true;
+}
+
+/**
+ * @brief Set the easing curve which is used for smooth transitions
+ * 
+ * @param curve easing curve
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setEasingCurve(EasingCurve curve){
+    easingCurve = curve;
+}
+
 /**
  * @brief Get the brightness of the outer ring
  * 
  * @return uint8_t brightness value (0-255)
  */
-uint8_t LEDRings::getBrightnessOuterRing(){
+template<class OUTER, class INNER>
+uint8_t LEDRingsT<OUTER, INNER>::getBrightnessOuterRing(){
     return brightnessOuterRing;
 }
 
@@ -134,152 +398,613 @@ uint8_t LEDRings::getBrightnessOuterRing(){
  * 
  * @return uint8_t brightness value (0-255)
  */
-uint8_t LEDRings::getBrightnessInnerRing(){
+template<class OUTER, class INNER>
+uint8_t LEDRingsT<OUTER, INNER>::getBrightnessInnerRing(){
     return brightnessInnerRing;
 }
 
 /**
- * @brief Flush the outer ring
+ * @brief Flush one layer of the outer ring (all pixels transparent)
  * 
+ * @param layer layer to flush
  */
-void LEDRings::flushOuterRing(){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::flushOuterRing(RingLayer layer){
     // set all pixels to black
-    for(int i=0; i<OUTER_RING_LED_COUNT; i++) {
-        targetOuterring[i] = 0;
+    for(int i=0; i<OUTER::ledCount; i++) {
+        layerOuterRing[layer][i] = 0;
     }
+    expandDirtySpan(dirtyOuterRing[layer], 0, OUTER::ledCount - 1);
+    flushCountOuterRing[layer]++;
 }
 
 /**
- * @brief Flush the inner ring
+ * @brief Flush one layer of the inner ring (all pixels transparent)
  * 
+ * @param layer layer to flush
  */
-void LEDRings::flushInnerRing(){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::flushInnerRing(RingLayer layer){
     // set all pixels to black
-    for(int i=0; i<INNER_RING_LED_COUNT; i++) {
-        targetInnerRing[i] = 0;
+    for(int i=0; i<INNER::ledCount; i++) {
+        layerInnerRing[layer][i] = 0;
     }
+    expandDirtySpan(dirtyInnerRing[layer], 0, INNER::ledCount - 1);
+    flushCountInnerRing[layer]++;
 }
 
 /**
- * @brief Set the color of a pixel on the outer ring
+ * @brief Set the color of a pixel of one layer of the outer ring
  * 
+ * @param layer layer to draw on
  * @param pixel pixel number (0-90)
- * @param color 24bit color value
+ * @param color 24bit color value (black = transparent for LAYER_BLEND_OVER)
  */
-void LEDRings::setPixelOuterRing(uint16_t pixel, uint32_t color){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setPixelOuterRing(RingLayer layer, uint16_t pixel, uint32_t color){
     // check if pixel is in range
-    if(pixel >= OUTER_RING_LED_COUNT){
-        logger->logString("ERROR: pixel out of range");
+    if(pixel >= OUTER::ledCount){
+        logger->logf(LOG_ERROR, "pixel out of range");
         return;
     }
-    targetOuterring[pixel] = color;
+    if(layerOuterRing[layer][pixel] != color){
+        layerOuterRing[layer][pixel] = color;
+        expandDirtySpan(dirtyOuterRing[layer], pixel, pixel);
+    }
 }
 
 /**
- * @brief Set the color of a pixel on the inner ring
+ * @brief Set the color of a pixel of one layer of the inner ring
  * 
+ * @param layer layer to draw on
  * @param pixel pixel number (0-11)
- * @param color 24bit color value
+ * @param color 24bit color value (black = transparent for LAYER_BLEND_OVER)
  */
-void LEDRings::setPixelInnerRing(uint16_t pixel, uint32_t color){
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setPixelInnerRing(RingLayer layer, uint16_t pixel, uint32_t color){
     // check if pixel is in range
-    if(pixel >= INNER_RING_LED_COUNT){
-        logger->logString("ERROR: pixel out of range");
+    if(pixel >= INNER::ledCount){
+        logger->logf(LOG_ERROR, "pixel out of range");
+        return;
+    }
+    if(layerInnerRing[layer][pixel] != color){
+        layerInnerRing[layer][pixel] = color;
+        expandDirtySpan(dirtyInnerRing[layer], pixel, pixel);
+    }
+}
+
+/**
+ * @brief Set a span of pixels of one layer of the outer ring to the same color (bounds are checked once per span)
+ * 
+ * @param layer layer to draw on
+ * @param firstPixel first pixel of the span
+ * @param count number of pixels
+ * @param color 24bit color value
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::fillPixelsOuterRing(RingLayer layer, uint16_t firstPixel, uint16_t count, uint32_t color){
+    // check if span is in range
+    if(firstPixel + count > OUTER::ledCount){
+        logger->logf(LOG_ERROR, "pixel span out of range");
+        return;
+    }
+    if(count == 0) return;
+    for(uint16_t i = firstPixel; i < firstPixel + count; i++){
+        layerOuterRing[layer][i] = color;
+    }
+    expandDirtySpan(dirtyOuterRing[layer], firstPixel, firstPixel + count - 1);
+}
+
+/**
+ * @brief Set a span of pixels of one layer of the inner ring to the same color (bounds are checked once per span)
+ * 
+ * @param layer layer to draw on
+ * @param firstPixel first pixel of the span
+ * @param count number of pixels
+ * @param color 24bit color value
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::fillPixelsInnerRing(RingLayer layer, uint16_t firstPixel, uint16_t count, uint32_t color){
+    // check if span is in range
+    if(firstPixel + count > INNER::ledCount){
+        logger->logf(LOG_ERROR, "pixel span out of range");
         return;
     }
-    targetInnerRing[pixel] = color;
+    if(count == 0) return;
+    for(uint16_t i = firstPixel; i < firstPixel + count; i++){
+        layerInnerRing[layer][i] = color;
+    }
+    expandDirtySpan(dirtyInnerRing[layer], firstPixel, firstPixel + count - 1);
+}
+
+/**
+ * @brief Copy a span of colors to consecutive pixels of one layer of the outer ring
+ * 
+ * @param layer layer to draw on
+ * @param firstPixel first pixel of the span
+ * @param colors array of 24bit color values
+ * @param count number of pixels
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::writePixelsOuterRing(RingLayer layer, uint16_t firstPixel, const uint32_t *colors, uint16_t count){
+    // check if span is in range
+    if(firstPixel + count > OUTER::ledCount){
+        logger->logf(LOG_ERROR, "pixel span out of range");
+        return;
+    }
+    if(count == 0) return;
+    for(uint16_t i = 0; i < count; i++){
+        layerOuterRing[layer][firstPixel + i] = colors[i];
+    }
+    expandDirtySpan(dirtyOuterRing[layer], firstPixel, firstPixel + count - 1);
+}
+
+/**
+ * @brief Copy a span of colors to consecutive pixels of one layer of the inner ring
+ * 
+ * @param layer layer to draw on
+ * @param firstPixel first pixel of the span
+ * @param colors array of 24bit color values
+ * @param count number of pixels
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::writePixelsInnerRing(RingLayer layer, uint16_t firstPixel, const uint32_t *colors, uint16_t count){
+    // check if span is in range
+    if(firstPixel + count > INNER::ledCount){
+        logger->logf(LOG_ERROR, "pixel span out of range");
+        return;
+    }
+    if(count == 0) return;
+    for(uint16_t i = 0; i < count; i++){
+        layerInnerRing[layer][firstPixel + i] = colors[i];
+    }
+    expandDirtySpan(dirtyInnerRing[layer], firstPixel, firstPixel + count - 1);
+}
+
+/**
+ * @brief Get the number of flushes of one layer of the outer ring. Renderers which only update changed pixels 
+ * use it to detect that the layer has been cleared in the meantime and a full repaint is needed.
+ * 
+ * @param layer layer
+ * @return uint16_t flush counter (wraps around)
+ */
+template<class OUTER, class INNER>
+uint16_t LEDRingsT<OUTER, INNER>::getFlushCountOuterRing(RingLayer layer){
+    return flushCountOuterRing[layer];
+}
+
+/**
+ * @brief Get the number of flushes of one layer of the inner ring
+ * 
+ * @param layer layer
+ * @return uint16_t flush counter (wraps around)
+ */
+template<class OUTER, class INNER>
+uint16_t LEDRingsT<OUTER, INNER>::getFlushCountInnerRing(RingLayer layer){
+    return flushCountInnerRing[layer];
+}
+
+/**
+ * @brief Set how a layer is combined with the layers below it
+ * 
+ * @param layer layer
+ * @param mode blend mode
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setLayerBlendMode(RingLayer layer, LayerBlendMode mode){
+    if(layerBlendMode[layer] == mode) return;
+    layerBlendMode[layer] = mode;
+    expandDirtySpan(dirtyOuterRing[layer], 0, OUTER::ledCount - 1);
+    expandDirtySpan(dirtyInnerRing[layer], 0, INNER::ledCount - 1);
+}
+
+/**
+ * @brief Show or hide a layer (the content of a hidden layer is kept)
+ * 
+ * @param layer layer
+ * @param visible true to show the layer
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setLayerVisible(RingLayer layer, bool visible){
+    if(layerVisible[layer] == visible) return;
+    layerVisible[layer] = visible;
+    expandDirtySpan(dirtyOuterRing[layer], 0, OUTER::ledCount - 1);
+    expandDirtySpan(dirtyInnerRing[layer], 0, INNER::ledCount - 1);
+}
+
+/**
+ * @brief Enable or blank the output of the rings. While blanked the rings are 
+ * dark, but the layers keep their content and can still be drawn on.
+ * 
+ * @param enabled false to blank the rings
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setOutputEnabled(bool enabled){
+    if(outputEnabled == enabled) return;
+    outputEnabled = enabled;
+    expandDirtySpan(dirtyOuterRing[0], 0, OUTER::ledCount - 1);
+    expandDirtySpan(dirtyInnerRing[0], 0, INNER::ledCount - 1);
+}
+
+/**
+ * @brief Check if the output of the rings is enabled
+ * 
+ * @return true output enabled
+ * @return false rings are blanked
+ */
+template<class OUTER, class INNER>
+bool LEDRingsT<OUTER, INNER>::isOutputEnabled(){
+    return outputEnabled;
+}
+
+/**
+ * @brief Combine the layers to the target frame of the rings. Only the pixels 
+ * inside the dirty spans of the layers are composited.
+ * 
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::compositeRings(){
+    // outer ring: union of the dirty spans of all layers
+    DirtySpan span = {DIRTY_SPAN_EMPTY, 0};
+    for(int l=0; l<LAYER_COUNT; l++) {
+        if(dirtyOuterRing[l].first <= dirtyOuterRing[l].last) expandDirtySpan(span, dirtyOuterRing[l].first, dirtyOuterRing[l].last);
+        dirtyOuterRing[l] = {DIRTY_SPAN_EMPTY, 0};
+    }
+    for(int i=span.first; i<=span.last && i<OUTER::ledCount; i++) {
+        uint32_t color = 0;
+        if(outputEnabled) {
+            for(int l=0; l<LAYER_COUNT; l++) {
+                if(layerVisible[l]) color = composeColor24bit(color, layerOuterRing[l][i], layerBlendMode[l]);
+            }
+        }
+        if(targetOuterRing[i] != color){
+            targetOuterRing[i] = color;
+            outerRingSettled = false;
+        }
+    }
+
+    // inner ring: union of the dirty spans of all layers
+    span = {DIRTY_SPAN_EMPTY, 0};
+    for(int l=0; l<LAYER_COUNT; l++) {
+        if(dirtyInnerRing[l].first <= dirtyInnerRing[l].last) expandDirtySpan(span, dirtyInnerRing[l].first, dirtyInnerRing[l].last);
+        dirtyInnerRing[l] = {DIRTY_SPAN_EMPTY, 0};
+    }
+    for(int i=span.first; i<=span.last && i<INNER::ledCount; i++) {
+        uint32_t color = 0;
+        if(outputEnabled) {
+            for(int l=0; l<LAYER_COUNT; l++) {
+                if(layerVisible[l]) color = composeColor24bit(color, layerInnerRing[l][i], layerBlendMode[l]);
+            }
+        }
+        if(targetInnerRing[i] != color){
+            targetInnerRing[i] = color;
+            innerRingSettled = false;
+        }
+    }
 }
 
 /**
  * @brief Draw the target color on the rings instantly
  * 
  */
-void LEDRings::drawOnRingsInstant(){
-    drawOnRings(1.0);
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::drawOnRingsInstant(){
+    drawOnRings(BLEND_WEIGHT_MAX);
 }
 
 /**
  * @brief Draw the target color on the rings with a smooth transition
  * 
- * @param factor transition factor (1.0 = instant, 0.1 = smooth)
+ * The blend weight is calculated once per frame based on the elapsed time since the last frame.
+ * 
+ * @param factor transition factor per PERIOD_LED_UPDATE (1.0 = instant, 0.1 = smooth)
  */
-void LEDRings::drawOnRingsSmooth(float factor){
-    drawOnRings(factor);
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::drawOnRingsSmooth(float factor){
+    uint32_t elapsed = millis() - lastDrawMillis;
+    // the weight only needs to be recalculated if factor or frame timing changed
+    if(factor != lastBlendFactor || elapsed != lastBlendElapsed){
+        lastBlendWeight = calcBlendWeight(factor, elapsed, easingCurve);
+        lastBlendFactor = factor;
+        lastBlendElapsed = elapsed;
+    }
+    drawOnRings(lastBlendWeight);
 }
 
 /**
  * @brief Draw the target color on the rings
  * 
- * @param factor transition factor (1.0 = instant, 0.1 = smooth)
+ * @param blendWeight weight of the target color (BLEND_WEIGHT_MAX = instant)
  */
-void LEDRings::drawOnRings(float factor){
-
-    // set pixels on outer ring and calculate current for outer ring
-    uint16_t totalCurrentOuterRing = 0;
-    for(int i=0; i<OUTER_RING_LED_COUNT; i++) {
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::drawOnRings(uint16_t blendWeight){
+    METRIC_SCOPE(METRIC_DRAW_ON_RINGS);
+    lastDrawMillis = millis();
+
+    // combine the layers to the target frames (only dirty pixels)
+    compositeRings();
+
+    // update pixels of outer ring and running current sum of outer ring (only changed pixels)
+    bool outerRingChanged = false;
+    bool outerRingReached = true;
+    for(int i=0; i<OUTER::ledCount && !outerRingSettled; i++) {
         uint32_t currentColor = currentOuterRing[i];
-        uint32_t targetColor = targetOuterring[i];
-        uint32_t newColor = interpolateColor24bit(currentColor, targetColor, factor);
-        int correctedPixel = (OUTER_RING_LED_COUNT + i + offsetOuterRing) % OUTER_RING_LED_COUNT;
-        outerRing->setPixelColor(correctedPixel, newColor);
-        currentOuterRing[i] = newColor;
-
-        totalCurrentOuterRing += calcEstimatedLEDCurrent(newColor, brightnessOuterRing);
+        uint32_t targetColor = targetOuterRing[i];
+        uint32_t newColor = blendColor24bit(currentColor, targetColor, blendWeight);
+        // finish the transition if the remaining difference is too small for the blend weight
+        if(newColor == currentColor && newColor != targetColor && blendWeight > 0) newColor = stepColor24bit(currentColor, targetColor);
+        if(newColor != currentColor){
+            colorCurrentOuterRing = colorCurrentOuterRing - calcPixelCurrent(currentColor) + calcPixelCurrent(newColor);
+            currentOuterRing[i] = newColor;
+            outerRingChanged = true;
+        }
+        if(newColor != targetColor) outerRingReached = false;
     }
 
-    // set pixels on inner ring and calculate current for inner ring
-    uint16_t totalCurrentInnerRing = 0;
-    for(int i=0; i<INNER_RING_LED_COUNT; i++) {
+    // update pixels of inner ring and running current sum of inner ring (only changed pixels)
+    bool innerRingChanged = false;
+    bool innerRingReached = true;
+    for(int i=0; i<INNER::ledCount && !innerRingSettled; i++) {
         uint32_t currentColor = currentInnerRing[i];
         uint32_t targetColor = targetInnerRing[i];
-        uint32_t newColor = interpolateColor24bit(currentColor, targetColor, factor);
-        int correctedPixel = (INNER_RING_LED_COUNT + i + offsetInnerRing) % INNER_RING_LED_COUNT;
-        innerRing->setPixelColor(correctedPixel, newColor);
-        currentInnerRing[i] = newColor;
+        uint32_t newColor = blendColor24bit(currentColor, targetColor, blendWeight);
+        // finish the transition if the remaining difference is too small for the blend weight
+        if(newColor == currentColor && newColor != targetColor && blendWeight > 0) newColor = stepColor24bit(currentColor, targetColor);
+        if(newColor != currentColor){
+            colorCurrentInnerRing = colorCurrentInnerRing - calcPixelCurrent(currentColor) + calcPixelCurrent(newColor);
+            currentInnerRing[i] = newColor;
+            innerRingChanged = true;
+        }
+        if(newColor != targetColor) innerRingReached = false;
+    }
 
-        totalCurrentInnerRing += calcEstimatedLEDCurrent(newColor, brightnessInnerRing);
+    // a ring is settled if the current frame reached the target frame, the interpolation can be skipped until the target changes
+    if(outerRingReached) outerRingSettled = true;
+    if(innerRingReached) innerRingSettled = true;
+
+    // reduce brightness smoothly if the estimated current reaches the current limit
+    updateCurrentLimiter();
+    uint8_t newBrightnessOR = (brightnessOuterRing * limiterScale) >> 8;
+    uint8_t newBrightnessIR = (brightnessInnerRing * limiterScale) >> 8;
+
+    // only push a ring to the LEDs if its frame or its effective brightness changed 
+    if(outerRingChanged) outerRingDirty = true;
+    if(innerRingChanged) innerRingDirty = true;
+
+    bool pushOuterRing = outerRingDirty || newBrightnessOR != shownBrightnessOuterRing;
+    bool pushInnerRing = innerRingDirty || newBrightnessIR != shownBrightnessInnerRing;
+
+    // with temporal dithering a ring is pushed for DITHER_FRAMES frames after a change as long as a pixel 
+    // has a fractional part, the last of these frames is rounded and kept, so the clock settles again
+    bool ditherOuterRing = ditheringEnabled && newBrightnessOR <= DITHER_BRIGHTNESS_LIMIT;
+    bool ditherInnerRing = ditheringEnabled && newBrightnessIR <= DITHER_BRIGHTNESS_LIMIT;
+    if(pushOuterRing) ditherFramesOuterRing = DITHER_FRAMES;
+    else if(ditherOuterRing && fractionOuterRing && ditherFramesOuterRing > 0){
+        pushOuterRing = true;
+        ditherFramesOuterRing--;
+    }
+    if(pushInnerRing) ditherFramesInnerRing = DITHER_FRAMES;
+    else if(ditherInnerRing && fractionInnerRing && ditherFramesInnerRing > 0){
+        pushInnerRing = true;
+        ditherFramesInnerRing--;
+    }
+    ditherOuterRing = ditherOuterRing && ditherFramesOuterRing > 0;
+    ditherInnerRing = ditherInnerRing && ditherFramesInnerRing > 0;
+
+    // an asynchronous driver may still be busy with the previous frame -> keep ring dirty and push with next frame
+    if(pushOuterRing && outerRing->canShow()){
+        fractionOuterRing = false;
+        for(int i=0; i<OUTER::ledCount; i++) {
+            uint8_t *residual = ditherOuterRing ? &residualOuterRing[i * 3] : nullptr;
+            uint32_t color = calcOutputColor(currentOuterRing[i], newBrightnessOR + 1, gammaCorrection, residual, fractionOuterRing);
+            outerRing->setPixelColor(OUTER::pixelMap[i], color);
+        }
+        {
+            METRIC_SCOPE(METRIC_LED_SHOW);
+            outerRing->show();
+        }
+        shownBrightnessOuterRing = newBrightnessOR;
+        outerRingDirty = false;
+        framesPushed++;
+    }
+    else if(!pushOuterRing) {
+        framesSkipped++;
     }
 
-    uint16_t totalCurrent = totalCurrentOuterRing + totalCurrentInnerRing;
+    if(pushInnerRing && innerRing->canShow()){
+        fractionInnerRing = false;
+        for(int i=0; i<INNER::ledCount; i++) {
+            uint8_t *residual = ditherInnerRing ? &residualInnerRing[i * 3] : nullptr;
+            uint32_t color = calcOutputColor(currentInnerRing[i], newBrightnessIR + 1, gammaCorrection, residual, fractionInnerRing);
+            innerRing->setPixelColor(INNER::pixelMap[i], color);
+        }
+        {
+            METRIC_SCOPE(METRIC_LED_SHOW);
+            innerRing->show();
+        }
+        shownBrightnessInnerRing = newBrightnessIR;
+        innerRingDirty = false;
+        framesPushed++;
+    }
+    else if(!pushInnerRing) {
+        framesSkipped++;
+    }
+
+    ditherPending = (ditherOuterRing && fractionOuterRing) || (ditherInnerRing && fractionInnerRing);
+}
 
-    // Check if totalCurrent reaches CURRENTLIMIT -> if yes reduce brightness
-    if(totalCurrent > currentLimit){
-        uint8_t newBrightnessOR = brightnessOuterRing * float(currentLimit)/float(totalCurrent);
-        uint8_t newBrightnessIR = brightnessInnerRing * float(currentLimit)/float(totalCurrent);
-        //logger->logString("CurrentLimit reached!!!: " + String(totalCurrent));
-        outerRing->setBrightness(newBrightnessOR);
-        innerRing->setBrightness(newBrightnessIR);
+/**
+ * @brief Get the number of ring frames which were pushed to the LEDs
+ * 
+ * @return uint32_t number of pushed frames (outer and inner ring are counted separately)
+ */
+template<class OUTER, class INNER>
+uint32_t LEDRingsT<OUTER, INNER>::getFramesPushed(){
+    return framesPushed;
+}
+
+/**
+ * @brief Get the number of ring frames which were skipped as nothing changed
+ * 
+ * @return uint32_t number of skipped frames (outer and inner ring are counted separately)
+ */
+template<class OUTER, class INNER>
+uint32_t LEDRingsT<OUTER, INNER>::getFramesSkipped(){
+    return framesSkipped;
+}
+
+
+/**
+ * @brief Get the number of output levels the brightest channel of a color passes on the 
+ * outer ring when it fades in. With gamma correction, the steepest part of the curve 
+ * is used, so the result is the number of visible steps of the fastest changing part.
+ * 
+ * @param color 24bit color value
+ * @return uint16_t number of output levels at the current (limited) brightness
+ */
+template<class OUTER, class INNER>
+uint16_t LEDRingsT<OUTER, INNER>::getOutputLevelsOuterRing(uint32_t color){
+    uint8_t brightness = (brightnessOuterRing * limiterScale) >> 8;
+    return calcOutputLevels(color, brightness, gammaCorrection);
+}
+
+/**
+ * @brief Get the number of output levels the brightest channel of a color passes on the 
+ * inner ring when it fades in (see getOutputLevelsOuterRing())
+ * 
+ * @param color 24bit color value
+ * @return uint16_t number of output levels at the current (limited) brightness
+ */
+template<class OUTER, class INNER>
+uint16_t LEDRingsT<OUTER, INNER>::getOutputLevelsInnerRing(uint32_t color){
+    uint8_t brightness = (brightnessInnerRing * limiterScale) >> 8;
+    return calcOutputLevels(color, brightness, gammaCorrection);
+}
+
+/**
+ * @brief Check if the rings are settled: the shown frame equals the target frame, no layer 
+ * changed, the limiter is steady and dithering does not need further frames. While settled, 
+ * further frames only change the LEDs if the content of the layers changes.
+ * 
+ * @return true rings are settled
+ * @return false a transition is in progress
+ */
+template<class OUTER, class INNER>
+bool LEDRingsT<OUTER, INNER>::isSettled(){
+    if(!outerRingSettled || !innerRingSettled || outerRingDirty || innerRingDirty || !limiterSettled || ditherPending){
+        return false;
     }
-    else {
-        outerRing->setBrightness(brightnessOuterRing);
-        innerRing->setBrightness(brightnessInnerRing);
+    for(int l=0; l<LAYER_COUNT; l++) {
+        if(dirtyOuterRing[l].first <= dirtyOuterRing[l].last || dirtyInnerRing[l].first <= dirtyInnerRing[l].last){
+            return false;
+        }
     }
+    return true;
+}
 
-    // show rings
-    outerRing->show();
-    innerRing->show();
+/**
+ * @brief Set the calibration of the current estimation
+ * 
+ * @param calibration currents of the LED channels at full brightness and quiescent current of one LED
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::setCurrentCalibration(const LEDCurrentCalibration &calibration){
+    this->calibration = calibration;
+    // precalculate coefficients (Q8) so that the estimation needs no division: current = (value * coefficient) >> 8
+    coefficientRed = ((uint32_t)calibration.redMicroAmps * 256 + 127) / 255;
+    coefficientGreen = ((uint32_t)calibration.greenMicroAmps * 256 + 127) / 255;
+    coefficientBlue = ((uint32_t)calibration.blueMicroAmps * 256 + 127) / 255;
+
+    // recalc running sums with new calibration
+    recalcCurrentSums();
+}
+
+/**
+ * @brief Recalc the running current sums of both rings from scratch
+ * 
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::recalcCurrentSums(){
+    colorCurrentOuterRing = 0;
+    for(int i=0; i<OUTER::ledCount; i++) {
+        colorCurrentOuterRing += calcPixelCurrent(currentOuterRing[i]);
+    }
+    colorCurrentInnerRing = 0;
+    for(int i=0; i<INNER::ledCount; i++) {
+        colorCurrentInnerRing += calcPixelCurrent(currentInnerRing[i]);
+    }
 }
 
+/**
+ * @brief Get the estimated current of both rings (after current limiting)
+ * 
+ * @return uint16_t estimated current in mA
+ */
+template<class OUTER, class INNER>
+uint16_t LEDRingsT<OUTER, INNER>::getEstimatedCurrent(){
+    return estimatedCurrent;
+}
 
 /**
- * @brief Calc estimated current (mA) for one pixel with the given color and brightness
+ * @brief Calc estimated current (µA) for one pixel with the given color at full brightness
+ * 
+ * The quiescent current of the LED is not included. If the gamma correction is active,
+ * the gamma corrected values are used.
  * 
  * @param color 24bit color value of the pixel for which the current should be calculated
- * @param brightness brightness value (0-255)
- * @return the current in mA
+ * @return the current in µA
  */
-uint16_t LEDRings::calcEstimatedLEDCurrent(uint32_t color, uint8_t brightness){
+template<class OUTER, class INNER>
+uint32_t LEDRingsT<OUTER, INNER>::calcPixelCurrent(uint32_t color){
   // extract rgb values
   uint8_t red = color >> 16 & 0xff;
   uint8_t green = color >> 8 & 0xff;
   uint8_t blue = color & 0xff;
-  
-  // Linear estimation: 20mA for full brightness per LED 
-  // (calculation avoids float numbers)
-  uint32_t estimatedCurrent = (20 * red) + (20 * green) + (20 * blue);
-  estimatedCurrent /= 255;
-  estimatedCurrent = (estimatedCurrent * brightness)/255;
 
-  return estimatedCurrent;
+  if(gammaCorrection){
+    // gamma table is 16bit -> reduce to 8bit
+    red = pgm_read_word(&gammaTable[red]) >> 8;
+    green = pgm_read_word(&gammaTable[green]) >> 8;
+    blue = pgm_read_word(&gammaTable[blue]) >> 8;
+  }
+
+  // Linear estimation per channel
+  return (red * coefficientRed + green * coefficientGreen + blue * coefficientBlue) >> 8;
+}
+
+/**
+ * @brief Update the scale of the current limiter based on the running current sums
+ * 
+ * The brightness is reduced immediately if the current limit is exceeded (to protect 
+ * the power supply) and increased slowly again afterwards, this avoids the flickering 
+ * of toggling between limited and full brightness at the limit.
+ */
+template<class OUTER, class INNER>
+void LEDRingsT<OUTER, INNER>::updateCurrentLimiter(){
+    // current of the colors at the set brightness (same scaling as the NeoPixel library)
+    uint32_t colorCurrent = (colorCurrentOuterRing * (brightnessOuterRing + 1) + colorCurrentInnerRing * (brightnessInnerRing + 1)) >> 8;
+    uint32_t quiescentCurrent = (uint32_t)calibration.quiescentMicroAmps * (OUTER::ledCount + INNER::ledCount);
+    uint32_t limit = (uint32_t)currentLimit * 1000;
+
+    uint16_t targetScale = LIMITER_SCALE_MAX;
+    if(colorCurrent > 0 && colorCurrent + quiescentCurrent > limit){
+        uint32_t available = limit > quiescentCurrent ? limit - quiescentCurrent : 0;
+        targetScale = (available << 8) / colorCurrent;
+    }
+
+    if(targetScale < limiterScale){
+        // attack: immediately
+        limiterScale = targetScale;
+    }
+    else if(targetScale > limiterScale){
+        // release: slowly back to full brightness
+        uint16_t step = targetScale - limiterScale;
+        limiterScale += step < LIMITER_RELEASE_STEP ? step : LIMITER_RELEASE_STEP;
+    }
+
+    limiterSettled = limiterScale == targetScale;
+    estimatedCurrent = (((colorCurrent * limiterScale) >> 8) + quiescentCurrent) / 1000;
 }
 
+// instantiate the LED rings for the geometry configured in constants.h
+template class LEDRingsT<OuterRingGeometry, InnerRingGeometry>;
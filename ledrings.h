@@ -1,60 +1,256 @@
 #ifndef ledrings_h
 #define ledrings_h
 
-#include <Adafruit_NeoPixel.h>          // NeoPixel library used to run the NeoPixel LEDs:
+#include <array>
+#include "leddrivers.h"
 #include "udplogger.h"
 #include "constants.h"
 
 #define DEFAULT_CURRENT_LIMIT 9999
+#define BLEND_WEIGHT_MAX 256            // blend weight (Q8 fixed point) which results in 100% of the target color
+#define LIMITER_SCALE_MAX 256           // brightness scale (Q8 fixed point) of the current limiter for full brightness
+#define LIMITER_RELEASE_STEP 1          // increase of the limiter scale per frame after the current dropped below the limit
+#define DITHER_BRIGHTNESS_LIMIT 64      // temporal dithering is only used up to this (effective) brightness
+#define DITHER_FRAMES 50                // frames dithered after a change of a ring, then the rounded frame is kept
+#define DIRTY_SPAN_EMPTY 0xFFFF         // first pixel of an empty dirty span
+#define GAMMA_MAX_SLOPE_X10 22          // steepest slope of the gamma curve (at full value) x10
 
-class LEDRings{
+/**
+ * @brief Time based easing curves for the smooth transition of drawOnRingsSmooth()
+ * 
+ */
+enum EasingCurve {
+    EASING_EXPONENTIAL,                 // exact exponential approach to the target color, independent of the frame rate
+    EASING_LINEAR                       // linear approximation of the exponential approach (cheaper, no pow())
+};
+
+/**
+ * @brief Layers of the rings, composited from bottom (LAYER_HOURS) to top (LAYER_OVERLAY)
+ * 
+ */
+enum RingLayer {
+    LAYER_HOURS,                        // hour indicator (inner ring)
+    LAYER_MINUTES,                      // minutes bar (outer ring)
+    LAYER_SECONDS,                      // seconds indicator (outer ring)
+    LAYER_OVERLAY,                      // IP display, LED test, notifications
+    LAYER_COUNT
+};
+
+/**
+ * @brief Blend modes to combine a layer with the layers below
+ * 
+ */
+enum LayerBlendMode {
+    LAYER_BLEND_OVER,                   // pixels of the layer cover the layers below, black is transparent
+    LAYER_BLEND_ADD,                    // channels are added (saturating)
+    LAYER_BLEND_MAX                     // maximum of each channel
+};
+
+/**
+ * @brief Range of pixels of a layer which changed since the last composition
+ * 
+ */
+struct DirtySpan{
+    uint16_t first;                     // first changed pixel (DIRTY_SPAN_EMPTY if nothing changed)
+    uint16_t last;                      // last changed pixel
+};
+
+/**
+ * @brief Calibration of the LED current estimation
+ * 
+ */
+struct LEDCurrentCalibration{
+    uint16_t redMicroAmps;              // current of red channel at full brightness (µA)
+    uint16_t greenMicroAmps;            // current of green channel at full brightness (µA)
+    uint16_t blueMicroAmps;             // current of blue channel at full brightness (µA)
+    uint16_t quiescentMicroAmps;        // current of one LED which is off (µA)
+};
+
+/**
+ * @brief Create the lookup table which maps the logical pixel index to the physical LED index
+ * 
+ * @tparam LED_COUNT number of LEDs of the ring
+ * @tparam OFFSET offset of the ring (physical LED of logical pixel 0)
+ * @return constexpr std::array<uint16_t, LED_COUNT> mapping table
+ */
+template<uint16_t LED_COUNT, int OFFSET> constexpr std::array<uint16_t, LED_COUNT> makeRingPixelMap(){
+    std::array<uint16_t, LED_COUNT> pixelMap{};
+    for(uint16_t i = 0; i < LED_COUNT; i++){
+        pixelMap[i] = ((int)(i + OFFSET) % (int)LED_COUNT + LED_COUNT) % LED_COUNT;
+    }
+    return pixelMap;
+}
+
+/**
+ * @brief Compile time description of one LED ring
+ * 
+ * @tparam LED_COUNT number of LEDs of the ring
+ * @tparam OFFSET offset of the ring (physical LED of logical pixel 0)
+ */
+template<uint16_t LED_COUNT, int OFFSET> struct RingGeometry{
+    static constexpr uint16_t ledCount = LED_COUNT;
+    static constexpr int offset = OFFSET;
+    static constexpr std::array<uint16_t, LED_COUNT> pixelMap = makeRingPixelMap<LED_COUNT, OFFSET>();
+};
+
+/**
+ * @brief Geometry independent part of the LED rings (color helper functions)
+ * 
+ */
+class LEDRingsBase{
     public:
-        LEDRings(Adafruit_NeoPixel *outerRing, Adafruit_NeoPixel *innerRing, UDPLogger *logger);
         static uint32_t Color24bit(uint8_t r, uint8_t g, uint8_t b);
         static uint32_t Wheel(uint8_t WheelPos);
         static uint32_t interpolateColor24bit(uint32_t color1, uint32_t color2, float factor);
+        static uint32_t blendColor24bit(uint32_t color1, uint32_t color2, uint16_t weight);
+        static uint16_t calcBlendWeight(float factor, uint32_t elapsedMillis, EasingCurve curve);
+        static uint32_t calcOutputColor(uint32_t color, uint16_t brightnessScale, bool gamma, uint8_t *residual, bool &hasFraction);
+        static uint32_t composeColor24bit(uint32_t below, uint32_t above, LayerBlendMode mode);
+        static uint16_t calcOutputLevels(uint32_t color, uint8_t brightness, bool gamma);
+
+    protected:
+        static uint32_t stepColor24bit(uint32_t color, uint32_t target);
+        static void expandDirtySpan(DirtySpan &span, uint16_t first, uint16_t last);
+};
+
+/**
+ * @brief LED rings of the clock (outer ring and inner ring)
+ * 
+ * The geometry of both rings is known at compile time, so all buffers are sized 
+ * at compile time and the offset mapping is a constexpr lookup table.
+ * 
+ * The content of the rings is drawn on layers (see RingLayer). Each layer tracks the 
+ * span of pixels which changed, only these pixels are composited to the target frame.
+ * 
+ * Member functions are defined in ledrings.cpp and instantiated there for the 
+ * geometry configured in constants.h (see LEDRings typedef below).
+ * 
+ * @tparam OUTER RingGeometry of the outer ring
+ * @tparam INNER RingGeometry of the inner ring
+ */
+template<class OUTER, class INNER> class LEDRingsT : public LEDRingsBase{
+    public:
+        static constexpr uint16_t outerRingLedCount = OUTER::ledCount;
+        static constexpr uint16_t innerRingLedCount = INNER::ledCount;
+
+        LEDRingsT(LEDOutputDriver *outerRing, LEDOutputDriver *innerRing, UDPLogger *logger);
 
         void setupRings();
-        void setOffsets(int offsetOuterRing, int offsetInnerRing);
 
         void setBrightnessOuterRing(uint8_t brightness);
         void setBrightnessInnerRing(uint8_t brightness);
         void setCurrentLimit(uint16_t currentLimit);
+        void setCurrentCalibration(const LEDCurrentCalibration &calibration);
+        void setEasingCurve(EasingCurve curve);
+        void setGammaCorrection(bool enabled);
+        void setDithering(bool enabled);
 
         uint8_t getBrightnessOuterRing();
         uint8_t getBrightnessInnerRing();
 
-        void flushOuterRing();
-        void flushInnerRing();
+        void flushOuterRing(RingLayer layer);
+        void flushInnerRing(RingLayer layer);
+
+        void setPixelOuterRing(RingLayer layer, uint16_t pixel, uint32_t color);
+        void setPixelInnerRing(RingLayer layer, uint16_t pixel, uint32_t color);
+        void fillPixelsOuterRing(RingLayer layer, uint16_t firstPixel, uint16_t count, uint32_t color);
+        void fillPixelsInnerRing(RingLayer layer, uint16_t firstPixel, uint16_t count, uint32_t color);
+        void writePixelsOuterRing(RingLayer layer, uint16_t firstPixel, const uint32_t *colors, uint16_t count);
+        void writePixelsInnerRing(RingLayer layer, uint16_t firstPixel, const uint32_t *colors, uint16_t count);
+        uint16_t getFlushCountOuterRing(RingLayer layer);
+        uint16_t getFlushCountInnerRing(RingLayer layer);
 
-        void setPixelOuterRing(uint16_t pixel, uint32_t color);
-        void setPixelInnerRing(uint16_t pixel, uint32_t color);
+        void setLayerBlendMode(RingLayer layer, LayerBlendMode mode);
+        void setLayerVisible(RingLayer layer, bool visible);
+        void setOutputEnabled(bool enabled);
+        bool isOutputEnabled();
 
         void drawOnRingsInstant();
         void drawOnRingsSmooth(float factor);
+
+        uint32_t getFramesPushed();
+        uint32_t getFramesSkipped();
+        uint16_t getEstimatedCurrent();
+        uint16_t getOutputLevelsOuterRing(uint32_t color);
+        uint16_t getOutputLevelsInnerRing(uint32_t color);
+        bool isSettled();
         
 
     private:
-        Adafruit_NeoPixel *outerRing;
-        Adafruit_NeoPixel *innerRing;
+        LEDOutputDriver *outerRing;
+        LEDOutputDriver *innerRing;
         UDPLogger *logger;
 
         uint16_t currentLimit;
         uint8_t brightnessOuterRing;
         uint8_t brightnessInnerRing;
 
-        int offsetOuterRing;
-        int offsetInnerRing;
+        EasingCurve easingCurve;
+        uint32_t lastDrawMillis;
+        float lastBlendFactor;
+        uint32_t lastBlendElapsed;
+        uint16_t lastBlendWeight;
+
+        // dirty state of the rings (frame needs to be pushed to the LEDs)
+        bool outerRingDirty;
+        bool innerRingDirty;
+        uint8_t shownBrightnessOuterRing;
+        uint8_t shownBrightnessInnerRing;
+        uint32_t framesPushed;
+        uint32_t framesSkipped;
+
+        // layers and compositor
+        std::array<std::array<uint32_t, OUTER::ledCount>, LAYER_COUNT> layerOuterRing{};
+        std::array<std::array<uint32_t, INNER::ledCount>, LAYER_COUNT> layerInnerRing{};
+        std::array<LayerBlendMode, LAYER_COUNT> layerBlendMode;
+        std::array<bool, LAYER_COUNT> layerVisible;
+        std::array<DirtySpan, LAYER_COUNT> dirtyOuterRing;
+        std::array<DirtySpan, LAYER_COUNT> dirtyInnerRing;
+        std::array<uint16_t, LAYER_COUNT> flushCountOuterRing;  // incremented on every flush, lets incremental renderers detect a cleared layer
+        std::array<uint16_t, LAYER_COUNT> flushCountInnerRing;
+        bool outputEnabled;
+        bool outerRingSettled;              // current frame equals target frame, no interpolation needed
+        bool innerRingSettled;              // current frame equals target frame, no interpolation needed
 
-        uint32_t targetOuterring[OUTER_RING_LED_COUNT] = {0};
-        uint32_t currentOuterRing[OUTER_RING_LED_COUNT] = {0};
-        uint32_t targetInnerRing[INNER_RING_LED_COUNT] = {0};
-        uint32_t currentInnerRing[INNER_RING_LED_COUNT] = {0};
+        // current estimation and limiter
+        LEDCurrentCalibration calibration;
+        uint32_t coefficientRed;
+        uint32_t coefficientGreen;
+        uint32_t coefficientBlue;
+        uint32_t colorCurrentOuterRing;     // running sum of pixel currents at full brightness (µA)
+        uint32_t colorCurrentInnerRing;     // running sum of pixel currents at full brightness (µA)
+        uint16_t limiterScale;
+        bool limiterSettled;                // limiter scale reached its target
+        uint16_t estimatedCurrent;
 
-        void drawOnRings(float factor);
-        uint16_t calcEstimatedLEDCurrent(uint32_t color, uint8_t brightness);
+        // output stage (gamma correction and temporal dithering)
+        bool gammaCorrection;
+        bool ditheringEnabled;
+        bool fractionOuterRing;             // a pixel of the last pushed frame had a fractional part
+        bool fractionInnerRing;             // a pixel of the last pushed frame had a fractional part
+        uint8_t ditherFramesOuterRing;      // remaining dithered frames since the last change of the ring
+        uint8_t ditherFramesInnerRing;
+        bool ditherPending;                 // dithering needs further frames to show the fractional parts
+        std::array<uint8_t, OUTER::ledCount * 3> residualOuterRing{};
+        std::array<uint8_t, INNER::ledCount * 3> residualInnerRing{};
+
+        std::array<uint32_t, OUTER::ledCount> targetOuterRing{};
+        std::array<uint32_t, OUTER::ledCount> currentOuterRing{};
+        std::array<uint32_t, INNER::ledCount> targetInnerRing{};
+        std::array<uint32_t, INNER::ledCount> currentInnerRing{};
+
+        void drawOnRings(uint16_t blendWeight);
+        void compositeRings();
+        uint32_t calcPixelCurrent(uint32_t color);
+        void recalcCurrentSums();
+        void updateCurrentLimiter();
         
 };
 
+// geometry of the rings of this clock
+typedef RingGeometry<OUTER_RING_LED_COUNT, OUTER_RING_LED_OFFSET> OuterRingGeometry;
+typedef RingGeometry<INNER_RING_LED_COUNT, INNER_RING_LED_OFFSET> InnerRingGeometry;
+typedef LEDRingsT<OuterRingGeometry, InnerRingGeometry> LEDRings;
+
 
 #endif
\ No newline at end of file
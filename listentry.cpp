@@ -0,0 +1,18 @@
+#include "listentry.h"
+#include <algorithm>
+
+/**
+ * @brief Sort the entries of the listing, folders first, then the files of each folder
+ * 
+ * @param entries entries to sort (in place)
+ * @param count number of entries
+ * @param bySize true: files by size (largest first), false: files by name
+ */
+void sortListEntries(ListEntry* entries, uint16_t count, bool bySize){
+    std::sort(entries, entries + count, [bySize](const ListEntry &f, const ListEntry &l) {
+        int order = strcasecmp(f.folder, l.folder);
+        if (order != 0) return order < 0;
+        if (bySize) return f.size > l.size;
+        return strcasecmp(f.name, l.name) < 0;
+    });
+}
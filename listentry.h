@@ -0,0 +1,24 @@
+/**
+ * @file listentry.h
+ * @brief Fixed-size records of the file listing of the filesystem manager ("/list", see LittleFS.ino)
+ * 
+ * The entries are sorted in one pass: folders first (by name), inside of a folder by 
+ * name or by size (largest first). Names are compared case insensitive.
+ */
+
+#ifndef listentry_h
+#define listentry_h
+
+#include <Arduino.h>
+
+#define LIST_MAX_ENTRIES 32             // size of the static buffer of the sorted listing, more entries are listed unsorted
+
+struct ListEntry {
+    char folder[32];                    // LittleFS names have max. 31 characters, empty for files in the root
+    char name[32];
+    uint32_t size;
+};
+
+void sortListEntries(ListEntry* entries, uint16_t count, bool bySize);
+
+#endif
@@ -0,0 +1,164 @@
+#include "metrics.h"
+
+#if METRICS_ENABLED
+
+// upper limits of the histogram buckets in µs
+static const uint32_t bucketLimitsMicros[METRICS_BUCKET_COUNT] = {20, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 50000};
+static const char* const metricNames[METRIC_COUNT] = {"draw_on_rings", "led_show", "show_time", "ntp_update", "http", "ota"};
+
+// layout of the export: header, histograms of all sections, min of all sections, max of all sections 
+// (Prometheus requires the lines of one metric family to be grouped)
+#define METRICS_HEADER_LINES 4
+#define METRICS_HISTOGRAM_LINES (METRICS_BUCKET_COUNT + 3)   // buckets, +Inf, sum, count
+#define METRICS_MIN_START (METRICS_HEADER_LINES + METRIC_COUNT * METRICS_HISTOGRAM_LINES)
+#define METRICS_MAX_START (METRICS_MIN_START + 1 + METRIC_COUNT)
+#define METRICS_LINE_COUNT (METRICS_MAX_START + 1 + METRIC_COUNT)
+
+MetricHistogram Metrics::histograms[METRIC_COUNT];
+uint32_t Metrics::bucketLimitCycles[METRICS_BUCKET_COUNT];
+uint32_t Metrics::loopIterations = 0;
+uint8_t Metrics::cpuMHz = 80;
+
+/**
+ * @brief Initialize the bucket limits for the current CPU frequency, call in setup()
+ * 
+ */
+void Metrics::begin(){
+    cpuMHz = ESP.getCpuFreqMHz();
+    for(uint8_t i = 0; i < METRICS_BUCKET_COUNT; i++){
+        bucketLimitCycles[i] = bucketLimitsMicros[i] * cpuMHz;
+    }
+    for(uint8_t i = 0; i < METRIC_COUNT; i++){
+        memset(&histograms[i], 0, sizeof(MetricHistogram));
+        histograms[i].minCycles = UINT32_MAX;
+    }
+}
+
+/**
+ * @brief Record the duration of one execution of a section
+ * 
+ * @param id section
+ * @param cycles duration in CPU cycles
+ */
+void Metrics::record(MetricId id, uint32_t cycles){
+    MetricHistogram &histogram = histograms[id];
+    histogram.count++;
+    histogram.sumCycles += cycles;
+    if(cycles < histogram.minCycles) histogram.minCycles = cycles;
+    if(cycles > histogram.maxCycles) histogram.maxCycles = cycles;
+    uint8_t bucket = 0;
+    while(bucket < METRICS_BUCKET_COUNT && cycles > bucketLimitCycles[bucket]){
+        bucket++;
+    }
+    histogram.buckets[bucket]++;
+}
+
+/**
+ * @brief Count one iteration of loop()
+ * 
+ */
+void Metrics::countLoop(){
+    loopIterations++;
+}
+
+/**
+ * @brief Get the number of lines of the export
+ * 
+ * @return uint8_t number of lines
+ */
+uint8_t Metrics::getLineCount(){
+    return METRICS_LINE_COUNT;
+}
+
+/**
+ * @brief Format one line of the export in the Prometheus text format, all lines 
+ * in the order 0 ... getLineCount() - 1 give the complete export. 
+ * Min/max are reset after the last line has been formatted.
+ * 
+ * @param line number of the line
+ * @param buffer output buffer (METRICS_LINE_MAX)
+ * @param size size of the buffer
+ * @return int length of the line incl. newline
+ */
+int Metrics::formatLine(uint8_t line, char* buffer, size_t size){
+    char seconds[24];
+
+    if(line < METRICS_HEADER_LINES){
+        switch(line){
+            case 0: return snprintf(buffer, size, "# TYPE ringclock_loop_iterations_total counter\n");
+            case 1: return snprintf(buffer, size, "ringclock_loop_iterations_total %lu\n", (unsigned long)loopIterations);
+            case 2: return snprintf(buffer, size, "ringclock_uptime_seconds %lu\n", (unsigned long)(millis() / 1000));
+            default: return snprintf(buffer, size, "# TYPE ringclock_duration_seconds histogram\n");
+        }
+    }
+    if(line < METRICS_MIN_START){
+        line -= METRICS_HEADER_LINES;
+        return formatHistogramLine(line / METRICS_HISTOGRAM_LINES, line % METRICS_HISTOGRAM_LINES, buffer, size);
+    }
+    if(line == METRICS_MIN_START){
+        return snprintf(buffer, size, "# TYPE ringclock_duration_min_seconds gauge\n");
+    }
+    if(line < METRICS_MAX_START){
+        const MetricHistogram &histogram = histograms[line - METRICS_MIN_START - 1];
+        formatSeconds(histogram.minCycles == UINT32_MAX ? 0 : histogram.minCycles, seconds, sizeof(seconds));
+        return snprintf(buffer, size, "ringclock_duration_min_seconds{section=\"%s\"} %s\n", metricNames[line - METRICS_MIN_START - 1], seconds);
+    }
+    if(line == METRICS_MAX_START){
+        return snprintf(buffer, size, "# TYPE ringclock_duration_max_seconds gauge\n");
+    }
+    if(line < METRICS_LINE_COUNT){
+        uint8_t section = line - METRICS_MAX_START - 1;
+        formatSeconds(histograms[section].maxCycles, seconds, sizeof(seconds));
+        int length = snprintf(buffer, size, "ringclock_duration_max_seconds{section=\"%s\"} %s\n", metricNames[section], seconds);
+        if(line == METRICS_LINE_COUNT - 1){
+            // min/max are exported per scrape interval
+            for(uint8_t i = 0; i < METRIC_COUNT; i++){
+                histograms[i].minCycles = UINT32_MAX;
+                histograms[i].maxCycles = 0;
+            }
+        }
+        return length;
+    }
+    buffer[0] = '\0';
+    return 0;
+}
+
+/**
+ * @brief (private) Format one line of the histogram of a section
+ * 
+ */
+int Metrics::formatHistogramLine(uint8_t section, uint8_t line, char* buffer, size_t size){
+    const MetricHistogram &histogram = histograms[section];
+    const char* name = metricNames[section];
+    char seconds[24];
+
+    if(line <= METRICS_BUCKET_COUNT){
+        // cumulative buckets
+        uint32_t cumulative = 0;
+        for(uint8_t i = 0; i <= line; i++){
+            cumulative += histogram.buckets[i];
+        }
+        if(line == METRICS_BUCKET_COUNT){
+            return snprintf(buffer, size, "ringclock_duration_seconds_bucket{section=\"%s\",le=\"+Inf\"} %lu\n", name, (unsigned long)cumulative);
+        }
+        uint32_t limit = bucketLimitsMicros[line];
+        return snprintf(buffer, size, "ringclock_duration_seconds_bucket{section=\"%s\",le=\"%lu.%06lu\"} %lu\n", 
+                        name, (unsigned long)(limit / 1000000), (unsigned long)(limit % 1000000), (unsigned long)cumulative);
+    }
+    if(line == METRICS_BUCKET_COUNT + 1){
+        formatSeconds(histogram.sumCycles, seconds, sizeof(seconds));
+        return snprintf(buffer, size, "ringclock_duration_seconds_sum{section=\"%s\"} %s\n", name, seconds);
+    }
+    return snprintf(buffer, size, "ringclock_duration_seconds_count{section=\"%s\"} %lu\n", name, (unsigned long)histogram.count);
+}
+
+/**
+ * @brief (private) Format CPU cycles as seconds with µs resolution (without float)
+ * 
+ */
+void Metrics::formatSeconds(uint64_t cycles, char* buffer, size_t size){
+    uint64_t micros = cycles / cpuMHz;
+    snprintf(buffer, size, "%lu.%06lu", (unsigned long)(micros / 1000000), (unsigned long)(micros % 1000000));
+}
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file metrics.h
+ * @brief Lightweight instrumentation of the hot paths based on the CPU cycle counter
+ * 
+ * Sections are measured with METRIC_SCOPE(id), which records the cycles until the end of 
+ * the enclosing block. All data lives in static storage: count, sum, min/max (since the last 
+ * export) and a fixed-bucket histogram per section. The data is exported in the Prometheus 
+ * text format. With METRICS_ENABLED 0 (constants.h) all macros expand to nothing and nothing of 
+ * metrics.cpp is compiled.
+ */
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <Arduino.h>
+#include "constants.h"
+
+#define METRICS_BUCKET_COUNT 10     // number of finite histogram buckets (+Inf is implicit)
+#define METRICS_LINE_MAX 128        // maximum length of one exported line
+
+/**
+ * @brief Measured sections
+ * 
+ */
+enum MetricId {
+    METRIC_DRAW_ON_RINGS,           // LEDRings::drawOnRings() incl. show()
+    METRIC_LED_SHOW,                // show() of the LED drivers (bus time)
+    METRIC_SHOW_TIME,               // showTimeOnClock()
+    METRIC_NTP_UPDATE,              // NTP update task (send request / poll reply)
+    METRIC_HTTP,                    // server.handleClient()
+    METRIC_OTA,                     // handleOTA()
+    METRIC_COUNT
+};
+
+struct MetricHistogram {
+    uint32_t count;
+    uint64_t sumCycles;
+    uint32_t minCycles;             // since the last export
+    uint32_t maxCycles;             // since the last export
+    uint32_t buckets[METRICS_BUCKET_COUNT + 1]; // not cumulative, last bucket is +Inf
+};
+
+class Metrics{
+
+    public:
+        static void begin();
+        static void record(MetricId id, uint32_t cycles);
+        static void countLoop();
+        static uint8_t getLineCount();
+        static int formatLine(uint8_t line, char* buffer, size_t size);
+
+    private:
+        static int formatHistogramLine(uint8_t section, uint8_t line, char* buffer, size_t size);
+        static void formatSeconds(uint64_t cycles, char* buffer, size_t size);
+
+        static MetricHistogram histograms[METRIC_COUNT];
+        static uint32_t bucketLimitCycles[METRICS_BUCKET_COUNT];
+        static uint32_t loopIterations;
+        static uint8_t cpuMHz;
+};
+
+/**
+ * @brief Records the CPU cycles from construction until the end of the scope
+ * 
+ */
+class MetricScopedTimer{
+
+    public:
+        explicit MetricScopedTimer(MetricId id) : id(id), start(ESP.getCycleCount()) {}
+        ~MetricScopedTimer() { Metrics::record(id, ESP.getCycleCount() - start); }
+    private:
+        MetricId id;
+        uint32_t start;
+};
+
+#if METRICS_ENABLED
+#define METRIC_CONCAT_(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_(a, b)
+#define METRIC_SCOPE(id) MetricScopedTimer METRIC_CONCAT(metricTimer, __LINE__)(id)
+#define METRIC_COUNT_LOOP() Metrics::countLoop()
+#else
+#define METRIC_SCOPE(id) do {} while(0)
+#define METRIC_COUNT_LOOP() do {} while(0)
+#endif
+
+#endif
@@ -3,6 +3,21 @@ import struct
 import sys
 from datetime import datetime
 import queue
+import os
+
+# binary telemetry packets (layout see telemetry.h) are appended to this file
+TELEMETRY_CSV = 'telemetry.csv'
+TELEMETRY_MAGIC = b'\xab\xc1'
+TELEMETRY_FORMATS = {
+    # version: (struct format, field names)
+    1: ('<HBBII' 'IIIIII' 'II' 'iIiIBB' 'bBIII',
+        ['magic', 'version', 'flags', 'sequence', 'uptime',
+         'statsDuration', 'idleTime', 'renderRuns', 'renderMaxJitter', 'renderTotalDuration', 'renderMaxDuration',
+         'framesPushed', 'framesSkipped',
+         'ntpOffset', 'ntpDelay', 'ntpDrift', 'ntpTimeSinceSync', 'ntpHealth', 'ntpFailures',
+         'rssi', 'heapFragmentation', 'freeHeap', 'maxFreeBlock', 'logDropped']),
+}
+TELEMETRY_COLUMNS = ['time', 'address', 'lost', 'fps', 'idlePercent', 'renderAvgDuration'] + TELEMETRY_FORMATS[1][1][2:]
 
 # ip address of network interface
 MCAST_IF_IP = '192.168.0.3'
@@ -29,31 +44,77 @@ saveCounter = 0
 
 buffer = queue.Queue(20)
 
+# last sequence number per device, to count lost packets
+lastSequence = {}
+
+
+def handle_telemetry(data, address):
+    """Decode a telemetry packet and append it as a row to TELEMETRY_CSV"""
+    version = data[2]
+    if version not in TELEMETRY_FORMATS:
+        print(address, ": unknown telemetry version", version)
+        return
+    fmt, names = TELEMETRY_FORMATS[version]
+    if len(data) < struct.calcsize(fmt):
+        print(address, ": telemetry packet too short")
+        return
+    # newer firmware may append fields, they are ignored
+    values = dict(zip(names, struct.unpack_from(fmt, data)))
+
+    last = lastSequence.get(address[0])
+    lost = values['sequence'] - last - 1 if last is not None and values['sequence'] > last else 0
+    lastSequence[address[0]] = values['sequence']
+
+    row = dict(values)
+    row['time'] = datetime.now().isoformat(timespec='milliseconds')
+    row['address'] = address[0]
+    row['lost'] = lost
+    duration = values['statsDuration']
+    row['fps'] = round(values['renderRuns'] * 1000.0 / duration, 1) if duration else 0
+    row['idlePercent'] = round(values['idleTime'] * 100.0 / duration, 1) if duration else 0
+    row['renderAvgDuration'] = values['renderTotalDuration'] // values['renderRuns'] if values['renderRuns'] else 0
+
+    newFile = not os.path.exists(TELEMETRY_CSV)
+    with open(TELEMETRY_CSV, 'a') as f:
+        if newFile:
+            f.write(",".join(TELEMETRY_COLUMNS) + "\n")
+        f.write(",".join(str(row.get(c, '')) for c in TELEMETRY_COLUMNS) + "\n")
+
+
 # Receive/respond loop
 while True:
     data, address = sock.recvfrom(1024)
-    data_str = data.decode("utf-8").strip()
-    print(address, ": ", data_str)
-    data_str = datetime.now().strftime('%b-%d-%Y_%H%M%S') + ": " + data_str
-    buffer.put(data_str)
-    if buffer.full():
-        buffer.get()
-
-
-    if "NTP-Update not successful" in data_str or "Start program" in data_str:
-        f = open("log.txt",'a')
-        while not buffer.empty():    
-            f.write(buffer.get())
-            f.write("\n")
-        f.close()
-        saveCounter = 20
+    if data[:2] == TELEMETRY_MAGIC:
+        handle_telemetry(data, address)
+        continue
+    if data[:1] == b'\xab':
+        # other binary packets of the clocks (e.g. time beacons, see timebeacon.h)
+        continue
+    # a datagram can contain several log lines
+    for data_str in data.decode("utf-8", errors="replace").splitlines():
+        if not data_str.strip():
+            continue
+        print(address, ": ", data_str)
+        data_str = datetime.now().strftime('%b-%d-%Y_%H%M%S') + ": " + data_str
+        buffer.put(data_str)
+        if buffer.full():
+            buffer.get()
+
+
+        if "NTP-Update not successful" in data_str or "Start program" in data_str:
+            f = open("log.txt",'a')
+            while not buffer.empty():    
+                f.write(buffer.get())
+                f.write("\n")
+            f.close()
+            saveCounter = 20
         
-    if saveCounter > 0:
-        f = open("log.txt",'a')
-        f.write(data_str)
-        f.write("\n")
-        if saveCounter == 1:
+        if saveCounter > 0:
+            f = open("log.txt",'a')
+            f.write(data_str)
             f.write("\n")
-        f.close()
-        saveCounter -= 1
+            if saveCounter == 1:
+                f.write("\n")
+            f.close()
+            saveCounter -= 1
 
@@ -1,4 +1,29 @@
 #include "ntp_client_plus.h"
+#include <lwip/dns.h>
+
+/**
+ * @brief Callback of the asynchronous DNS lookup of a server (called by lwIP)
+ * 
+ * @param name host name of the lookup
+ * @param ipaddr address, nullptr if the lookup failed
+ * @param arg NTPServer of the lookup
+ */
+static void ntpServerFound(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    NTPServer *server = (NTPServer *)arg;
+    // ignore late results (lookup timed out or server replaced)
+    if (!server->lookupPending || strcmp(name, server->name) != 0)
+    {
+        return;
+    }
+    server->lookupPending = false;
+    if (ipaddr != nullptr)
+    {
+        server->ip = IPAddress(*ipaddr);
+        server->resolved = true;
+        server->resolvedMillis = millis();
+    }
+}
 
 /**
  * @brief Construct a new NTPClientPlus::NTPClientPlus object
@@ -6,59 +31,310 @@
  * @param udp   UDP client
  * @param poolServerName    time server name
  * @param utcx  UTC offset (in 1h)
- * @param _swChange should summer/winter time be considered
+ * @param _swChange should summer/winter time be considered (EU rule, use setDSTRule() for other rules)
  */
 NTPClientPlus::NTPClientPlus(UDP &udp, const char *poolServerName, int utcx, bool _swChange)
 {
     this->_udp = &udp;
     this->_utcx = utcx;
     this->_timeOffset = this->secondperhour * this->_utcx;
-    this->_poolServerName = poolServerName;
-    this->_swChange = _swChange;
+    this->addServer(poolServerName);
+    this->_dstRule = _swChange ? DST_EU : DST_NONE;
 }
 
 /**
  * @brief Starts the underlying UDP client, get first NTP timestamp and calc date
  * 
+ * @param initialUpdate get the first timestamp now (blocking), false: the first update 
+ * is done later with updateNTP() or beginUpdate()/poll()
  */
-void NTPClientPlus::setupNTPClient()
+void NTPClientPlus::setupNTPClient(bool initialUpdate)
 {
     this->_udp->begin(this->_port);
     this->_udpSetup = true;
-    this->updateNTP();
-    this->calcDate();
+    if (initialUpdate)
+    {
+        this->updateNTP();
+        this->calcDate();
+    }
 }
 
 /**
- * @brief Get new update from NTP
+ * @brief Get new update from NTP (blocking, waits up to NTP_BURST_SIZE * NTP_REPLY_TIMEOUT for the replies). 
+ * Use beginUpdate() and poll() to update without blocking.
  * 
  * @return 0     after successful update
  * @return -1    timeout after 1000 ms
  * @return 1     too much difference to previous received time (try again)
+ * @return 2     NTP time not valid (<1970)
  */
 int NTPClientPlus::updateNTP()
 {
+    this->beginUpdate();
+
+    NTPStatus status = this->poll();
+    while (status == NTP_PENDING)
+    {
+        delay(10);
+        status = this->poll();
+    }
+
+    switch (status)
+    {
+    case NTP_SUCCESS:
+        return 0;
+    case NTP_TIME_JUMP:
+        return 1;
+    case NTP_INVALID:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Start an asynchronous NTP update: a burst of NTP_BURST_SIZE queries to the configured 
+ * servers (round robin). Sends the first request and returns immediately, the replies are 
+ * received by poll().
+ * 
+ * @return true     update started
+ * @return false    an update is already in progress
+ */
+bool NTPClientPlus::beginUpdate()
+{
+    if (this->_status == NTP_PENDING)
+    {
+        return false;
+    }
+
+    this->_burstQuery = 0;
+    this->_hasSample = false;
+    this->_invalidReply = false;
+    this->_waitingForDNS = false;
+    this->_status = NTP_PENDING;
+    if (!this->startQuery())
+    {
+        this->finishUpdate(this->finishBurst());
+    }
+    return true;
+}
+
+/**
+ * @brief Check for the replies of a pending NTP update, never blocks. Should be called 
+ * regularly (e.g. every few ms) while an update is pending.
+ * 
+ * @return NTP_PENDING  still waiting for replies
+ * @return NTP_SUCCESS, NTP_TIMEOUT, NTP_TIME_JUMP, NTP_INVALID  result of the update (returned once, then NTP_IDLE)
+ * @return NTP_IDLE     no update in progress
+ */
+NTPStatus NTPClientPlus::poll()
+{
+    if (this->_status != NTP_PENDING)
+    {
+        return NTP_IDLE;
+    }
+
+    unsigned long now = millis();
+    if (this->_waitingForDNS)
+    {
+        if (this->isLookupPending() && now - this->_requestMillis < NTP_DNS_TIMEOUT)
+        {
+            return NTP_PENDING;
+        }
+        this->_waitingForDNS = false;
+        if (this->startQuery())
+        {
+            return NTP_PENDING;
+        }
+        NTPStatus result = this->finishBurst();
+        this->finishUpdate(result);
+        return result;
+    }
+
+    bool queryDone = false;
+    int cb = this->_udp->parsePacket();
+    if (cb >= NTP_PACKET_SIZE && this->_udp->remoteIP() == this->_requestIP)
+    {
+        this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
+        // only accept replies of a server (mode 4)
+        if ((this->_packetBuffer[0] & 0x07) == 4)
+        {
+            this->parseReply(now);
+            queryDone = true;
+        }
+    }
+    else if (cb > 0)
+    {
+        // not a valid NTP packet or reply of another server -> drop
+        this->_udp->flush();
+    }
+
+    if (!queryDone && now - this->_requestMillis > NTP_REPLY_TIMEOUT)
+    {
+        queryDone = true;
+    }
+    if (!queryDone)
+    {
+        return NTP_PENDING;
+    }
+
+    // next query of the burst
+    this->_burstQuery++;
+    if (this->_burstQuery < NTP_BURST_SIZE && this->startQuery())
+    {
+        return NTP_PENDING;
+    }
+    NTPStatus result = this->finishBurst();
+    this->finishUpdate(result);
+    return result;
+}
+
+/**
+ * @brief Check if an asynchronous update is in progress
+ * 
+ * @return true     waiting for the reply of the server
+ * @return false    no update in progress
+ */
+bool NTPClientPlus::isUpdatePending() const
+{
+    return this->_status == NTP_PENDING;
+}
+
+/**
+ * @brief Get the result of the last finished update
+ * 
+ * @return NTPStatus result (NTP_IDLE if no update finished yet)
+ */
+NTPStatus NTPClientPlus::getLastStatus() const
+{
+    return this->_lastStatus;
+}
 
-    // flush any existing packets
+/**
+ * @brief Set a function which is called when an asynchronous update finished
+ * 
+ * @param callback function called with the result of the update (from within poll())
+ */
+void NTPClientPlus::setUpdateCallback(NTPUpdateCallback callback)
+{
+    this->_callback = callback;
+}
+
+/**
+ * @brief (private) Send the next query of the burst to the next server which has an address. 
+ * Servers without address are skipped while their lookup is pending, if no server has an 
+ * address yet, poll() waits for the lookup.
+ * 
+ * @return true     query sent or waiting for the DNS lookup
+ * @return false    no server could be resolved
+ */
+bool NTPClientPlus::startQuery()
+{
+    // flush any existing packets (e.g. late replies of a previous request)
     while (this->_udp->parsePacket() != 0)
         this->_udp->flush();
 
-    this->sendNTPPacket();
+    bool lookupStarted = false;
+    for (uint8_t i = 0; i < this->_serverCount; i++)
+    {
+        NTPServer &server = this->_servers[this->_nextServer];
+        this->_nextServer = (this->_nextServer + 1) % this->_serverCount;
+        if (this->resolveServer(server, lookupStarted))
+        {
+            this->_requestIP = server.ip;
+            if (this->sendNTPPacket())
+            {
+                this->_requestMillis = millis();
+                return true;
+            }
+        }
+    }
+    if (this->isLookupPending())
+    {
+        this->_waitingForDNS = true;
+        this->_requestMillis = millis();
+        return true;
+    }
+    return false;
+}
 
-    // Wait till data is there or timeout...
-    byte timeout = 0;
-    int cb = 0;
-    do
+/**
+ * @brief (private) Resolve the address of a server without blocking, the result is cached 
+ * for NTP_DNS_CACHE_TIME. The lookup is asynchronous (lwIP), at most one lookup is in progress 
+ * and a server is looked up at most every NTP_DNS_RETRY. If the lookup fails, a previously 
+ * resolved address is used further.
+ * 
+ * @param server server to resolve
+ * @param lookupStarted true if a lookup was started during this query, set if this call starts one
+ * @return true     server has an address
+ * @return false    server has no address (yet)
+ */
+bool NTPClientPlus::resolveServer(NTPServer &server, bool &lookupStarted)
+{
+    unsigned long now = millis();
+    if (server.resolved && now - server.resolvedMillis < NTP_DNS_CACHE_TIME)
     {
-        delay(10);
-        cb = this->_udp->parsePacket();
-        if (timeout > 100)
-            return -1; // timeout after 1000 ms
-        timeout++;
-    } while (cb == 0);
+        return true;
+    }
+    if (server.lookupPending && now - server.lookupMillis >= NTP_DNS_TIMEOUT)
+    {
+        // no answer, a late result is ignored by the callback
+        server.lookupPending = false;
+    }
+    if (server.lookupPending || lookupStarted || this->isLookupPending() || 
+        (server.lookupMillis != 0 && now - server.lookupMillis < NTP_DNS_RETRY))
+    {
+        return server.resolved;
+    }
 
-    this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
+    lookupStarted = true;
+    server.lookupMillis = now;
+    ip_addr_t address;
+    server.lookupPending = true;
+    err_t err = dns_gethostbyname(server.name, &address, ntpServerFound, &server);
+    if (err == ERR_OK)
+    {
+        // cached by lwIP or an IP address
+        server.lookupPending = false;
+        server.ip = IPAddress(address);
+        server.resolved = true;
+        server.resolvedMillis = now;
+    }
+    else if (err != ERR_INPROGRESS)
+    {
+        server.lookupPending = false;
+    }
+    return server.resolved;
+}
 
+/**
+ * @brief (private) Check if the DNS lookup of a server is in progress
+ * 
+ * @return true     lookup in progress
+ * @return false    no lookup in progress
+ */
+bool NTPClientPlus::isLookupPending() const
+{
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < this->_serverCount; i++)
+    {
+        const NTPServer &server = this->_servers[i];
+        if (server.lookupPending && now - server.lookupMillis < NTP_DNS_TIMEOUT)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief (private) Parse the reply of the server in the packet buffer and keep it 
+ * as sample if it has the lowest delay of the burst
+ * 
+ * @param receiveMillis time the reply was received
+ */
+void NTPClientPlus::parseReply(unsigned long receiveMillis)
+{
     unsigned long highWord = word(this->_packetBuffer[40], this->_packetBuffer[41]);
     unsigned long lowWord = word(this->_packetBuffer[42], this->_packetBuffer[43]);
     // combine the four bytes (two words) into a long integer
@@ -67,28 +343,167 @@ int NTPClientPlus::updateNTP()
 
     if(tempSecsSince1900 < SEVENZYYEARS){
         // NTP time is not valid
-        return 2;
+        this->_invalidReply = true;
+        return;
+    }
+
+    // server time at reception of the reply: transmit timestamp T3 plus half of the network delay
+    // (round trip T4 - T1 minus processing time of the server T3 - T2)
+    uint64_t receiveTimestamp = ntpToEpochMillis(&this->_packetBuffer[32]);     // T2
+    uint64_t transmitTimestamp = ntpToEpochMillis(&this->_packetBuffer[40]);    // T3
+    long roundTrip = receiveMillis - this->_requestMillis;
+    long serverProcessing = (long)(transmitTimestamp - receiveTimestamp);
+    long networkDelay = roundTrip - serverProcessing;
+    if(networkDelay < 0) networkDelay = 0;
+
+    // lowest delay sample has the smallest error of the offset
+    if(!this->_hasSample || (unsigned long)networkDelay < this->_bestSample.delay){
+        this->_bestSample.serverEpochMillis = transmitTimestamp + networkDelay / 2;
+        this->_bestSample.localMillis = receiveMillis;
+        this->_bestSample.delay = networkDelay;
+        this->_bestSample.secsSince1900 = tempSecsSince1900;
+        this->_hasSample = true;
+    }
+}
+
+/**
+ * @brief (private) Finish the burst: synchronize the time base to the best sample
+ * 
+ * @return NTPStatus result of the update
+ */
+NTPStatus NTPClientPlus::finishBurst()
+{
+    if (!this->_hasSample)
+    {
+        return this->_invalidReply ? NTP_INVALID : NTP_TIMEOUT;
     }
 
+    unsigned long tempSecsSince1900 = this->_bestSample.secsSince1900;
+
     // check if time off last ntp update is roughly in the same range: 100sec apart (validation check)
     if(this->_lastSecsSince1900 == 0 || tempSecsSince1900 - this->_lastSecsSince1900 < 100000){
         // Only update time then
-        this->_lastUpdate = millis() - (10 * (timeout + 1)); // Account for delay in reading the time
-
         this->_secsSince1900 = tempSecsSince1900;
 
         this->_currentEpoc = this->_secsSince1900 - SEVENZYYEARS;
 
+        this->_roundTripDelay = this->_bestSample.delay;
+        this->syncTimeBase(this->_bestSample.serverEpochMillis, this->_bestSample.localMillis);
+
         // Remember time of last update
         this->_lastSecsSince1900 = tempSecsSince1900;
 
-        return 0; // return 0 after successful update
+        return NTP_SUCCESS;
     }
     else{
         // Remember time of last update
         this->_lastSecsSince1900 = tempSecsSince1900;
         
-        return 1;
+        return NTP_TIME_JUMP;
+    }
+}
+
+/**
+ * @brief (private) Convert a 64bit NTP timestamp (seconds since 1900 and 32bit fraction) to UTC epoch milliseconds
+ * 
+ * @param timestamp pointer to the 8 bytes of the timestamp in the packet
+ * @return uint64_t milliseconds since 1. Jan. 1970
+ */
+uint64_t NTPClientPlus::ntpToEpochMillis(const byte *timestamp)
+{
+    uint32_t seconds = (uint32_t)timestamp[0] << 24 | (uint32_t)timestamp[1] << 16 | (uint32_t)timestamp[2] << 8 | timestamp[3];
+    uint32_t fraction = (uint32_t)timestamp[4] << 24 | (uint32_t)timestamp[5] << 16 | (uint32_t)timestamp[6] << 8 | timestamp[7];
+    return (uint64_t)(seconds - SEVENZYYEARS) * 1000 + (((uint64_t)fraction * 1000) >> 32);
+}
+
+/**
+ * @brief (private) Estimate the UTC epoch milliseconds at a given local time based on the time base
+ * 
+ * @param localMillis local millis()
+ * @return uint64_t milliseconds since 1. Jan. 1970 (UTC)
+ */
+uint64_t NTPClientPlus::estimateEpochMillis(unsigned long localMillis) const
+{
+    uint32_t elapsed = localMillis - this->_baseMillis;
+
+    // compensate the drift of the oscillator
+    int64_t corrected = (int64_t)elapsed + (int64_t)elapsed * this->_driftPpb / 1000000000LL;
+
+    // slew the offset to the server gradually (at most 1 ms per NTP_SLEW_DIVISOR ms)
+    long maxSlew = elapsed / NTP_SLEW_DIVISOR;
+    long slew = this->_slewOffset;
+    if(slew > maxSlew) slew = maxSlew;
+    if(slew < -maxSlew) slew = -maxSlew;
+
+    return this->_baseEpochMillis + corrected + slew;
+}
+
+/**
+ * @brief (private) Synchronize the time base to the server time. Large offsets are stepped, 
+ * small offsets are slewed, and the drift of the local oscillator is estimated from the 
+ * server time between two syncs which are at least NTP_DRIFT_MIN_INTERVAL apart.
+ * 
+ * @param serverEpochMillis server time (UTC epoch ms) at localMillis
+ * @param localMillis local millis() of the reception of the reply
+ */
+void NTPClientPlus::syncTimeBase(uint64_t serverEpochMillis, unsigned long localMillis)
+{
+    uint64_t estimate = this->estimateEpochMillis(localMillis);
+    long offset = (long)(int64_t)(serverEpochMillis - estimate);
+    this->_lastOffset = offset;
+
+    if(!this->_synced || offset > NTP_STEP_THRESHOLD || offset < -NTP_STEP_THRESHOLD){
+        // step
+        this->_baseEpochMillis = serverEpochMillis;
+        this->_slewOffset = 0;
+    }
+    else{
+        // slew from the current estimate on, so the clock never jumps
+        this->_baseEpochMillis = estimate;
+        this->_slewOffset = offset;
+    }
+    this->_baseMillis = localMillis;
+
+    // drift of the oscillator: difference of server and local elapsed time since the reference sync, 
+    // the reference is kept for NTP_DRIFT_MIN_INTERVAL so frequent syncs (time beacons) give drift samples too
+    uint32_t localElapsed = localMillis - this->_driftRefMillis;
+    if(!this->_synced || this->_driftRefEpochMillis == 0){
+        this->_driftRefMillis = localMillis;
+        this->_driftRefEpochMillis = serverEpochMillis;
+    }
+    else if(localElapsed >= NTP_DRIFT_MIN_INTERVAL){
+        int64_t serverElapsed = (int64_t)(serverEpochMillis - this->_driftRefEpochMillis);
+        int64_t sample = (serverElapsed - (int64_t)localElapsed) * 1000000000LL / localElapsed;
+        if(sample < NTP_DRIFT_MAX_PPB && sample > -NTP_DRIFT_MAX_PPB){
+            this->_driftPpb += (sample - this->_driftPpb) / NTP_DRIFT_EMA_WEIGHT;
+        }
+        this->_driftRefMillis = localMillis;
+        this->_driftRefEpochMillis = serverEpochMillis;
+    }
+    this->_lastSyncMillis = localMillis;
+    this->_synced = true;
+}
+
+/**
+ * @brief (private) Finish the pending update and notify the callback
+ * 
+ * @param status result of the update
+ */
+void NTPClientPlus::finishUpdate(NTPStatus status)
+{
+    this->_status = NTP_IDLE;
+    this->_lastStatus = status;
+    if (status == NTP_SUCCESS)
+    {
+        this->_consecutiveFailures = 0;
+    }
+    else if (this->_consecutiveFailures < 255)
+    {
+        this->_consecutiveFailures++;
+    }
+    if (this->_callback)
+    {
+        this->_callback(status);
     }
 }
 
@@ -106,26 +521,198 @@ void NTPClientPlus::end()
 /**
  * @brief Setter TimeOffset
  * 
- * @param timeOffset offset from UTC in seconds
+ * @param timeOffset offset of the standard time from UTC in seconds (without daylight saving time)
  */
 void NTPClientPlus::setTimeOffset(int timeOffset)
 {
     this->_timeOffset = timeOffset;
+    this->_dstValid = false;
+    this->_dateValid = false;
 }
 
+/**
+ * @brief Get the current offset from UTC
+ * 
+ * @return long offset in seconds including daylight saving time
+ */
 long NTPClientPlus::getTimeOffset()
 {
-    return this->_timeOffset;
+    return this->getOffsetAt(this->estimateEpochMillis(millis()) / 1000);
 }
 
 /**
- * @brief Set time server name
+ * @brief Set the daylight saving time rule
+ * 
+ * @param rule DST_NONE, DST_EU or DST_US
+ */
+void NTPClientPlus::setDSTRule(DSTRule rule)
+{
+    this->_dstRule = rule;
+    this->_dstValid = false;
+    this->_dateValid = false;
+}
+
+/**
+ * @brief Set time server name (replaces all configured servers)
  * 
  * @param poolServerName 
  */
 void NTPClientPlus::setPoolServerName(const char *poolServerName)
 {
-    this->_poolServerName = poolServerName;
+    this->_serverCount = 0;
+    this->_nextServer = 0;
+    this->addServer(poolServerName);
+}
+
+/**
+ * @brief Add a time server, the servers are queried round robin
+ * 
+ * @param serverName host name or IP address of the server
+ * @return true     server added
+ * @return false    maximum number of servers reached
+ */
+bool NTPClientPlus::addServer(const char *serverName)
+{
+    if (serverName == nullptr || this->_serverCount >= NTP_MAX_SERVERS)
+    {
+        return false;
+    }
+    NTPServer &server = this->_servers[this->_serverCount++];
+    server.name = serverName;
+    server.resolved = false;
+    server.resolvedMillis = 0;
+    server.lookupPending = false;
+    server.lookupMillis = 0;
+    return true;
+}
+
+/**
+ * @brief Set the interval between two successful updates (see getNextUpdateDelay())
+ * 
+ * @param updateInterval interval in ms
+ */
+void NTPClientPlus::setUpdateInterval(unsigned long updateInterval)
+{
+    this->_updateInterval = updateInterval;
+}
+
+/**
+ * @brief Get the delay until the next update should be started. After a successful update 
+ * this is the update interval, after failures the delay grows exponentially from 
+ * NTP_BACKOFF_MIN up to NTP_BACKOFF_MAX with a random jitter of +-12.5%, so many clocks 
+ * do not retry in sync.
+ * 
+ * @return unsigned long delay in ms
+ */
+unsigned long NTPClientPlus::getNextUpdateDelay()
+{
+    if (this->_consecutiveFailures == 0)
+    {
+        return this->_updateInterval;
+    }
+    unsigned long backoff = NTP_BACKOFF_MIN;
+    for (uint8_t i = 1; i < this->_consecutiveFailures && backoff < NTP_BACKOFF_MAX; i++)
+    {
+        backoff *= 2;
+    }
+    if (backoff > NTP_BACKOFF_MAX)
+    {
+        backoff = NTP_BACKOFF_MAX;
+    }
+    long jitter = backoff / 8;
+    return backoff + random(-jitter, jitter + 1);
+}
+
+/**
+ * @brief Get the health of the time synchronization. The clock keeps running on the drift 
+ * compensated time base if the servers are not reachable.
+ * 
+ * @return NTPHealth health
+ */
+NTPHealth NTPClientPlus::getHealth() const
+{
+    if (!this->_synced)
+    {
+        return NTP_HEALTH_UNSYNCED;
+    }
+    if (this->getTimeSinceSync() > NTP_FREE_RUNNING_AGE)
+    {
+        return NTP_HEALTH_FREE_RUNNING;
+    }
+    if (this->_consecutiveFailures >= NTP_DEGRADED_FAILURES)
+    {
+        return NTP_HEALTH_DEGRADED;
+    }
+    return NTP_HEALTH_SYNCED;
+}
+
+/**
+ * @brief Get the number of failed updates since the last successful update
+ * 
+ * @return uint8_t number of failed updates
+ */
+uint8_t NTPClientPlus::getConsecutiveFailures() const
+{
+    return this->_consecutiveFailures;
+}
+
+/**
+ * @brief Get the time since the last successful sync
+ * 
+ * @return unsigned long time in ms (0 if never synced)
+ */
+unsigned long NTPClientPlus::getTimeSinceSync() const
+{
+    if (!this->_synced)
+    {
+        return 0;
+    }
+    return millis() - this->_lastSyncMillis;
+}
+
+/**
+ * @brief Get milliseconds since 1. Jan. 1970 in UTC (without time offset), e.g. for a snapshot of the time base
+ * 
+ * @return uint64_t milliseconds since 1. Jan. 1970 (UTC)
+ */
+uint64_t NTPClientPlus::getUTCEpochMillis() const
+{
+    return this->estimateEpochMillis(millis());
+}
+
+/**
+ * @brief Synchronize the time base to an external time source (e.g. the time beacon of another 
+ * clock) like to an NTP reply: small offsets are slewed, the drift is estimated
+ * 
+ * @param utcEpochMillis time of the source (UTC epoch ms) at localMillis
+ * @param localMillis local millis() of the reception of the time
+ */
+void NTPClientPlus::syncExternal(uint64_t utcEpochMillis, unsigned long localMillis)
+{
+    this->syncTimeBase(utcEpochMillis, localMillis);
+    this->_consecutiveFailures = 0;
+}
+
+/**
+ * @brief Restore the time base from a snapshot (e.g. after a restart), the clock runs 
+ * immediately and the next NTP update only refines the time (slewed if the offset is small)
+ * 
+ * @param utcEpochMillis current time (UTC epoch ms)
+ * @param driftPpb estimated drift of the oscillator (ppb)
+ * @param timeSinceSync time since the last successful sync (ms)
+ */
+void NTPClientPlus::restoreTime(uint64_t utcEpochMillis, long driftPpb, unsigned long timeSinceSync)
+{
+    unsigned long now = millis();
+    this->_baseMillis = now;
+    this->_baseEpochMillis = utcEpochMillis;
+    this->_slewOffset = 0;
+    this->_driftPpb = driftPpb;
+    this->_lastSyncMillis = now - timeSinceSync;
+    // the elapsed time across the restart is not exact enough for a drift sample
+    this->_driftRefEpochMillis = 0;
+    this->_synced = true;
+    this->_dateValid = false;
 }
 
 /**
@@ -135,9 +722,104 @@ void NTPClientPlus::setPoolServerName(const char *poolServerName)
  */
 unsigned long NTPClientPlus::getSecsSince1900() const
 {
-    return this->_timeOffset +                      // User offset
-           this->_secsSince1900 +                   // seconds returned by the NTP server
-           ((millis() - this->_lastUpdate) / 1000); // Time since last update
+    return this->getEpochMillis() / 1000 + SEVENZYYEARS;
+}
+
+/**
+ * @brief Get milliseconds since 1. Jan. 1970 including the time offset (same base as getEpochTime()). 
+ * Based on the NTP fraction and round trip delay, compensated for the drift of the oscillator 
+ * and slewed gradually after a sync, so this clock never jumps on small corrections.
+ * 
+ * @return uint64_t milliseconds since 1. Jan. 1970
+ */
+uint64_t NTPClientPlus::getEpochMillis() const
+{
+    uint64_t utcMillis = this->estimateEpochMillis(millis());
+    return utcMillis + (int64_t)this->getOffsetAt(utcMillis / 1000) * 1000;
+}
+
+/**
+ * @brief (private) Get the offset from UTC at the given time. The daylight saving time state is cached 
+ * until the next transition, so this is a range check on nearly every call.
+ * 
+ * @param utcSecs UTC epoch in seconds
+ * @return long offset in seconds including daylight saving time
+ */
+long NTPClientPlus::getOffsetAt(uint32_t utcSecs) const
+{
+    if (!this->_dstValid || utcSecs < this->_dstValidFrom || utcSecs >= this->_dstValidUntil)
+    {
+        this->updateDSTCache(utcSecs);
+    }
+    return this->_timeOffset + (this->_dstActive ? (long)this->secondperhour : 0);
+}
+
+/**
+ * @brief (private) Precompute the daylight saving time state and the interval it is valid for
+ * 
+ * @param utcSecs UTC epoch in seconds
+ */
+void NTPClientPlus::updateDSTCache(uint32_t utcSecs) const
+{
+    int16_t year = Calendar::civilFromDays(utcSecs / secondperday).year;
+    uint32_t start = 0;
+    uint32_t end = 0;
+
+    this->_dstValid = true;
+    if (!Calendar::calcDSTTransitions(this->_dstRule, year, this->_timeOffset, start, end))
+    {
+        this->_dstActive = false;
+        this->_dstValidFrom = 0;
+        this->_dstValidUntil = UINT32_MAX;
+    }
+    else if (utcSecs < start)
+    {
+        this->_dstActive = false;
+        this->_dstValidFrom = Calendar::daysFromCivil(year, 1, 1) * secondperday;
+        this->_dstValidUntil = start;
+    }
+    else if (utcSecs < end)
+    {
+        this->_dstActive = true;
+        this->_dstValidFrom = start;
+        this->_dstValidUntil = end;
+    }
+    else
+    {
+        this->_dstActive = false;
+        this->_dstValidFrom = end;
+        this->_dstValidUntil = Calendar::daysFromCivil(year + 1, 1, 1) * secondperday;
+    }
+}
+
+/**
+ * @brief Get the network round trip delay of the last NTP reply
+ * 
+ * @return unsigned long delay in ms
+ */
+unsigned long NTPClientPlus::getRoundTripDelay() const
+{
+    return this->_roundTripDelay;
+}
+
+/**
+ * @brief Get the offset between server and local clock at the last sync
+ * 
+ * @return long offset in ms (positive = local clock was behind)
+ */
+long NTPClientPlus::getLastOffset() const
+{
+    return this->_lastOffset;
+}
+
+/**
+ * @brief Get the estimated drift of the local oscillator
+ * 
+ * @return long drift in ppb (positive = local clock is slow)
+ */
+long NTPClientPlus::getDriftPpb() const
+{
+    return this->_driftPpb;
 }
 
 /**
@@ -235,87 +917,36 @@ String NTPClientPlus::getFormattedDate() {
 
 
 /**
- * @brief Calc date from seconds since 1900
+ * @brief Calc date of the local time. The date fields are cached and only recalculated 
+ * when the local day rolls over.
  * 
  */
 void NTPClientPlus::calcDate()
 {
-    // Start: Calc date
-
-    // get days since 1900
-    unsigned long days1900 = this->getSecsSince1900() / secondperday;
-
-    // calc current year
-    this->_dateYear = this->getYear();
-
-    // calc how many leap days since 1.Jan 1900
-    int leapDays = 0;
-    for (unsigned int i = 1900; i < this->_dateYear; i++)
-    {
-        // check if leap year
-        if (this->isLeapYear(i))
-        {
-            leapDays++;
-        }
-    }
-    leapDays = leapDays - 1;
-
-    // check if current year is leap year
-    if (this->isLeapYear(this->_dateYear))
-    {
-        daysInMonth[2] = 29;
-    }
-    else
-    {
-        daysInMonth[2] = 28;
-    }
-
-    unsigned int dayOfYear = (days1900 - ((this->_dateYear - 1900) * 365) - leapDays);
-
-    // calc current month
-    this->_dateMonth = this->getMonth(dayOfYear);
-
-    this->_dateDay = 0;
-
-    // calc day of month
-    for (unsigned int i = 0; i < this->_dateMonth; i++)
+    int32_t localDays = this->getEpochTime() / secondperday;
+    if (this->_dateValid && localDays == this->_dateDays)
     {
-        this->_dateDay = this->_dateDay + daysInMonth[i];
+        return;
     }
-    this->_dateDay = dayOfYear - this->_dateDay;
 
-    // calc day of week:
+    CivilDate date = Calendar::civilFromDays(localDays);
+    this->_dateYear = date.year;
+    this->_dateMonth = date.month;
+    this->_dateDay = date.day;
     // Monday = 1, Tuesday = 2, Wednesday = 3, Thursday = 4, Friday = 5, Saturday = 6, Sunday = 7
-    // 1. Januar 1900 was a monday
-    this->_dayOfWeek = 1;
-
-    for (unsigned long i = 0; i < days1900; i++)
-    {
-
-        if (this->_dayOfWeek < 7)
-        {
-            this->_dayOfWeek = this->_dayOfWeek + 1;
-        }
-        else
-        {
-            this->_dayOfWeek = 1;
-        }
-    }
-
-    // End: Calc date (dateDay, dateMonth, dateYear)
-
-    // calc if summer time active
-
-    this->updateSWChange();
+    this->_dayOfWeek = Calendar::weekdayFromDays(localDays);
+    this->_dateDays = localDays;
+    this->_dateValid = true;
 }
 
 /**
  * @brief Getter for day of the week
  * 
- * @return unsigned int 
+ * @return unsigned int (Monday = 1 ... Sunday = 7)
  */
 unsigned int NTPClientPlus::getDayOfWeek()
 {
+    this->calcDate();
     return this->_dayOfWeek;
 }
 
@@ -326,45 +957,8 @@ unsigned int NTPClientPlus::getDayOfWeek()
  */
 unsigned int NTPClientPlus::getYear()
 {
-
-    unsigned long sec1900 = this->getSecsSince1900();
-
-    //NTP starts at 1. Jan 1900
-    unsigned int result = 1900;
-    unsigned int dayInYear = 0;
-    unsigned int days = 0;
-    unsigned int days1900 = 0;
-
-    unsigned int for_i = 0;
-    bool leapYear = LOW;
-
-    days1900 = sec1900 / this->secondperday;
-
-    for (for_i = 0; for_i < days1900; for_i++)
-    {
-
-        leapYear = this->isLeapYear(result);
-
-        if (leapYear)
-        {
-            dayInYear = 366;
-        }
-
-        else
-        {
-            dayInYear = 365;
-        }
-
-        days++;
-
-        if (days >= dayInYear)
-        {
-            result++;
-            days = 0;
-        }
-    }
-
-    return result;
+    this->calcDate();
+    return this->_dateYear;
 }
 
 /**
@@ -376,151 +970,42 @@ unsigned int NTPClientPlus::getYear()
  */
 bool NTPClientPlus::isLeapYear(unsigned int year)
 {
-
-    bool result = LOW;
-
-    // check for leap year
-    if ((year % 4) == 0)
-    {
-
-        result = HIGH;
-
-        if ((year % 100) == 0)
-        {
-
-            result = LOW;
-
-            if ((year % 400) == 0)
-            {
-
-                result = HIGH;
-            }
-        }
-    }
-
-    else
-    {
-        result = LOW;
-    }
-
-    return result;
+    return Calendar::isLeapYear(year);
 }
 
 /**
- * @brief Get Month of given day of year
+ * @brief Get Month of given day of year (of the current year)
  * 
- * @param dayOfYear 
- * @return int 
+ * @param dayOfYear day of year (1-366)
+ * @return int month (1-12), 0 if dayOfYear is out of range
  */
 int NTPClientPlus::getMonth(int dayOfYear)
 {
+    // days before the beginning of each month (non leap year)
+    static const uint16_t monthStart[13] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365};
+    int leapDay = this->isLeapYear(this->getYear()) ? 1 : 0;
 
-    bool leapYear = this->isLeapYear(this->getYear());
-
-    // Month beginnings
-    int monthMin[13] = {0, 1, 32, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335};
-    // Month endings
-    int monthMax[13] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365};
-
-    int month = 0;
-
-    int y = 0;
-
-    // Calculation of the beginning and end of each month in the leap year
-    if (leapYear == HIGH)
+    if (dayOfYear < 1 || dayOfYear > 365 + leapDay)
     {
-
-        for (y = 3; y < 13; y++)
-        {
-            monthMin[y] = monthMin[y] + 1;
-        }
-
-        for (y = 2; y < 13; y++)
-        {
-            monthMax[y] = monthMax[y] + 1;
-        }
-    }
-
-    // January
-    if (dayOfYear >= monthMin[1] && dayOfYear <= monthMax[1])
-    {
-        month = 1;
+        return 0;
     }
-
-    // February
-    if (dayOfYear >= monthMin[2] && dayOfYear <= monthMax[2])
-    {
-        month = 2;
-    }
-
-    // March
-    if (dayOfYear >= monthMin[3] && dayOfYear <= monthMax[3])
-    {
-        month = 3;
-    }
-
-    // April
-    if (dayOfYear >= monthMin[4] && dayOfYear <= monthMax[4])
+    if (dayOfYear <= monthStart[2] + leapDay)
     {
-        month = 4;
+        return dayOfYear > monthStart[1] ? 2 : 1;
     }
-
-    // May
-    if (dayOfYear >= monthMin[5] && dayOfYear <= monthMax[5])
-    {
-        month = 5;
-    }
-
-    // June
-    if (dayOfYear >= monthMin[6] && dayOfYear <= monthMax[6])
-    {
-        month = 6;
-    }
-
-    // July
-    if (dayOfYear >= monthMin[7] && dayOfYear <= monthMax[7])
-    {
-        month = 7;
-    }
-
-    // August
-    if (dayOfYear >= monthMin[8] && dayOfYear <= monthMax[8])
-    {
-        month = 8;
-    }
-
-    // September
-    if (dayOfYear >= monthMin[9] && dayOfYear <= monthMax[9])
-    {
-        month = 9;
-    }
-
-    // October
-    if (dayOfYear >= monthMin[10] && dayOfYear <= monthMax[10])
-    {
-        month = 10;
-    }
-
-    // November
-    if (dayOfYear >= monthMin[11] && dayOfYear <= monthMax[11])
-    {
-        month = 11;
-    }
-
-    // December
-    if (dayOfYear >= monthMin[12] && dayOfYear <= monthMax[12])
-    {
-        month = 12;
-    }
-
+    // from march on the closed form of civilFromDays applies (month start = (153 * m + 2) / 5)
+    int dayOfMarchYear = dayOfYear - (monthStart[2] + leapDay) - 1;
+    int month = (5 * dayOfMarchYear + 2) / 153 + 3;
     return month;
 }
 
 /**
- * @brief (private) Send NTP Packet to NTP server
+ * @brief (private) Send NTP Packet to the server of the current query
  * 
+ * @return true     packet sent
+ * @return false    packet could not be sent
  */
-void NTPClientPlus::sendNTPPacket()
+bool NTPClientPlus::sendNTPPacket()
 {
     // set all bytes in the buffer to 0
     memset(this->_packetBuffer, 0, NTP_PACKET_SIZE);
@@ -537,156 +1022,21 @@ void NTPClientPlus::sendNTPPacket()
 
     // all NTP fields have been given values, now
     // you can send a packet requesting a timestamp:
-    if (this->_poolServerName)
+    if (!this->_udp->beginPacket(this->_requestIP, 123))
     {
-        this->_udp->beginPacket(this->_poolServerName, 123);
-    }
-    else
-    {
-        this->_udp->beginPacket(this->_poolServerIP, 123);
+        return false;
     }
     this->_udp->write(this->_packetBuffer, NTP_PACKET_SIZE);
-    this->_udp->endPacket();
+    return this->_udp->endPacket() == 1;
 }
 
 /**
- * @brief (private) Set time offset accordance to summer time
- * 
- * @param summertime 
- */
-void NTPClientPlus::setSummertime(bool summertime)
-{
-    if (summertime)
-    {
-        this->_timeOffset = this->secondperhour * (this->_utcx + 1);
-    }
-    else
-    {
-        this->_timeOffset = this->secondperhour * (this->_utcx);
-    }
-}
-
-/**
- * @brief (private) Update Summer/Winter time change
+ * @brief Check if the daylight saving time is currently active
  * 
  * @returns bool summertime active
  */
 bool NTPClientPlus::updateSWChange()
 {
-    unsigned int dayOfWeek = this->_dayOfWeek; 
-    unsigned int dateDay = this->_dateDay; 
-    unsigned int dateMonth = this->_dateMonth;
-
-    bool summertimeActive = false;
-    
-    if (this->_swChange)
-    {
-        //Start: Set summer-/ winter time
-
-        // current month is march
-        if (dateMonth == 3)
-        {
-
-            // it is last week in march
-            if ((this->daysInMonth[3] - dateDay) < 7)
-            {
-
-                //Example year 2020: March 31 days; Check on March 26, 2020 (Thursday = weekday = 4); 5 days remaining; Last Sunday March 29, 2020
-                //Calculation: 31 - 26 = 5; 5 + 4 = 9;
-                //Result: Last day in March is a Tuesday. There follows another Sunday in October => set winter time
-
-                //Example year 2021: March 31 days; Check on March 30, 2021 (Tuesday = weekday = 2); 1 days remaining; Last Sunday March 28, 2021
-                //Calculation: 31 - 30 = 1; 1 + 2 = 3;
-                //Result: Last day in March is a Wednesday. Changeover to summer time already done => set summer time
-
-                // If today is Sunday (dayOfWeek == 7) then this is already the last sunday in march -> set summer time
-                if(dayOfWeek == 7){
-                    this->setSummertime(1);
-                    summertimeActive = true;
-                }
-
-                //There follows within the last week in March one more Sunday => set winter time
-                else if (((this->daysInMonth[3] - dateDay) + dayOfWeek) >= 7)
-                {
-                    this->setSummertime(0);
-                    summertimeActive = false;
-                }
-
-                // last sunday in march already over -> set summer time
-                else
-                {
-                    this->setSummertime(1);
-                    summertimeActive = true;
-                }
-            }
-
-            // Check in first three weeks of march -> winter time
-            else
-            {
-                this->setSummertime(0);
-                summertimeActive = false;
-            }
-        }
-
-        // current month is october
-        else if (dateMonth == 10)
-        {
-
-            // Check in last week of october
-            if ((this->daysInMonth[10] - dateDay) < 7)
-            {
-
-                //Example year 2020: October 31 days; Check on October 26, 2020 (Monday = weekday = 1); 5 days remaining; last Sunday October 25, 2020
-                //Calculation: 31 - 26 = 5; 5 + 1 = 6;
-                //Result: Last day in October is a Saturday. Changeover to winter time already done => set winter time
-
-                //Example year 2021: October 31 days; Check on 26. October 2021 (Tuesday = weekday = 2); 5 days remaining; Last Sunday 31. October 2021
-                //Calculation: 31 - 26 = 5; 5 + 2 = 7;
-                //Result: Last day in October is a Sunday. There follows another Sunday in October => set summer time
-                
-                // If today is Sunday (dayOfWeek == 7) then this is already the last sunday in october -> winter time
-                if(dayOfWeek == 7){
-                    this->setSummertime(0);
-                    summertimeActive = false;
-                }
-
-                // There follows within the last week in October one more Sunday => summer time
-                else if (((this->daysInMonth[10] - dateDay) + dayOfWeek) >= 7)
-                {
-                    this->setSummertime(1);
-                    summertimeActive = true;
-                }
-
-                // last sunday in october already over -> winter time
-                else
-                {
-                    this->setSummertime(0);
-                    summertimeActive = false;
-                }
-            }
-
-            // Check in first three weeks of october -> summer time
-            else
-            {
-                this->setSummertime(1);
-                summertimeActive = true;
-            }
-        }
-
-        // Check in summer time
-        else if (dateMonth > 3 && dateMonth < 10)
-        {
-            this->setSummertime(1);
-            summertimeActive = true;
-        }
-
-        // Check in winter time
-        else if (dateMonth < 3 || dateMonth > 10)
-        {
-            this->setSummertime(0);
-            summertimeActive = false;
-        }
-    }
-
-    return summertimeActive;
-}
\ No newline at end of file
+    this->getOffsetAt(this->estimateEpochMillis(millis()) / 1000);
+    return this->_dstActive;
+}
@@ -3,10 +3,76 @@
 
 #include <Arduino.h>
 #include <WiFiUdp.h>
+#include "calendar.h"
 
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_REPLY_TIMEOUT 1000      // time to wait for the reply of the server in ms
+#define NTP_STEP_THRESHOLD 1000     // offsets larger than this (ms) are stepped, smaller ones are slewed
+#define NTP_SLEW_DIVISOR 20         // slew rate: at most 1 ms correction per NTP_SLEW_DIVISOR ms (5%)
+#define NTP_DRIFT_MIN_INTERVAL 30000 // minimum time between two syncs (ms) for a drift sample
+#define NTP_DRIFT_MAX_PPB 500000    // drift samples above this (ppb) are considered invalid
+#define NTP_DRIFT_EMA_WEIGHT 8      // weight of the exponential moving average of the drift (1/n per sample)
+#define NTP_MAX_SERVERS 4           // maximum number of configured servers
+#define NTP_BURST_SIZE 3            // queries per update, the sample with the lowest delay is used
+#define NTP_DNS_CACHE_TIME 3600000  // time (ms) a resolved server address is reused
+#define NTP_DNS_TIMEOUT 1000        // maximum time (ms) to wait for a DNS lookup (asynchronous, never blocks)
+#define NTP_DNS_RETRY 5000          // minimum time (ms) between two lookups of the same server
+#define NTP_BACKOFF_MIN 5000        // retry delay (ms) after the first failed update
+#define NTP_BACKOFF_MAX 900000      // maximum retry delay (ms) of the exponential backoff
+#define NTP_DEGRADED_FAILURES 3     // consecutive failed updates until the health is degraded
+#define NTP_FREE_RUNNING_AGE 21600000 // time (ms) without sync until the clock is considered free running
+
+/**
+ * @brief Status of an asynchronous NTP update
+ * 
+ */
+enum NTPStatus {
+    NTP_IDLE,                       // no update in progress
+    NTP_PENDING,                    // request sent, waiting for the reply
+    NTP_SUCCESS,                    // time updated
+    NTP_TIMEOUT,                    // no reply within NTP_REPLY_TIMEOUT
+    NTP_TIME_JUMP,                  // too large difference to previous received time (try again)
+    NTP_INVALID                     // NTP time not valid (<1970)
+};
+
+/**
+ * @brief Health of the time synchronization
+ * 
+ */
+enum NTPHealth {
+    NTP_HEALTH_UNSYNCED,            // no successful sync yet
+    NTP_HEALTH_SYNCED,              // recent successful sync
+    NTP_HEALTH_DEGRADED,            // last updates failed, clock runs on the drift compensated time base
+    NTP_HEALTH_FREE_RUNNING         // no sync for NTP_FREE_RUNNING_AGE
+};
+
+typedef void (*NTPUpdateCallback)(NTPStatus status);
+
+/**
+ * @brief Time server with cached address
+ * 
+ */
+struct NTPServer {
+    const char*   name;
+    IPAddress     ip;
+    bool          resolved;             // ip is valid
+    unsigned long resolvedMillis;       // time of last successful lookup
+    volatile bool lookupPending;        // asynchronous DNS lookup in progress (result set by the lwIP callback)
+    unsigned long lookupMillis;         // start of the last lookup
+};
+
+/**
+ * @brief Time sample of one query
+ * 
+ */
+struct NTPSample {
+    uint64_t      serverEpochMillis;    // server time (UTC epoch ms) at localMillis
+    unsigned long localMillis;          // local millis() of the reception of the reply
+    unsigned long delay;                // network delay (ms)
+    unsigned long secsSince1900;        // transmit timestamp of the server (s)
+};
 
 /**
  * @brief Own NTP Client library for Arduino with code from:
@@ -18,13 +84,32 @@ class NTPClientPlus{
 
     public:
         NTPClientPlus(UDP &udp, const char* poolServerName, int utcx, bool _swChange);
-        void setupNTPClient();
+        void setupNTPClient(bool initialUpdate = true);
         int updateNTP();
+        bool beginUpdate();
+        NTPStatus poll();
+        bool isUpdatePending() const;
+        NTPStatus getLastStatus() const;
+        void setUpdateCallback(NTPUpdateCallback callback);
         void end();
         void setTimeOffset(int timeOffset);
+        void setDSTRule(DSTRule rule);
         void setPoolServerName(const char* poolServerName);
+        bool addServer(const char* serverName);
+        void setUpdateInterval(unsigned long updateInterval);
+        unsigned long getNextUpdateDelay();
+        NTPHealth getHealth() const;
+        uint8_t getConsecutiveFailures() const;
+        unsigned long getTimeSinceSync() const;
+        uint64_t getUTCEpochMillis() const;
+        void restoreTime(uint64_t utcEpochMillis, long driftPpb, unsigned long timeSinceSync);
+        void syncExternal(uint64_t utcEpochMillis, unsigned long localMillis);
         unsigned long getSecsSince1900() const;
         unsigned long getEpochTime() const;
+        uint64_t getEpochMillis() const;
+        unsigned long getRoundTripDelay() const;
+        long getLastOffset() const;
+        long getDriftPpb() const;
         int getHours24() const;
         int getHours12() const;
         int getMinutes() const;
@@ -44,28 +129,70 @@ class NTPClientPlus{
         UDP*          _udp;
         bool          _udpSetup       = false;
 
-        const char*   _poolServerName = "pool.ntp.org"; // Default time server
-        IPAddress     _poolServerIP;
+        NTPServer     _servers[NTP_MAX_SERVERS];
+        uint8_t       _serverCount    = 0;
+        uint8_t       _nextServer     = 0;      // server of the next query (round robin)
         unsigned int  _port           = NTP_DEFAULT_LOCAL_PORT;
-        long          _timeOffset     = 0;
+        long          _timeOffset     = 0;      // offset of the standard time in s
         int           _utcx           = 0;
-        bool          _swChange        = 1;
+        DSTRule       _dstRule        = DST_EU;
+
+        // daylight saving time state, valid for [_dstValidFrom, _dstValidUntil) (UTC epoch in s)
+        mutable bool     _dstValid      = false;
+        mutable bool     _dstActive     = false;
+        mutable uint32_t _dstValidFrom  = 0;
+        mutable uint32_t _dstValidUntil = 0;
 
         unsigned long _updateInterval = 60000;  // In ms
 
         unsigned long _currentEpoc    = 0;      // In s
-        unsigned long _lastUpdate     = 0;      // In ms
         unsigned long _secsSince1900  = 0;      // seconds since 1. Januar 1900, 00:00:00
         unsigned long _lastSecsSince1900 = 0;
         unsigned int _dateYear         = 0;
         unsigned int _dateMonth        = 0;
         unsigned int _dateDay          = 0;
         unsigned int _dayOfWeek        = 0;
-
+        int32_t      _dateDays         = 0;     // local day (since 1. Jan. 1970) of the cached date
+        bool         _dateValid        = false;
+
+
+        NTPStatus     _status         = NTP_IDLE;
+        NTPStatus     _lastStatus     = NTP_IDLE;
+        unsigned long _requestMillis  = 0;      // time the pending request was sent
+        IPAddress     _requestIP;               // server of the pending request
+        uint8_t       _burstQuery     = 0;      // number of the current query of the burst
+        bool          _hasSample      = false;  // a valid sample was received during the burst
+        bool          _invalidReply   = false;  // a server replied with an invalid time during the burst
+        bool          _waitingForDNS  = false;  // no server has an address yet, waiting for the pending lookup
+        NTPSample     _bestSample;              // sample with the lowest delay of the burst
+        uint8_t       _consecutiveFailures = 0;
+        NTPUpdateCallback _callback   = nullptr;
+
+        // millisecond time base: epoch = base + elapsed * (1 + drift) + slewed part of offset
+        bool          _synced         = false;
+        unsigned long _baseMillis     = 0;      // local millis() of the anchor of the time base
+        uint64_t      _baseEpochMillis = 0;     // UTC epoch in ms at _baseMillis
+        long          _slewOffset     = 0;      // offset to the server (ms) which is slewed from the anchor on
+        long          _driftPpb       = 0;      // estimated drift of the local oscillator (ppb, positive = local clock slow)
+        unsigned long _lastSyncMillis = 0;      // local millis() of last successful sync
+        unsigned long _driftRefMillis = 0;      // local millis() of the reference sync of the next drift sample
+        uint64_t      _driftRefEpochMillis = 0; // server time of the reference sync (0: restored time base, no drift reference)
+        unsigned long _roundTripDelay = 0;      // round trip delay of last reply (ms)
+        long          _lastOffset     = 0;      // offset between server and local clock at last sync (ms)
 
         byte          _packetBuffer[NTP_PACKET_SIZE];
-        void          sendNTPPacket();
-        void          setSummertime(bool summertime);
+        bool          sendNTPPacket();
+        bool          resolveServer(NTPServer &server, bool &lookupStarted);
+        bool          isLookupPending() const;
+        bool          startQuery();
+        void          parseReply(unsigned long receiveMillis);
+        NTPStatus     finishBurst();
+        uint64_t      estimateEpochMillis(unsigned long localMillis) const;
+        void          syncTimeBase(uint64_t serverEpochMillis, unsigned long localMillis);
+        static uint64_t ntpToEpochMillis(const byte *timestamp);
+        void          finishUpdate(NTPStatus status);
+        long          getOffsetAt(uint32_t utcSecs) const;
+        void          updateDSTCache(uint32_t utcSecs) const;
         
 
         static const unsigned long secondperday = 86400;
@@ -74,9 +201,6 @@ class NTPClientPlus{
         static const unsigned long minuteperhour = 60;
         static const unsigned long millisecondpersecond = 1000;
 
-        // number of days in months
-        unsigned int daysInMonth[13] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-
 
 
 
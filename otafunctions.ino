@@ -22,9 +22,15 @@ void setupOTA(String hostname){
     }
 
     // NOTE: if updating FS this would be the place to unmount FS using FS.end()
+    // write pending settings, the clock restarts after the update
+    if(!settings.commit()){
+      logger.logf(LOG_ERROR, "Writing the settings to flash failed");
+    }
     Serial.println("Start updating " + type);
   });
   ArduinoOTA.onEnd([]() {
+    // the clock continues with the current time after the restart
+    saveRTCState();
     Serial.println("\nEnd");
   });
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
@@ -48,6 +54,126 @@ void setupOTA(String hostname){
 }
 
 void handleOTA(){
+  METRIC_SCOPE(METRIC_OTA);
   // handle OTA
   ArduinoOTA.handle();
-}
\ No newline at end of file
+}
+
+// setup firmware and filesystem updates via HTTP POST (multipart), e.g.
+// curl -F "image=@ringclock.bin" "http://<ip>/update?md5=<hex>"
+// curl -F "image=@ringclock.mklittlefs.bin" "http://<ip>/update?target=filesystem&md5=<hex>"
+void setupHTTPUpdate(){
+  server.on("/update", HTTP_POST, handleUpdateResponse, handleUpdateUpload);
+  server.on("/api/upload", handleUploadStatus);
+}
+
+/**
+ * @brief Upload handler of "/update", passes the image to the upload pipeline
+ * 
+ */
+void handleUpdateUpload(){
+  HTTPUpload& upload = server.upload();
+  if(upload.status == UPLOAD_FILE_START){
+    UploadTarget target = server.arg("target") == "filesystem" ? UPLOAD_TARGET_FILESYSTEM : UPLOAD_TARGET_FIRMWARE;
+    logger.logf(LOG_INFO, "Start updating %s via HTTP", UploadPipeline::getTargetName(target));
+    logger.flush();
+    // write pending settings, the clock restarts after the update
+    if(!settings.commit()){
+      logger.logf(LOG_ERROR, "Writing the settings to flash failed");
+    }
+    uploadPipeline.begin(target, "", server.arg("size").toInt(), server.arg("md5").c_str(), server.header("Content-Length").toInt());
+  }
+  else if(upload.status == UPLOAD_FILE_WRITE){
+    uploadPipeline.write(upload.buf, upload.currentSize);
+    showUploadProgress();
+  }
+  else if(upload.status == UPLOAD_FILE_END){
+    uploadPipeline.end();
+    logUploadResult();
+  }
+  else if(upload.status == UPLOAD_FILE_ABORTED){
+    uploadPipeline.abort();
+    logUploadResult();
+  }
+}
+
+/**
+ * @brief Response handler of "/update", restarts the clock after a successful update
+ * 
+ */
+void handleUpdateResponse(){
+  clearUploadProgress();
+  if(uploadPipeline.getState() != UPLOAD_DONE){
+    server.send(400, "text/plain", uploadPipeline.getState() == UPLOAD_FAILED ? uploadPipeline.getError() : "no image");
+    return;
+  }
+  handleUploadStatus();
+  logger.logf(LOG_INFO, "Update done, restart...");
+  logger.flush();
+  delay(100);
+  server.client().stop();
+  saveRTCState();
+  ESP.restart();
+}
+
+/**
+ * @brief Handler for "/api/upload" url, sends the state of the last upload as JSON
+ * 
+ */
+void handleUploadStatus(){
+  char buffer[JSON_CHUNK_SIZE];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject();
+  json.member("state", UploadPipeline::getStateName(uploadPipeline.getState()));
+  json.member("target", UploadPipeline::getTargetName(uploadPipeline.getTarget()));
+  json.member("path", uploadPipeline.getPath());
+  json.member("written", (unsigned long)uploadPipeline.getWritten());
+  json.member("size", (unsigned long)uploadPipeline.getExpectedSize());
+  json.member("progress", (unsigned int)uploadPipeline.getProgress());
+  json.member("md5", uploadPipeline.getMD5());
+  json.member("error", uploadPipeline.getError());
+  json.endObject();
+  server.send(200, "application/json", json.c_str());
+}
+
+/**
+ * @brief Show the progress of the running upload on the outer ring and in the log. The 
+ * webserver is blocked during an upload, so the LEDs and the log are updated directly.
+ * 
+ */
+void showUploadProgress(){
+  static unsigned long lastUpdate = 0;
+  static uint8_t lastLoggedProgress = 0;
+  if(millis() - lastUpdate < PERIOD_UPLOAD_PROGRESS) return;
+  lastUpdate = millis();
+  uint8_t progress = uploadPipeline.getProgress();
+  showProgressOnOverlay(progress, colorSeconds);
+  ledrings.drawOnRingsInstant();
+  if(progress / 10 != lastLoggedProgress / 10 || progress < lastLoggedProgress){
+    lastLoggedProgress = progress;
+    logger.logf(LOG_INFO, "Upload progress: %u%% (%lu bytes)", progress, (unsigned long)uploadPipeline.getWritten());
+    logger.flush();
+  }
+}
+
+/**
+ * @brief Remove the upload progress from the outer ring
+ * 
+ */
+void clearUploadProgress(){
+  ledrings.flushOuterRing(LAYER_OVERLAY);
+  scheduler.runTaskNow(taskIdRender);
+}
+
+/**
+ * @brief Log the result of the last upload
+ * 
+ */
+void logUploadResult(){
+  if(uploadPipeline.getState() == UPLOAD_DONE){
+    logger.logf(LOG_INFO, "Upload done: %lu bytes, md5 %s", (unsigned long)uploadPipeline.getWritten(), uploadPipeline.getMD5());
+  }
+  else {
+    logger.logf(LOG_ERROR, "Upload failed after %lu bytes: %s", (unsigned long)uploadPipeline.getWritten(), uploadPipeline.getError());
+  }
+}
@@ -0,0 +1,91 @@
+#include "powermanager.h"
+
+/**
+ * @brief Construct a new PowerManager, starts in POWER_ACTIVE
+ * 
+ */
+PowerManager::PowerManager(){
+    _stateSince = millis();
+}
+
+/**
+ * @brief Set the function which is called on every change of the power state
+ * 
+ * @param callback function applying the new state
+ */
+void PowerManager::setStateCallback(PowerStateCallback callback){
+    _callback = callback;
+}
+
+/**
+ * @brief Change the power state (nothing happens if the state is unchanged)
+ * 
+ * @param state new state
+ */
+void PowerManager::setState(PowerState state){
+    if(state == _state || state >= POWER_STATE_COUNT) return;
+    unsigned long now = millis();
+    _timeInState[_state] += now - _stateSince;
+    _stateSince = now;
+    _state = state;
+    _transitionCount[state]++;
+    if(_callback) _callback(state);
+}
+
+PowerState PowerManager::getState() const{
+    return _state;
+}
+
+/**
+ * @brief Keep the clock out of POWER_SLEEP for the given time (e.g. after a HTTP request)
+ * 
+ * @param holdTime time in milliseconds
+ */
+void PowerManager::wake(uint32_t holdTime){
+    unsigned long until = millis() + holdTime;
+    if(!isWakeHeld() || (long)(until - _wakeUntil) > 0){
+        _wakeUntil = until;
+    }
+    _wakeHeld = true;
+}
+
+/**
+ * @brief Check if a wake() hold time is running
+ * 
+ */
+bool PowerManager::isWakeHeld(){
+    if(_wakeHeld && (long)(millis() - _wakeUntil) >= 0){
+        _wakeHeld = false;
+    }
+    return _wakeHeld;
+}
+
+/**
+ * @brief Get the time spent in a state since boot
+ * 
+ * @param state power state
+ * @return uint32_t time in seconds
+ */
+uint32_t PowerManager::getTimeInState(PowerState state) const{
+    if(state >= POWER_STATE_COUNT) return 0;
+    uint64_t time = _timeInState[state];
+    if(state == _state) time += millis() - _stateSince;
+    return time / 1000;
+}
+
+/**
+ * @brief Get the number of changes into a state since boot
+ * 
+ */
+uint32_t PowerManager::getTransitionCount(PowerState state) const{
+    return state < POWER_STATE_COUNT ? _transitionCount[state] : 0;
+}
+
+const char* PowerManager::getStateName(PowerState state){
+    switch(state){
+        case POWER_ACTIVE: return "active";
+        case POWER_IDLE: return "idle";
+        case POWER_SLEEP: return "sleep";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,47 @@
+/**
+ * @file powermanager.h
+ * @brief Power states of the clock and the time spent in each of them
+ * 
+ * POWER_ACTIVE: LEDs are on, the clock face is rendered.
+ * POWER_IDLE:   LEDs are off (one black frame pushed, the LED bus is not touched anymore), 
+ *               but the clock stays responsive (recent HTTP request, WebSocket client, NTP update).
+ * POWER_SLEEP:  LEDs are off and nothing is going on, the polling tasks are slowed down and 
+ *               the WiFi light sleep is enabled, so the CPU sleeps until the next deadline.
+ * 
+ * The manager only keeps the state and the statistics, the changes of the tasks and the 
+ * WiFi are done by the state callback.
+ */
+
+#ifndef powermanager_h
+#define powermanager_h
+
+#include <Arduino.h>
+
+enum PowerState {POWER_ACTIVE, POWER_IDLE, POWER_SLEEP, POWER_STATE_COUNT};
+
+typedef void (*PowerStateCallback)(PowerState state);
+
+class PowerManager{
+
+    public:
+        PowerManager();
+        void setStateCallback(PowerStateCallback callback);
+        void setState(PowerState state);
+        PowerState getState() const;
+        void wake(uint32_t holdTime);
+        bool isWakeHeld();
+        uint32_t getTimeInState(PowerState state) const;
+        uint32_t getTransitionCount(PowerState state) const;
+        static const char* getStateName(PowerState state);
+
+    private:
+        PowerState _state = POWER_ACTIVE;
+        unsigned long _stateSince;
+        uint64_t _timeInState[POWER_STATE_COUNT] = {};     // ms, without the current period
+        uint32_t _transitionCount[POWER_STATE_COUNT] = {};
+        unsigned long _wakeUntil = 0;
+        bool _wakeHeld = false;
+        PowerStateCallback _callback = nullptr;
+};
+
+#endif
@@ -27,19 +27,47 @@
 #include <ArduinoOTA.h>
 #include <ESP8266WebServer.h>
 #include <WiFiManager.h>                //https://github.com/tzapu/WiFiManager WiFi Configuration Magic
-#include <EEPROM.h>                     //from ESP8266 Arduino Core (automatically installed when ESP8266 was installed via Boardmanager)
+#include <WebSocketsServer.h>           //https://github.com/Links2004/arduinoWebSockets
+#include <ESP8266mDNS.h>
 
 // own libraries
 #include "constants.h"
 #include "udplogger.h"
 #include "ntp_client_plus.h"
 #include "ledrings.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "metrics.h"
+#include "jsonwriter.h"
+#include "commands.h"
+#include "settings.h"
+#include "uploadpipeline.h"
+#include "powermanager.h"
+#include "wificache.h"
+#include "rtcstate.h"
+#include "timebeacon.h"
+#include "fleet.h"
+#include "listentry.h"
+#include "benchmarks.h"
 #include "Arduino.h"
 
 #define DELAYVAL 100
 
+// state pushed to the WebSocket clients
+#define STATE_FIELD_COUNT 10
+#define STATE_VALUE_MAX 16
+#define STATE_JSON_MAX 320
+
+// datagrams of the multicast group handled per run of taskMulticast(), larger datagrams are truncated
+#define MULTICAST_PACKET_MAX FLEET_PACKET_MAX
+#define MULTICAST_PACKETS_PER_RUN 4
+
+// size of the buffer for JSON responses, larger documents are sent in chunks
+#define JSON_CHUNK_SIZE 256
+
 // ports
 const unsigned int HTTPPort = 80;
+const unsigned int WebSocketPort = 81;
 const unsigned int logMulticastPort = 8123;
 
 // ip addresses for multicast logging
@@ -53,8 +81,9 @@ IPAddress Subnetmask_AccessPoint(255,255,255,0);
 // SSID for Access Point
 const char* AP_SSID = "ringclockAP";
 
-// hostname
-const String hostname = "ringclock";
+// hostname, the last digits of the chip id are appended (e.g. "ringclock-1a2b3c"), so every clock has a unique name
+const char* hostnamePrefix = "ringclock";
+String hostname = hostnamePrefix;
 
 // ----------------------------------------------------------------------------------
 //                                        GLOBAL VARIABLES
@@ -63,6 +92,9 @@ const String hostname = "ringclock";
 // Webserver
 ESP8266WebServer server(HTTPPort);
 
+// WebSocket server, pushes state changes to the web UI and receives commands
+WebSocketsServer webSocket(WebSocketPort);
+
 // Wifi manager
 WiFiManager wifiManager;
 
@@ -72,18 +104,65 @@ WiFiManager wifiManager;
 Adafruit_NeoPixel outer_ring(OUTER_RING_LED_COUNT, OUTER_RING_LED_PIN, NEO_GRB + NEO_KHZ800);
 Adafruit_NeoPixel inner_ring(INNER_RING_LED_COUNT, INNER_RING_LED_PIN, NEO_GRB + NEO_KHZ800);
 
-// timestamp variables
-long lastheartbeat = millis();      // time of last heartbeat sending
-long lastStep = millis();           // time of last clock update
-long lastLedStep = millis();  // time of last led update
-long lastNTPUpdate = millis() - (PERIOD_NTP_UPDATE-5000);  // time of last NTP update
-long lastNightmodeCheck = millis(); // time of last nightmode check
+// Output drivers of the rings (see OUTER_RING_LED_DRIVER/INNER_RING_LED_DRIVER in constants.h)
+#if OUTER_RING_LED_DRIVER == LED_DRIVER_ASYNC_UART1
+NeoPixelBusDriver<NeoEsp8266AsyncUart1Ws2812xMethod> outer_ring_driver(OUTER_RING_LED_COUNT);
+#elif OUTER_RING_LED_DRIVER == LED_DRIVER_ASYNC_DMA
+NeoPixelBusDriver<NeoEsp8266DmaWs2812xMethod> outer_ring_driver(OUTER_RING_LED_COUNT);
+#else
+AdafruitNeoPixelDriver outer_ring_driver(&outer_ring);
+#endif
+#if INNER_RING_LED_DRIVER == LED_DRIVER_ASYNC_UART1
+NeoPixelBusDriver<NeoEsp8266AsyncUart1Ws2812xMethod> inner_ring_driver(INNER_RING_LED_COUNT);
+#elif INNER_RING_LED_DRIVER == LED_DRIVER_ASYNC_DMA
+NeoPixelBusDriver<NeoEsp8266DmaWs2812xMethod> inner_ring_driver(INNER_RING_LED_COUNT);
+#else
+AdafruitNeoPixelDriver inner_ring_driver(&inner_ring);
+#endif
+
+// scheduler for all periodic jobs
+Scheduler scheduler;
+
+// persistent settings (colors, nightmode, brightness)
+Settings settings;
+
+// uploads of files, firmware and filesystem images via HTTP
+UploadPipeline uploadPipeline;
+
+// snapshot of time base and display mode in the RTC user memory, survives software and watchdog restarts
+RTCState rtcState;
+
+// time beacons of the clocks in the same network, the seconds of all clocks run in lockstep
+TimeBeacon timeBeacon;
+
+// discovery and bulk configuration of several clocks via multicast
+Fleet fleet;
+
+// power states (LEDs on, LEDs off but awake, sleeping)
+PowerManager power;
+WiFiSleepType_t wifiSleepModeAwake = WIFI_MODEM_SLEEP;   // sleep mode of the WiFi outside of POWER_SLEEP
+int8_t taskIdRender = -1;
+int8_t taskIdOTA = -1;
+int8_t taskIdHTTP = -1;
+int8_t taskIdNTPUpdate = -1;
+int8_t taskIdHeartbeat = -1;
+int8_t taskIdNightmodeCheck = -1;
+int8_t taskIdLogFlush = -1;
+int8_t taskIdTelemetry = -1;
+int8_t taskIdWebSocket = -1;
+int8_t taskIdStatePush = -1;
+int8_t taskIdSettings = -1;
+int8_t taskIdPower = -1;
+int8_t taskIdWiFi = -1;
+int8_t taskIdBootOverlay = -1;
+int8_t taskIdRTCSnapshot = -1;
+int8_t taskIdMulticast = -1;
 
 // Create necessary global objects
 UDPLogger logger;
 WiFiUDP NTPUDP;
-NTPClientPlus ntp = NTPClientPlus(NTPUDP, "pool.ntp.org", 1, true);
-LEDRings ledrings = LEDRings(&outer_ring, &inner_ring, &logger);
+NTPClientPlus ntp = NTPClientPlus(NTPUDP, "0.pool.ntp.org", 1, true);
+LEDRings ledrings = LEDRings(&outer_ring_driver, &inner_ring_driver, &logger);
 
 // colors
 uint32_t colorHours = LEDRings::Color24bit(200, 200, 0);    // color of the hours
@@ -98,8 +177,28 @@ uint8_t nightModeStartMin = 0;
 uint8_t nightModeEndHour = 7;
 uint8_t nightModeEndMin = 0;
 
-// Watchdog counter to trigger restart if NTP update was not possible 30 times in a row (5min)
-int watchdogCounter = 30;
+// commands of one request or WebSocket message, collected by the CommandParser and 
+// executed together by applyPendingCommands() after all of them are validated
+CommandParser commandParser(&logger);
+PendingCommands pendingCommands;
+
+// additional NTP servers (queried round robin, the reply with the lowest delay is used)
+const char* ntpServers[] = {"1.pool.ntp.org", "2.pool.ntp.org", "time.google.com"};
+
+// last reported health of the NTP synchronization
+NTPHealth ntpHealth = NTP_HEALTH_UNSYNCED;
+
+// source of the settings at boot (logged once the WiFi is connected)
+SettingsSource settingsSource = SETTINGS_SOURCE_FLASH;
+
+// overlays shown after power on by taskBootOverlay() without blocking (clock layers are hidden meanwhile)
+#define BOOT_OVERLAY_NONE 0
+#define BOOT_OVERLAY_LED_TEST 1     // running light on both rings
+#define BOOT_OVERLAY_IP 2           // last three digits of the IP address
+uint8_t bootOverlay = BOOT_OVERLAY_NONE;
+uint16_t bootOverlayStep = 0;
+bool bootOverlayIPPending = false;  // IP display requested while the LED test is running
+bool bootShowIP = false;            // show the IP address once the WiFi is connected
 
 // ----------------------------------------------------------------------------------
 //                                       SETUP 
@@ -108,28 +207,36 @@ int watchdogCounter = 30;
 void setup() {
   Serial.begin(115200);
   delay(100);
+#if METRICS_ENABLED
+  Metrics::begin();
+#endif
 
   Serial.println();
   Serial.printf("\nSketchname: %s\nBuild: %s\n", (__FILE__), (__TIMESTAMP__));
   Serial.println();
 
-  //Init EEPROM
-  EEPROM.begin(EEPROM_SIZE);
+  // load the settings from flash (migrates the old EEPROM layout on the first boot)
+  settingsSource = settings.begin();
+  timeBeacon.begin(ESP.getChipId());
+  fleet.begin(ESP.getChipId(), FLEET_KEY);
 
-  
+  char name[24];
+  snprintf(name, sizeof(name), "%s-%06x", hostnamePrefix, ESP.getChipId() & 0xFFFFFF);
+  hostname = name;
 
   ledrings.setupRings();
   ledrings.setCurrentLimit(CURRENT_LIMIT_LED);
-  ledrings.setOffsets(-5, 0);
 
-  loadColorsFromEEPROM();
-  loadNightmodeSettingsFromEEPROM();
-  loadBrightnessSettingsFromEEPROM();
+  loadSettings();
 
-  /** Use WiFiMaanger for handling initial Wifi setup **/
+  // continue with the time and display mode of the last run after a restart (before the first NTP update)
+  bool restored = restoreRTCState();
 
-  // Local intialization. Once its business is done, there is no need to keep it around
+  // UDP Logger sends the logging messages via UDP multicast once the WiFi is connected
+  logger.setName("Ringclock");
 
+  // init ESP8266 File manager (LittleFS), also holds the cache of the last WiFi connection
+  setupFS();
 
   // Uncomment and run it once, if you want to erase all the stored information
   //wifiManager.resetSettings();
@@ -137,189 +244,524 @@ void setup() {
   // set custom ip for portal
   //wifiManager.setAPStaticIPConfig(IPAdress_AccessPoint, Gateway_AccessPoint, Subnetmask_AccessPoint);
 
-  // set a custom hostname
-  wifiManager.setHostname(hostname);
-
-  // fetches ssid and pass from eeprom and tries to connect
-  // if it does not connect it starts an access point with the specified name
-  // here "ringclockAP"
-  // and goes into a blocking loop awaiting configuration
-  wifiManager.autoConnect(AP_SSID);
-
-  // if you get here you have connected to the WiFi
-  Serial.println("Connected.");
-  Serial.println("IP address: ");
-  Serial.println(WiFi.localIP());
+  // connects with the credentials stored by the WiFiManager without blocking, if there is no 
+  // connection the WiFiManager starts an access point with the name AP_SSID ("ringclockAP") 
+  // in the background (see wififunctions.ino)
+  startWiFi();
 
-  // init ESP8266 File manager (LittleFS)
-  setupFS();
-
-  setupOTA(hostname); 
+  setupHTTPUpdate();
 
   server.on("/data", handleDataRequest); // process datarequests
   server.on("/cmd", handleCommand); // process commands
+  server.on("/api/state", handleStateRequest); // complete state as JSON document
+  server.addHook(handleRequestHook); // every request wakes the clock from POWER_SLEEP
+#if METRICS_ENABLED
+  server.on("/metrics", handleMetricsRequest); // instrumentation in Prometheus text format
+#endif
+#if BENCHMARK_ENABLED
+  server.on("/benchmark", handleBenchmarkRequest); // cycles of the hot paths (see benchmarks.h)
+#endif
   server.begin();
+  webSocket.begin();
+  webSocket.onEvent(handleWebSocketEvent);
 
-  // create UDP Logger to send logging messages via UDP multicast
-  logger = UDPLogger(WiFi.localIP(), logMulticastIP, logMulticastPort);
-  logger.setName("Ringclock");
-  logger.logString("Start program\n");
-  logger.logString("Sketchname: "+ String(__FILE__));
-  logger.logString("Build: " + String(__TIMESTAMP__));
-  logger.logString("IP: " + WiFi.localIP().toString());
-  logger.logString("Reset Reason: " + ESP.getResetReason());
-
-  if(!ESP.getResetReason().equals("Software/System restart")){
-    runQuickLEDTest();
+  // setup NTP, the first update is done by taskNTPUpdate() as soon as the WiFi is connected
+  for(const char* server : ntpServers){
+    ntp.addServer(server);
+  }
+  ntp.setUpdateInterval(PERIOD_NTP_UPDATE);
+  ntp.setupNTPClient(false);
 
-    // display IP
-    uint8_t address = WiFi.localIP()[3];
-    uint8_t first_digit = address/100;
-    uint8_t second_digit = (address/10)%10;
-    uint8_t third_digit = address%10;
+  // register periodic jobs
+  setupTasks();
+  if(restored){
+    scheduler.runTaskNow(taskIdNightmodeCheck);
+  }
 
-    // if a digit is 0 -> show 10
-    if(first_digit == 0) {
-      first_digit = 10;
-    }
-    if(second_digit == 0) {
-      second_digit = 10;
-    }
-    if(third_digit == 0) {
-      third_digit = 10;
+  if(!restored && !ESP.getResetReason().equals("Software/System restart")){
+    if(BOOT_LED_TEST){
+      startLEDTest();
     }
+    bootShowIP = BOOT_SHOW_IP;
+  }
+}
 
-    showHour(first_digit, colorHours);
-    ledrings.drawOnRingsInstant();
-    delay(2000);
-    showHour(second_digit, colorHours);
-    ledrings.drawOnRingsInstant();
-    delay(2000);
-    showHour(third_digit, colorHours);
-    ledrings.drawOnRingsInstant();
-    delay(2000);
+// ----------------------------------------------------------------------------------
+//                                       LOOP
+// ----------------------------------------------------------------------------------
+void loop() {
 
-    // clear matrix
-    ledrings.flushInnerRing();
-    ledrings.flushOuterRing();
-    ledrings.drawOnRingsInstant();
-  }
+  METRIC_COUNT_LOOP();
 
-  delay(2000);
+  // run all due tasks (render, OTA, webserver, NTP update, heartbeat, nightmode check)
+  scheduler.run();
 
-  // setup NTP
-  ntp.setupNTPClient();
-  logger.logString("NTP running");
-  logger.logString("Time: " +  ntp.getFormattedTime());
-  logger.logString("TimeOffset (seconds): " + String(ntp.getTimeOffset()));
+  // sleep until the next task is due (limited to keep webserver and OTA responsive)
+  scheduler.idle(power.getState() == POWER_SLEEP ? PERIOD_SLEEP_POLL : PERIOD_IDLE_MAX);
 }
 
 // ----------------------------------------------------------------------------------
-//                                       LOOP
+//                                       TASKS
 // ----------------------------------------------------------------------------------
-void loop() {
 
-  // handle OTA
-  handleOTA();
+/**
+ * @brief Register all periodic jobs at the scheduler
+ */
+void setupTasks(){
+  taskIdRender = scheduler.addTask("render", taskRender, PERIOD_LED_UPDATE, 3);
+  taskIdOTA = scheduler.addTask("ota", handleOTA, PERIOD_HANDLE_OTA, 2);
+  taskIdHTTP = scheduler.addTask("http", taskHandleHTTP, PERIOD_HANDLE_HTTP, 2);
+  taskIdWebSocket = scheduler.addTask("websocket", taskHandleWebSocket, PERIOD_HANDLE_HTTP, 2);
+  taskIdStatePush = scheduler.addTask("state", taskStatePush, PERIOD_STATE_PUSH, 0);
+  taskIdNTPUpdate = scheduler.addTask("ntp", taskNTPUpdate, PERIOD_NTP_UPDATE, 1, 5000);
+  ntp.setUpdateCallback(handleNTPResult);
+  taskIdHeartbeat = scheduler.addTask("heartbeat", taskHeartbeat, PERIOD_HEARTBEAT, 0, PERIOD_HEARTBEAT);
+  taskIdNightmodeCheck = scheduler.addTask("nightmode", taskNightmodeCheck, PERIOD_NIGHTMODE_CHECK, 0, PERIOD_NIGHTMODE_CHECK);
+  taskIdLogFlush = scheduler.addTask("log", taskLogFlush, PERIOD_LOG_FLUSH, 0);
+  taskIdTelemetry = scheduler.addTask("telemetry", taskTelemetry, PERIOD_TELEMETRY > 0 ? PERIOD_TELEMETRY : PERIOD_HEARTBEAT, 0, PERIOD_TELEMETRY);
+  scheduler.setEnabled(taskIdTelemetry, PERIOD_TELEMETRY > 0);
+  taskIdSettings = scheduler.addTask("settings", taskSettingsCommit, PERIOD_SETTINGS_COMMIT, 0);
+  wifiSleepModeAwake = WiFi.getSleepMode();
+  power.setStateCallback(handlePowerStateChange);
+  taskIdPower = scheduler.addTask("power", updatePowerState, PERIOD_POWER_CHECK, 0, PERIOD_POWER_CHECK);
+  taskIdWiFi = scheduler.addTask("wifi", taskWiFi, PERIOD_WIFI_CHECK, 1);
+  taskIdBootOverlay = scheduler.addTask("overlay", taskBootOverlay, PERIOD_LED_UPDATE, 1);
+  scheduler.setEnabled(taskIdBootOverlay, false);
+  taskIdRTCSnapshot = scheduler.addTask("rtc", saveRTCState, PERIOD_RTC_SNAPSHOT, 0);
+  taskIdMulticast = scheduler.addTask("multicast", taskMulticast, PERIOD_MULTICAST_POLL, 2);
+
+  // a rejected task never runs and all calls with its id (-1) are ignored
+  if(scheduler.getRejectedCount() > 0){
+    logger.logf(LOG_ERROR, "Task table full (%d tasks), %d tasks not registered, first: %s - increase SCHEDULER_MAX_TASKS",
+                SCHEDULER_MAX_TASKS, scheduler.getRejectedCount(), scheduler.getRejectedTask());
+  }
+}
+
+/**
+ * @brief Task: render a frame, the next frame is scheduled when the next visible change of the clock is due
+ */
+void taskRender(){
+  // Turn off LEDs if ledOff is true or nightmode is active (layers keep their content), boot overlays are always shown
+  bool blank = (ledOff || nightMode) && bootOverlay == BOOT_OVERLAY_NONE;
+  ledrings.setOutputEnabled(!blank);
+  if(blank){
+    // push the black frame once, then leave the LED bus alone (see updatePowerState())
+    ledrings.drawOnRingsInstant();
+    updatePowerState();
+  }
+  else {
+    // clock face stays dark until there is a valid time
+    if(isTimeAvailable()){
+      // millisecond time base of the NTP client, so the seconds indicator is phase correct
+      uint32_t millisOfDay = ntp.getEpochMillis() % 86400000ULL;
+      uint8_t hours = millisOfDay / 3600000UL;
+      uint8_t minutes = (millisOfDay / 60000UL) % 60;
+      uint16_t millisOfMinute = millisOfDay % 60000UL;
+      showTimeOnClock(hours, minutes, millisOfMinute, colorHours, colorMinutes, colorSeconds);
+    }
+    ledrings.drawOnRingsSmooth(1.0);
+  }
+
+  // full frame rate only while a transition is in progress
+  uint32_t framePeriod = PERIOD_LED_UPDATE;
+  if(ledrings.isSettled()){
+    framePeriod = (blank || !isTimeAvailable()) ? PERIOD_FRAME_MAX : calcClockFramePeriod(colorMinutes, colorSeconds);
+  }
+  scheduler.setNextRun(taskIdRender, framePeriod);
+}
 
-  // handle Webserver
+/**
+ * @brief Task: handle requests of the webserver
+ */
+void taskHandleHTTP(){
+  METRIC_SCOPE(METRIC_HTTP);
   server.handleClient();
+}
+
+/**
+ * @brief Task: handle the WebSocket connections
+ */
+void taskHandleWebSocket(){
+  webSocket.loop();
+}
+
+/**
+ * @brief Task: push changes of the state to all WebSocket clients
+ */
+void taskStatePush(){
+  if(webSocket.connectedClients() == 0){
+    return;
+  }
+  char json[STATE_JSON_MAX];
+  int length = formatStateJson(json, sizeof(json), false);
+  if(length > 0){
+    webSocket.broadcastTXT(json, length);
+  }
+}
+
+/**
+ * @brief Task: send heartbeat and statistics of the tasks via UDP multicast
+ */
+void taskHeartbeat(){
+  logger.logf(LOG_INFO, "Heartbeat, FreeHeap: %u, HeapFrag: %u, MaxFreeBlock: %u, LogDropped: %u", 
+                ESP.getFreeHeap(), ESP.getHeapFragmentation(), ESP.getMaxFreeBlockSize(), logger.getDroppedCount());
+  uint32_t statsDuration = scheduler.getStatsDuration();
+  uint32_t fpsX10 = scheduler.getTask(taskIdRender)->stats.runs * 10000ULL / statsDuration;
+  logger.logf(LOG_INFO, "Frames pushed: %u, Frames skipped: %u, FPS: %u.%u", 
+                ledrings.getFramesPushed(), ledrings.getFramesSkipped(), fpsX10 / 10, fpsX10 % 10);
+
+  // statistics of all tasks: runs, overruns, jitter avg/max (ms), duration avg/max (us)
+  for(uint8_t i = 0; i < scheduler.getTaskCount(); i++){
+    const Task *task = scheduler.getTask(i);
+    if(task->stats.runs == 0){
+      logger.logf(LOG_INFO, "Task %s: no runs", task->name);
+      continue;
+    }
+    logger.logf(LOG_INFO, "Task %s: runs %u, overruns %u, jitter %u/%ums, time %u/%uus", task->name, task->stats.runs, task->stats.overruns,
+                  task->stats.totalJitter / task->stats.runs, task->stats.maxJitter, task->stats.totalDuration / task->stats.runs, task->stats.maxDuration);
+  }
+  uint32_t idleX10 = scheduler.getIdleTime() * 1000ULL / statsDuration;
+  logger.logf(LOG_INFO, "Idle: %u.%u%%", idleX10 / 10, idleX10 % 10);
+  logger.logf(LOG_INFO, "Power: %s, active %us, idle %us, sleep %us", PowerManager::getStateName(power.getState()), 
+                power.getTimeInState(POWER_ACTIVE), power.getTimeInState(POWER_IDLE), power.getTimeInState(POWER_SLEEP));
+  scheduler.resetStats();
+}
+
+/**
+ * @brief Task: send the buffered log messages via UDP multicast and Serial
+ */
+void taskLogFlush(){
+  logger.flush();
+}
 
-  // send regularly heartbeat messages via UDP multicast
-  if(millis() - lastheartbeat > PERIOD_HEARTBEAT){
-    logger.logString("Heartbeat, FreeHeap: " + String(ESP.getFreeHeap()) + ", HeapFrag: " + ESP.getHeapFragmentation() + ", MaxFreeBlock: " + ESP.getMaxFreeBlockSize() + "\n");
-    lastheartbeat = millis();
+/**
+ * @brief Task: write changed settings to flash once they are stable (see SETTINGS_COMMIT_DELAY)
+ * 
+ */
+void taskSettingsCommit(){
+  if(!settings.loop()){
+    logger.logf(LOG_ERROR, "Writing the settings to flash failed, retry in %d s", SETTINGS_COMMIT_DELAY / 1000);
+  }
+}
+
+/**
+ * @brief Task: select the power state. LEDs on: POWER_ACTIVE. LEDs off: after the black 
+ * frame is pushed POWER_IDLE while something needs a quick response (HTTP request in the 
+ * last POWER_WAKE_HOLD ms, WebSocket client, NTP update, upload), otherwise POWER_SLEEP.
+ * 
+ */
+void updatePowerState(){
+  if((!ledOff && !nightMode) || bootOverlay != BOOT_OVERLAY_NONE){
+    power.setState(POWER_ACTIVE);
+    return;
+  }
+  if(power.getState() == POWER_ACTIVE && (ledrings.isOutputEnabled() || !ledrings.isSettled())){
+    // black frame not pushed yet, keep rendering
+    return;
   }
+  bool awake = power.isWakeHeld() || webSocket.connectedClients() > 0 || ntp.isUpdatePending() 
+                || uploadPipeline.getState() == UPLOAD_RUNNING;
+  power.setState(awake ? POWER_IDLE : POWER_SLEEP);
+}
 
-  if((millis() - lastStep > PERIOD_CLOCK_UPDATE) && !nightMode && !ledOff){
-    // update LEDs
-    int hours = ntp.getHours24();
-    int minutes = ntp.getMinutes();
-    showTimeOnClock(hours, minutes, colorHours, colorMinutes, colorSeconds);
-    lastStep = millis();
+/**
+ * @brief Apply a new power state: rendering only in POWER_ACTIVE, slow polling and WiFi 
+ * light sleep in POWER_SLEEP
+ * 
+ * @param state new power state
+ */
+void handlePowerStateChange(PowerState state){
+  scheduler.setEnabled(taskIdRender, state == POWER_ACTIVE);
+  if(state == POWER_ACTIVE){
+    scheduler.runTaskNow(taskIdRender);
   }
+  bool sleep = state == POWER_SLEEP;
+  scheduler.setPeriod(taskIdHTTP, sleep ? PERIOD_SLEEP_POLL : PERIOD_HANDLE_HTTP);
+  scheduler.setPeriod(taskIdWebSocket, sleep ? PERIOD_SLEEP_POLL : PERIOD_HANDLE_HTTP);
+  scheduler.setPeriod(taskIdOTA, sleep ? PERIOD_SLEEP_POLL : PERIOD_HANDLE_OTA);
+  scheduler.setPeriod(taskIdLogFlush, sleep ? PERIOD_SLEEP_POLL : PERIOD_LOG_FLUSH);
+  scheduler.setPeriod(taskIdMulticast, sleep ? PERIOD_SLEEP_POLL : PERIOD_MULTICAST_POLL);
+  // in light sleep the CPU sleeps during delay() and wakes with the DTIM beacon on incoming packets
+  WiFi.setSleepMode(sleep ? WIFI_LIGHT_SLEEP : wifiSleepModeAwake);
+  logger.logf(LOG_INFO, "Power state: %s", PowerManager::getStateName(state));
+}
 
-  // Turn off LEDs if ledOff is true or nightmode is active
-  if(ledOff || nightMode){
-    ledrings.flushInnerRing();
-    ledrings.flushOuterRing();
-    ledrings.drawOnRingsInstant();
+/**
+ * @brief Hook of the webserver, called for every request before it is handled. Keeps the 
+ * clock out of POWER_SLEEP for POWER_WAKE_HOLD ms, so following requests are fast.
+ * 
+ */
+ESP8266WebServer::ClientFuture handleRequestHook(const String &method, const String &url, WiFiClient *client, ESP8266WebServer::ContentTypeFunction contentType) {
+  power.wake(POWER_WAKE_HOLD);
+  if(power.getState() == POWER_SLEEP){
+    power.setState(POWER_IDLE);
   }
-  // periodically write colors to leds
-  else if(millis() - lastLedStep > PERIOD_LED_UPDATE){
-    ledrings.drawOnRingsSmooth(1.0);
-    lastLedStep = millis();
-  }
-
-  // NTP time update
-  if(millis() - lastNTPUpdate > PERIOD_NTP_UPDATE){
-    int res = ntp.updateNTP();
-    if(res == 0){
-      ntp.calcDate();
-      logger.logString("NTP-Update successful");
-      logger.logString("Time: " +  ntp.getFormattedTime());
-      logger.logString("Date: " +  ntp.getFormattedDate());
-      logger.logString("Day of Week (Mon=1, Sun=7): " +  String(ntp.getDayOfWeek()));
-      logger.logString("TimeOffset (seconds): " + String(ntp.getTimeOffset()));
-      logger.logString("Summertime: " + String(ntp.updateSWChange()));
-      lastNTPUpdate = millis();
-      watchdogCounter = 30;
+  return ESP8266WebServer::CLIENT_REQUEST_CAN_CONTINUE;
+}
+
+/**
+ * @brief Task: send a binary telemetry packet via UDP multicast (layout see telemetry.h)
+ */
+void taskTelemetry(){
+  static uint32_t sequence = 0;
+  const Task *render = scheduler.getTask(taskIdRender);
+
+  TelemetryPacket packet;
+  packet.magic = TELEMETRY_MAGIC;
+  packet.version = TELEMETRY_VERSION;
+  packet.flags = (ntp.getHealth() == NTP_HEALTH_SYNCED ? TELEMETRY_FLAG_NTP_SYNCED : 0)
+                | (ledOff ? TELEMETRY_FLAG_LED_OFF : 0)
+                | (nightMode ? TELEMETRY_FLAG_NIGHTMODE : 0)
+                | (ledrings.isSettled() ? TELEMETRY_FLAG_SETTLED : 0)
+                | (power.getState() == POWER_SLEEP ? TELEMETRY_FLAG_SLEEP : 0);
+  packet.sequence = sequence++;
+  packet.uptime = millis();
+  packet.statsDuration = scheduler.getStatsDuration();
+  packet.idleTime = scheduler.getIdleTime();
+  packet.renderRuns = render->stats.runs;
+  packet.renderMaxJitter = render->stats.maxJitter;
+  packet.renderTotalDuration = render->stats.totalDuration;
+  packet.renderMaxDuration = render->stats.maxDuration;
+  packet.framesPushed = ledrings.getFramesPushed();
+  packet.framesSkipped = ledrings.getFramesSkipped();
+  packet.ntpOffset = ntp.getLastOffset();
+  packet.ntpDelay = ntp.getRoundTripDelay();
+  packet.ntpDrift = ntp.getDriftPpb();
+  packet.ntpTimeSinceSync = ntp.getTimeSinceSync();
+  packet.ntpHealth = ntp.getHealth();
+  packet.ntpFailures = ntp.getConsecutiveFailures();
+  packet.rssi = WiFi.RSSI();
+  packet.heapFragmentation = ESP.getHeapFragmentation();
+  packet.freeHeap = ESP.getFreeHeap();
+  packet.maxFreeBlock = ESP.getMaxFreeBlockSize();
+  packet.logDropped = logger.getDroppedCount();
+  logger.sendBinary((const uint8_t*)&packet, sizeof(packet));
+}
+
+/**
+ * @brief Task: handle the datagrams of the multicast group (time beacons of other clocks) and 
+ * send the own time beacon if this clock leads
+ */
+void taskMulticast(){
+  static bool wasLeader = false;
+  static uint32_t lastLeaderId = 0;
+  uint8_t packet[MULTICAST_PACKET_MAX];
+  uint8_t quality = getTimeQuality();
+
+  for(uint8_t i = 0; i < MULTICAST_PACKETS_PER_RUN; i++){
+    size_t length = logger.receiveBinary(packet, sizeof(packet));
+    if(length == 0){
+      break;
     }
-    else if(res == -1){
-      logger.logString("NTP-Update not successful. Reason: Timeout");
-      lastNTPUpdate += 10000;
-      watchdogCounter--;
+    // in POWER_SLEEP the reception time is too inaccurate (slow polling), the LEDs are off anyway
+    if(timeBeacon.handlePacket(packet, length, millis(), quality) && power.getState() != POWER_SLEEP){
+      ntp.syncExternal(timeBeacon.getLeaderEpochMillis(), timeBeacon.getLeaderLocalMillis());
     }
-    else if(res == 1){
-      logger.logString("NTP-Update not successful. Reason: Too large time difference");
-      logger.logString("Time: " +  ntp.getFormattedTime());
-      logger.logString("Date: " +  ntp.getFormattedDate());
-      logger.logString("Day of Week (Mon=1, Sun=7): " +  ntp.getDayOfWeek());
-      logger.logString("TimeOffset (seconds): " + String(ntp.getTimeOffset()));
-      logger.logString("Summertime: " + String(ntp.updateSWChange()));
-      lastNTPUpdate += 10000;
-      watchdogCounter--;
+    handleFleetPacket(packet, length);
+  }
+
+  if(timeBeacon.getMode() != TIMESYNC_OFF && timeBeacon.isBeaconDue(quality)){
+    size_t length = timeBeacon.buildPacket(packet, sizeof(packet), ntp.getUTCEpochMillis(), quality);
+    logger.sendBinary(packet, length);
+  }
+
+  if(timeBeacon.isLeader() != wasLeader || (timeBeacon.isFollowing() && timeBeacon.getLeaderId() != lastLeaderId)){
+    wasLeader = timeBeacon.isLeader();
+    lastLeaderId = timeBeacon.getLeaderId();
+    if(wasLeader){
+      logger.logf(LOG_INFO, "Time sync: leading");
     }
-    else {
-      logger.logString("NTP-Update not successful. Reason: NTP time not valid (<1970)");
-      lastNTPUpdate += 10000;
-      watchdogCounter--;
+    else{
+      logger.logf(LOG_INFO, "Time sync: following %08X", lastLeaderId);
     }
+  }
+}
 
-    logger.logString("Watchdog Counter: " + String(watchdogCounter));
-    if(watchdogCounter <= 0){
-        logger.logString("Trigger restart due to watchdog...");
-        delay(100);
-        ESP.restart();
+/**
+ * @brief Handle a discovery request or bulk configuration of the fleet tool (see fleet.h), 
+ * the commands of a configuration are applied atomically like a request to "/cmd"
+ * 
+ * @param packet datagram of the multicast group, is modified
+ * @param length length of the datagram
+ */
+void handleFleetPacket(uint8_t *packet, size_t length){
+  FleetRequest request = fleet.handlePacket(packet, length, isTimeAvailable(), ntp.getUTCEpochMillis());
+  if(request == FLEET_REQUEST_NONE){
+    return;
+  }
+  // a configuration wakes the clock like a HTTP request
+  power.wake(POWER_WAKE_HOLD);
+
+  uint8_t answer[sizeof(FleetHeader) + sizeof(FleetAnnounce)];
+  size_t answerLength = 0;
+  if(request == FLEET_REQUEST_DISCOVER){
+    FleetAnnounce announce = {};
+    announce.id = ESP.getChipId();
+    announce.group = fleet.getGroup();
+    announce.ntpHealth = ntp.getHealth();
+    announce.timeSyncMode = timeBeacon.getMode();
+    announce.flags = (ledOff ? TELEMETRY_FLAG_LED_OFF : 0) | (nightMode ? TELEMETRY_FLAG_NIGHTMODE : 0)
+                    | (power.getState() == POWER_SLEEP ? TELEMETRY_FLAG_SLEEP : 0);
+    announce.uptime = millis();
+    announce.settingsCommits = settings.getCommitCount();
+    strlcpy(announce.hostname, hostname.c_str(), sizeof(announce.hostname));
+    strlcpy(announce.build, __TIMESTAMP__, sizeof(announce.build));
+    answerLength = fleet.buildAnnounce(answer, sizeof(answer), announce);
+  }
+  else{
+    FleetStatus status = fleet.getStatus();
+    if(request == FLEET_REQUEST_CONFIG){
+      const char *failedCommand = nullptr;
+      CommandParser::clear(pendingCommands);
+      if(commandParser.parseList(pendingCommands, fleet.getCommands(), fleet.getCommandsLength(), &failedCommand)){
+        applyPendingCommands();
+      }
+      else{
+        CommandParser::clear(pendingCommands);
+        status = FLEET_STATUS_INVALID;
+        logger.logf(LOG_WARN, "Fleet config: invalid command %s", failedCommand);
+      }
+      // the message must not be accepted again after a restart
+      saveRTCState();
     }
-    
+    logger.logf(LOG_INFO, "Fleet config: %s", Fleet::getStatusName(status));
+    answerLength = fleet.buildAck(answer, sizeof(answer), status);
+  }
+  logger.sendBinary(answer, answerLength);
+}
+
+/**
+ * @brief Get the quality of the own time for the election of the leader of the time beacons
+ * 
+ * @return uint8_t quality (lower is better), TIMEBEACON_QUALITY_NONE without valid time
+ */
+uint8_t getTimeQuality(){
+  NTPHealth health = ntp.getHealth();
+  return health == NTP_HEALTH_UNSYNCED ? TIMEBEACON_QUALITY_NONE : (uint8_t)health;
+}
+
+/**
+ * @brief Task: update time via NTP without blocking. The request is sent in the first run, 
+ * then the task polls for the reply every PERIOD_NTP_POLL until handleNTPResult() is called.
+ */
+void taskNTPUpdate(){
+  METRIC_SCOPE(METRIC_NTP_UPDATE);
+  if(!ntp.isUpdatePending() && timeBeacon.isFollowing()){
+    // the time base follows the time beacons of the leader
+    scheduler.setNextRun(taskIdNTPUpdate, PERIOD_NTP_UPDATE);
+    return;
+  }
+  if(!ntp.isUpdatePending()){
+    // no light sleep while waiting for the reply
+    power.wake(PERIOD_POWER_CHECK);
+    updatePowerState();
+    ntp.beginUpdate();
+  }
+  else if(ntp.poll() != NTP_PENDING){
+    // result was handled by handleNTPResult()
+    return;
+  }
+  scheduler.setNextRun(taskIdNTPUpdate, PERIOD_NTP_POLL);
+}
+
+/**
+ * @brief Handle the result of an NTP update. Failed updates are retried with exponential backoff, 
+ * meanwhile the clock keeps running on the drift compensated time base.
+ * 
+ * @param status result of the update
+ */
+void handleNTPResult(NTPStatus status){
+  if(status == NTP_SUCCESS){
+    logger.logf(LOG_INFO, "NTP-Update successful");
+    logger.logf(LOG_INFO, "Offset: %ld ms, Delay: %lu ms, Drift: %ld ppb", ntp.getLastOffset(), ntp.getRoundTripDelay(), ntp.getDriftPpb());
+    logNTPTime();
+  }
+  else if(status == NTP_TIMEOUT){
+    logger.logf(LOG_WARN, "NTP-Update not successful. Reason: Timeout");
+  }
+  else if(status == NTP_TIME_JUMP){
+    logger.logf(LOG_WARN, "NTP-Update not successful. Reason: Too large time difference");
+    logNTPTime();
+  }
+  else {
+    logger.logf(LOG_WARN, "NTP-Update not successful. Reason: NTP time not valid (<1970)");
   }
 
-  // check if nightmode need to be activated
-  if(millis() - lastNightmodeCheck > PERIOD_NIGHTMODE_CHECK){
-    int hours = ntp.getHours24();
-    int minutes = ntp.getMinutes();
+  // next update after the update interval, or retry with backoff
+  scheduler.setNextRun(taskIdNTPUpdate, ntp.getNextUpdateDelay());
+
+  if(ntpHealth == NTP_HEALTH_UNSYNCED && ntp.getHealth() != NTP_HEALTH_UNSYNCED){
+    // first valid time: show the clock and check the nightmode now
+    scheduler.runTaskNow(taskIdNightmodeCheck);
+    scheduler.runTaskNow(taskIdRender);
+  }
+  if(ntp.getHealth() != ntpHealth){
+    ntpHealth = ntp.getHealth();
+    logger.logf(LOG_INFO, "NTP health: %s, failures: %u", ntpHealthName(ntpHealth), ntp.getConsecutiveFailures());
+  }
+}
 
-    nightMode = false; // Initial assumption
+/**
+ * @brief Log the current time, date and time offset of the NTP client
+ */
+void logNTPTime(){
+  ntp.calcDate();
+  logger.logf(LOG_INFO, "Time: %02d:%02d:%02d, Date: %s, Day of Week (Mon=1, Sun=7): %u", 
+                ntp.getHours24(), ntp.getMinutes(), ntp.getSeconds(), ntp.getFormattedDate().c_str(), ntp.getDayOfWeek());
+  logger.logf(LOG_INFO, "TimeOffset (seconds): %ld, Summertime: %d", ntp.getTimeOffset(), ntp.updateSWChange());
+}
 
-    // Convert all times to minutes for easier comparison
-    int currentTimeInMinutes = hours * 60 + minutes;
-    int startInMinutes = nightModeStartHour * 60 + nightModeStartMin;
-    int endInMinutes = nightModeEndHour * 60 + nightModeEndMin;
+/**
+ * @brief Get the name of the NTP health
+ * 
+ * @param health health of the NTP synchronization
+ * @return const char* name
+ */
+const char* ntpHealthName(NTPHealth health){
+  switch(health){
+    case NTP_HEALTH_SYNCED: return "synced";
+    case NTP_HEALTH_DEGRADED: return "degraded";
+    case NTP_HEALTH_FREE_RUNNING: return "free running";
+    default: return "unsynced";
+  }
+}
 
-    if (startInMinutes < endInMinutes) { // Same day scenario
-        if (startInMinutes < currentTimeInMinutes && currentTimeInMinutes < endInMinutes) {
-            nightMode = true;
-        }
-    } else if (startInMinutes > endInMinutes) { // Overnight scenario
-        if (currentTimeInMinutes > startInMinutes || currentTimeInMinutes < endInMinutes) {
-            nightMode = true;
-        }
-    } 
-    
-    lastNightmodeCheck = millis();
+/**
+ * @brief Task: check if nightmode need to be activated
+ */
+void taskNightmodeCheck(){
+  if(!isTimeAvailable()){
+    // checked again after the first NTP update (see handleNTPResult())
+    return;
+  }
+  int hours = ntp.getHours24();
+  int minutes = ntp.getMinutes();
+
+  nightMode = false; // Initial assumption
+
+  // Convert all times to minutes for easier comparison
+  int currentTimeInMinutes = hours * 60 + minutes;
+  int startInMinutes = nightModeStartHour * 60 + nightModeStartMin;
+  int endInMinutes = nightModeEndHour * 60 + nightModeEndMin;
+
+  if (startInMinutes < endInMinutes) { // Same day scenario
+      if (startInMinutes < currentTimeInMinutes && currentTimeInMinutes < endInMinutes) {
+          nightMode = true;
+      }
+  } else if (startInMinutes > endInMinutes) { // Overnight scenario
+      if (currentTimeInMinutes > startInMinutes || currentTimeInMinutes < endInMinutes) {
+          nightMode = true;
+      }
   }
 
+  // wake up exactly at the end of the nightmode instead of up to one period later
+  if (nightMode) {
+      uint32_t msUntilEnd = (((endInMinutes - currentTimeInMinutes + 1440) % 1440) * 60UL - ntp.getSeconds()) * 1000UL;
+      if (msUntilEnd < PERIOD_NIGHTMODE_CHECK) {
+          scheduler.setNextRun(taskIdNightmodeCheck, msUntilEnd + 100);
+      }
+  }
+  updatePowerState();
 }
 
 // ----------------------------------------------------------------------------------
@@ -327,98 +769,174 @@ void loop() {
 // ----------------------------------------------------------------------------------
 
 /**
- * @brief Run a quick LED test
-*/
-void runQuickLEDTest(){
-  // test quickly each LED
-  for(int i=0; i<inner_ring.numPixels(); i++) {
-    inner_ring.setPixelColor(i, inner_ring.Color(0, 0, 0));
-    inner_ring.setPixelColor((i+1)%inner_ring.numPixels(), inner_ring.Color(0, 255, 0));
-    inner_ring.show();
-    delay(100);
+ * @brief Check if there is a valid time to show
+ * 
+ * @return true time was synchronized at least once
+ */
+bool isTimeAvailable(){
+  return ntp.getHealth() != NTP_HEALTH_UNSYNCED;
+}
+
+/**
+ * @brief Restore time base and display mode from the snapshot in the RTC user memory
+ * 
+ * @return true valid snapshot restored
+ */
+bool restoreRTCState(){
+  if(!rtcState.load()){
+    return false;
+  }
+  ntp.restoreTime(rtcState.getUTCEpochMillis(), rtcState.getDriftPpb(), rtcState.getTimeSinceSync());
+  ledOff = rtcState.getFlags() & RTC_FLAG_LED_OFF;
+  nightMode = rtcState.getFlags() & RTC_FLAG_NIGHTMODE;
+  fleet.restoreReplayFloor(rtcState.getFleetTimestamp());
+  return true;
+}
+
+/**
+ * @brief Task: write a snapshot of time base, display mode and the replay protection of the 
+ * fleet configuration to the RTC user memory, also called right before a planned restart 
+ * and after an accepted fleet configuration
+ */
+void saveRTCState(){
+  if(!isTimeAvailable()){
+    return;
   }
+  uint8_t flags = (ledOff ? RTC_FLAG_LED_OFF : 0) | (nightMode ? RTC_FLAG_NIGHTMODE : 0);
+  uint64_t utcEpochMillis = ntp.getUTCEpochMillis();
+  rtcState.save(utcEpochMillis, ntp.getDriftPpb(), ntp.getTimeSinceSync(), flags, fleet.getReplayFloor(utcEpochMillis));
+}
 
-  for(int i=0; i<outer_ring.numPixels(); i++) {
-    outer_ring.setPixelColor(i, outer_ring.Color(0, 0, 0));
-    outer_ring.setPixelColor((i+1)%outer_ring.numPixels(), outer_ring.Color(0, 0, 255));
-    outer_ring.show();
-    delay(10);
+/**
+ * @brief Log the information about the program, called once the UDP logger is connected
+ */
+void logStartupInfo(){
+  logger.logf(LOG_INFO, "Start program");
+  logger.logf(LOG_INFO, "Sketchname: %s", __FILE__);
+  logger.logf(LOG_INFO, "Build: %s", __TIMESTAMP__);
+  logger.logf(LOG_INFO, "IP: %s", WiFi.localIP().toString().c_str());
+  logger.logf(LOG_INFO, "Reset Reason: %s", ESP.getResetReason().c_str());
+  if(rtcState.isValid()){
+    logger.logf(LOG_INFO, "Time restored from RTC memory, age: %u ms, restarts since power on: %u", rtcState.getAge(), rtcState.getRestartCount());
   }
+  logger.logf(LOG_INFO, "Settings %s", settingsSource == SETTINGS_SOURCE_MIGRATED ? "migrated from old EEPROM layout" : "loaded from flash");
+  logger.logf(LOG_INFO, "Nightmode starts at: %d:%d, ends at: %d:%d", nightModeStartHour, nightModeStartMin, nightModeEndHour, nightModeEndMin);
+  logger.logf(LOG_INFO, "BrightnessIR: %u, BrightnessOR: %u", ledrings.getBrightnessInnerRing(), ledrings.getBrightnessOuterRing());
+}
 
-  // clear all LEDs
-  inner_ring.clear();
-  outer_ring.clear();
-  inner_ring.show();
-  outer_ring.show();
-  delay(200);
+/**
+ * @brief Start a boot overlay (shown by taskBootOverlay(), clock layers are hidden meanwhile)
+ * 
+ * @param overlay BOOT_OVERLAY_LED_TEST or BOOT_OVERLAY_IP
+ */
+void startBootOverlay(uint8_t overlay){
+  bootOverlay = overlay;
+  bootOverlayStep = 0;
+  ledrings.setLayerVisible(LAYER_HOURS, false);
+  ledrings.setLayerVisible(LAYER_MINUTES, false);
+  ledrings.setLayerVisible(LAYER_SECONDS, false);
+  ledrings.flushInnerRing(LAYER_OVERLAY);
+  ledrings.flushOuterRing(LAYER_OVERLAY);
+  scheduler.setEnabled(taskIdBootOverlay, true);
+  scheduler.runTaskNow(taskIdBootOverlay);
+  updatePowerState();
 }
 
 /**
- * @brief Load the colors for hours, minutes and seconds from EEPROM
+ * @brief Run a quick LED test (running light on the overlay layer) without blocking
 */
-void loadColorsFromEEPROM(){
-  colorHours = getRGBColorFromEEPROM(ADR_CH_RED, ADR_CH_GREEN, ADR_CH_BLUE);
-  colorMinutes = getRGBColorFromEEPROM(ADR_CM_RED, ADR_CM_GREEN, ADR_CM_BLUE);
-  colorSeconds = getRGBColorFromEEPROM(ADR_CS_RED, ADR_CS_GREEN, ADR_CS_BLUE);
+void startLEDTest(){
+  startBootOverlay(BOOT_OVERLAY_LED_TEST);
 }
 
 /**
- * @brief Load a color from EEPROM
- * 
- * @param adr_red address of red value in EEPROM
- * @param adr_green address of green value in EEPROM
- * @param adr_blue address of blue value in EEPROM
- * 
- * @return color as 24bit integer
+ * @brief Show the last three digits of the IP address without blocking, after the LED test if it is running
 */
-uint32_t getRGBColorFromEEPROM(uint8_t adr_red, uint8_t adr_green, uint8_t adr_blue){
-  uint8_t red = EEPROM.read(adr_red);
-  uint8_t green = EEPROM.read(adr_green);
-  uint8_t blue = EEPROM.read(adr_blue);
-  if(int(red) + int(green) + int(blue) < 50){
-    return LEDRings::Color24bit(200, 200, 0);
-  } else {
-    return LEDRings::Color24bit(red, green, blue);
+void startIPDisplay(){
+  if(bootOverlay == BOOT_OVERLAY_LED_TEST){
+    bootOverlayIPPending = true;
+    return;
   }
+  startBootOverlay(BOOT_OVERLAY_IP);
 }
 
 /**
- * @brief Load the nightmode settings from EEPROM
-*/
-void loadNightmodeSettingsFromEEPROM()
-{
-  nightModeStartHour = EEPROM.read(ADR_NM_START_H);
-  nightModeStartMin = EEPROM.read(ADR_NM_START_M);
-  nightModeEndHour = EEPROM.read(ADR_NM_END_H);
-  nightModeEndMin = EEPROM.read(ADR_NM_END_M);
-  if (nightModeStartHour > 23)
-    nightModeStartHour = 22; // set to 22 o'clock as default
-  if (nightModeStartMin > 59)
-    nightModeStartMin = 0;
-  if (nightModeEndHour > 23)
-    nightModeEndHour = 7; // set to 7 o'clock as default
-  if (nightModeEndMin > 59)
-    nightModeEndMin = 0;
-  logger.logString("Nightmode starts at: " + String(nightModeStartHour) + ":" + String(nightModeStartMin));
-  logger.logString("Nightmode ends at: " + String(nightModeEndHour) + ":" + String(nightModeEndMin));
-}
-
-/**
- * @brief Load the brightness settings from EEPROM
- * 
- * lower limit is 10 so that the LEDs are not completely off
+ * @brief Task: show the next step of the boot overlay, the task is only enabled while an overlay is shown
+ */
+void taskBootOverlay(){
+  uint16_t step = bootOverlayStep++;
+  uint32_t nextRun = 0;
+
+  if(bootOverlay == BOOT_OVERLAY_LED_TEST){
+    // test quickly each LED
+    if(step < LEDRings::innerRingLedCount){
+      ledrings.setPixelInnerRing(LAYER_OVERLAY, step, LEDRings::Color24bit(0, 0, 0));
+      ledrings.setPixelInnerRing(LAYER_OVERLAY, (step+1)%LEDRings::innerRingLedCount, LEDRings::Color24bit(0, 255, 0));
+      nextRun = 100;
+    }
+    else if(step < LEDRings::innerRingLedCount + LEDRings::outerRingLedCount){
+      step -= LEDRings::innerRingLedCount;
+      ledrings.setPixelOuterRing(LAYER_OVERLAY, step, LEDRings::Color24bit(0, 0, 0));
+      ledrings.setPixelOuterRing(LAYER_OVERLAY, (step+1)%LEDRings::outerRingLedCount, LEDRings::Color24bit(0, 0, 255));
+      nextRun = 10;
+    }
+    else if(step == LEDRings::innerRingLedCount + LEDRings::outerRingLedCount){
+      // clear all LEDs
+      ledrings.flushInnerRing(LAYER_OVERLAY);
+      ledrings.flushOuterRing(LAYER_OVERLAY);
+      nextRun = 200;
+    }
+  }
+  else if(bootOverlay == BOOT_OVERLAY_IP && step < 3){
+    // digits of the last byte of the IP address, a 0 is shown as 10
+    uint8_t address = WiFi.localIP()[3];
+    uint8_t digit = step == 0 ? address/100 : (step == 1 ? (address/10)%10 : address%10);
+    showDigitOnOverlay(digit == 0 ? 10 : digit, colorHours);
+    nextRun = 2000;
+  }
+
+  if(nextRun == 0){
+    finishBootOverlay();
+    return;
+  }
+  scheduler.runTaskNow(taskIdRender);
+  scheduler.setNextRun(taskIdBootOverlay, nextRun);
+}
+
+/**
+ * @brief End the current boot overlay and show the clock again (or the pending IP display)
+ */
+void finishBootOverlay(){
+  ledrings.flushInnerRing(LAYER_OVERLAY);
+  ledrings.flushOuterRing(LAYER_OVERLAY);
+  if(bootOverlayIPPending){
+    bootOverlayIPPending = false;
+    startBootOverlay(BOOT_OVERLAY_IP);
+    return;
+  }
+  bootOverlay = BOOT_OVERLAY_NONE;
+  scheduler.setEnabled(taskIdBootOverlay, false);
+
+  // show clock again
+  ledrings.setLayerVisible(LAYER_HOURS, true);
+  ledrings.setLayerVisible(LAYER_MINUTES, true);
+  ledrings.setLayerVisible(LAYER_SECONDS, true);
+  updatePowerState();
+  scheduler.runTaskNow(taskIdRender);
+}
+
+/**
+ * @brief Apply the colors, nightmode and brightness settings of the settings store
 */
-void loadBrightnessSettingsFromEEPROM()
-{
-  uint8_t brightnessIR = EEPROM.read(ADR_BRIGHTNESS_INNER);
-  uint8_t brightnessOR = EEPROM.read(ADR_BRIGHTNESS_OUTER);
-  if (brightnessIR < 10)
-    brightnessIR = 10;
-  if (brightnessOR < 10)
-    brightnessOR = 10;
-  ledrings.setBrightnessInnerRing(brightnessIR);
-  ledrings.setBrightnessOuterRing(brightnessOR);
-  logger.logString("BrightnessIR: " + String(brightnessIR) + ", BrightnessOR: " + String(brightnessOR));
+void loadSettings(){
+  colorHours = settings.getColor(SETTINGS_COLOR_HOURS);
+  colorMinutes = settings.getColor(SETTINGS_COLOR_MINUTES);
+  colorSeconds = settings.getColor(SETTINGS_COLOR_SECONDS);
+  settings.getNightMode(nightModeStartHour, nightModeStartMin, nightModeEndHour, nightModeEndMin);
+  ledrings.setBrightnessInnerRing(settings.getBrightnessInner());
+  ledrings.setBrightnessOuterRing(settings.getBrightnessOuter());
+  timeBeacon.setMode((TimeSyncMode)settings.getTimeSyncMode());
+  fleet.setGroup(settings.getFleetGroup());
 }
 
 /**
@@ -430,10 +948,7 @@ void loadBrightnessSettingsFromEEPROM()
 */
 void setColorHours(uint8_t red, uint8_t green, uint8_t blue){
   colorHours = LEDRings::Color24bit(red, green, blue);
-  EEPROM.write(ADR_CH_RED, red);
-  EEPROM.write(ADR_CH_GREEN, green);
-  EEPROM.write(ADR_CH_BLUE, blue);
-  EEPROM.commit();
+  settings.setColor(SETTINGS_COLOR_HOURS, red, green, blue);
 }
 
 /**
@@ -445,10 +960,7 @@ void setColorHours(uint8_t red, uint8_t green, uint8_t blue){
 */
 void setColorMinutes(uint8_t red, uint8_t green, uint8_t blue){
   colorMinutes = LEDRings::Color24bit(red, green, blue);
-  EEPROM.write(ADR_CM_RED, red);
-  EEPROM.write(ADR_CM_GREEN, green);
-  EEPROM.write(ADR_CM_BLUE, blue);
-  EEPROM.commit();
+  settings.setColor(SETTINGS_COLOR_MINUTES, red, green, blue);
 }
 
 /**
@@ -460,124 +972,207 @@ void setColorMinutes(uint8_t red, uint8_t green, uint8_t blue){
 */
 void setColorSeconds(uint8_t red, uint8_t green, uint8_t blue){
   colorSeconds = LEDRings::Color24bit(red, green, blue);
-  EEPROM.write(ADR_CS_RED, red);
-  EEPROM.write(ADR_CS_GREEN, green);
-  EEPROM.write(ADR_CS_BLUE, blue);
-  EEPROM.commit();
+  settings.setColor(SETTINGS_COLOR_SECONDS, red, green, blue);
 }
 
 /**
- * @brief Handler for handling commands sent to "/cmd" url
+ * @brief Handler for handling commands sent to "/cmd" url. Several commands can be sent 
+ * in one request, either as URL parameters (e.g. /cmd?col_hours=255-0-0&col_minutes=0-0-255) 
+ * or as body of a POST request in the same format (separated by '&' or newlines). 
+ * The commands are applied atomically: if one of them is unknown or invalid, none is applied 
+ * and 400 is returned.
  * 
  */
 void handleCommand() {
-  // receive command and handle accordingly
-  for (uint8_t i = 0; i < server.args(); i++) {
-    Serial.print(server.argName(i));
-    Serial.print(F(": "));
-    Serial.println(server.arg(i));
-  }
-  
-  if (server.argName(0) == "col_hours") // the parameter which was sent to this server is the color for hours
-  {
-    String colorstr = server.arg(0) + "-";
-    String redstr = split(colorstr, '-', 0);
-    String greenstr= split(colorstr, '-', 1);
-    String bluestr = split(colorstr, '-', 2);
-    logger.logString(colorstr);
-    logger.logString("r: " + String(redstr.toInt()));
-    logger.logString("g: " + String(greenstr.toInt()));
-    logger.logString("b: " + String(bluestr.toInt()));
-    setColorHours(redstr.toInt(), greenstr.toInt(), bluestr.toInt());
-  }
-  else if (server.argName(0) == "col_minutes") // the parameter which was sent to this server is the color for minutes
-  {
-    String colorstr = server.arg(0) + "-";
-    String redstr = split(colorstr, '-', 0);
-    String greenstr= split(colorstr, '-', 1);
-    String bluestr = split(colorstr, '-', 2);
-    logger.logString(colorstr);
-    logger.logString("r: " + String(redstr.toInt()));
-    logger.logString("g: " + String(greenstr.toInt()));
-    logger.logString("b: " + String(bluestr.toInt()));
-    setColorMinutes(redstr.toInt(), greenstr.toInt(), bluestr.toInt());
-  }
-  else if (server.argName(0) == "col_seconds") // the parameter which was sent to this server is the color for seconds
-  {
-    String colorstr = server.arg(0) + "-";
-    String redstr = split(colorstr, '-', 0);
-    String greenstr= split(colorstr, '-', 1);
-    String bluestr = split(colorstr, '-', 2);
-    logger.logString(colorstr);
-    logger.logString("r: " + String(redstr.toInt()));
-    logger.logString("g: " + String(greenstr.toInt()));
-    logger.logString("b: " + String(bluestr.toInt()));
-    setColorSeconds(redstr.toInt(), greenstr.toInt(), bluestr.toInt());
-  }
-  else if(server.argName(0) == "ledoff"){
-    String modestr = server.arg(0);
-    logger.logString("LED off change via Webserver to: " + modestr);
-    if(modestr == "1") ledOff = true;
-    else ledOff = false;
-  }
-  else if(server.argName(0) == "setting"){
-    String timestr = server.arg(0) + "-";
-    logger.logString("Nightmode setting change via Webserver to: " + timestr);
-    nightModeStartHour = split(timestr, '-', 0).toInt();
-    nightModeStartMin = split(timestr, '-', 1).toInt();
-    nightModeEndHour = split(timestr, '-', 2).toInt();
-    nightModeEndMin = split(timestr, '-', 3).toInt();
-    uint8_t brightnessIR = split(timestr, '-', 4).toInt();
-    uint8_t brightnessOR = split(timestr, '-', 5).toInt();
+  CommandParser::clear(pendingCommands);
+  if(server.hasArg("plain")){
+    // POST body (not form encoded), tokenized in place
+    String body = server.arg("plain");
+    const char *failedCommand = "";
+    if(!commandParser.parseList(pendingCommands, body.begin(), body.length(), &failedCommand)){
+      logger.logf(LOG_WARN, "Unknown or invalid command via Webserver: %s", failedCommand);
+      server.send(400, "text/plain", "Unknown or invalid command");
+      return;
+    }
+  }
+  else {
+    for (uint8_t i = 0; i < server.args(); i++) {
+      String value = server.arg(i);
+      if(!commandParser.parse(pendingCommands, server.argName(i).c_str(), value.begin())){
+        logger.logf(LOG_WARN, "Unknown or invalid command via Webserver: %s", server.argName(i).c_str());
+        server.send(400, "text/plain", "Unknown or invalid command");
+        return;
+      }
+    }
+  }
+  applyPendingCommands();
+
+  // show the change with the next loop iteration and push it to the WebSocket clients
+  scheduler.runTaskNow(taskIdRender);
+  scheduler.runTaskNow(taskIdStatePush);
+
+  server.send(204, "text/plain", "No Content"); // this page doesn't send back content --> 204
+}
+
+/**
+ * @brief Execute all commands collected by the CommandParser, changed settings are written 
+ * to flash together by the settings store (taskSettingsCommit)
+ * 
+ */
+void applyPendingCommands() {
+  if(pendingCommands.colorMask & 0x01){
+    uint8_t *color = pendingCommands.colors[0];
+    logger.logf(LOG_DEBUG, "Color hours r: %u, g: %u, b: %u", color[0], color[1], color[2]);
+    setColorHours(color[0], color[1], color[2]);
+  }
+  if(pendingCommands.colorMask & 0x02){
+    uint8_t *color = pendingCommands.colors[1];
+    logger.logf(LOG_DEBUG, "Color minutes r: %u, g: %u, b: %u", color[0], color[1], color[2]);
+    setColorMinutes(color[0], color[1], color[2]);
+  }
+  if(pendingCommands.colorMask & 0x04){
+    uint8_t *color = pendingCommands.colors[2];
+    logger.logf(LOG_DEBUG, "Color seconds r: %u, g: %u, b: %u", color[0], color[1], color[2]);
+    setColorSeconds(color[0], color[1], color[2]);
+  }
+  if(pendingCommands.hasLedOff){
+    logger.logf(LOG_INFO, "LED off change via Webserver to: %d", pendingCommands.ledOff);
+    ledOff = pendingCommands.ledOff;
+  }
+  if(pendingCommands.hasSetting){
+    uint8_t *setting = pendingCommands.setting;
+    nightModeStartHour = setting[0];
+    nightModeStartMin = setting[1];
+    nightModeEndHour = setting[2];
+    nightModeEndMin = setting[3];
+    uint8_t brightnessIR = setting[4];
+    uint8_t brightnessOR = setting[5];
     if(nightModeStartHour > 23) nightModeStartHour = 22; // set default
     if(nightModeStartMin > 59) nightModeStartMin = 0;
     if(nightModeEndHour > 23) nightModeEndHour = 7; // set default
     if(nightModeEndMin > 59) nightModeEndMin = 0;
     if(brightnessIR < 10) brightnessIR = 10;
     if(brightnessOR < 10) brightnessOR = 10;
-    EEPROM.write(ADR_NM_START_H, nightModeStartHour);
-    EEPROM.write(ADR_NM_START_M, nightModeStartMin);
-    EEPROM.write(ADR_NM_END_H, nightModeEndHour);
-    EEPROM.write(ADR_NM_END_M, nightModeEndMin);
-    EEPROM.write(ADR_BRIGHTNESS_INNER, brightnessIR);
-    EEPROM.write(ADR_BRIGHTNESS_OUTER, brightnessOR);
-    logger.logString("Nightmode starts at: " + String(nightModeStartHour) + ":" + String(nightModeStartMin));
-    logger.logString("Nightmode ends at: " + String(nightModeEndHour) + ":" + String(nightModeEndMin));
-    logger.logString("BrightnessIR: " + String(brightnessIR) + ", BrightnessOR: " + String(brightnessOR));
+    settings.setNightMode(nightModeStartHour, nightModeStartMin, nightModeEndHour, nightModeEndMin);
+    settings.setBrightness(brightnessIR, brightnessOR);
+    logger.logf(LOG_INFO, "Nightmode starts at: %d:%d", nightModeStartHour, nightModeStartMin);
+    logger.logf(LOG_INFO, "Nightmode ends at: %d:%d", nightModeEndHour, nightModeEndMin);
+    logger.logf(LOG_INFO, "BrightnessIR: %u, BrightnessOR: %u", brightnessIR, brightnessOR);
     ledrings.setBrightnessInnerRing(brightnessIR);
     ledrings.setBrightnessOuterRing(brightnessOR);
-    lastNightmodeCheck = 0;
+    scheduler.runTaskNow(taskIdNightmodeCheck);
   }
-  else if (server.argName(0) == "resetwifi"){
-    logger.logString("Reset Wifi via Webserver...");
+  if(pendingCommands.hasTelemetry){
+    long period = pendingCommands.telemetryPeriod;
+    logger.logf(LOG_INFO, "Telemetry period change via Webserver to: %ld ms", period);
+    if(period > 0){
+      scheduler.setPeriod(taskIdTelemetry, constrain(period, (long)TELEMETRY_PERIOD_MIN, (long)TELEMETRY_PERIOD_MAX));
+    }
+    scheduler.setEnabled(taskIdTelemetry, period > 0);
+  }
+  if(pendingCommands.hasTimeSync){
+    logger.logf(LOG_INFO, "Time sync mode change via Webserver to: %s", TimeBeacon::getModeName(pendingCommands.timeSyncMode));
+    timeBeacon.setMode(pendingCommands.timeSyncMode);
+    settings.setTimeSyncMode(pendingCommands.timeSyncMode);
+  }
+  if(pendingCommands.hasGroup){
+    logger.logf(LOG_INFO, "Group change via Webserver to: %u", pendingCommands.group);
+    fleet.setGroup(pendingCommands.group);
+    settings.setFleetGroup(pendingCommands.group);
+  }
+  if(pendingCommands.resetWifi){
+    logger.logf(LOG_INFO, "Reset Wifi via Webserver...");
     wifiManager.resetSettings();
-    runQuickLEDTest();
+    startLEDTest();
+  }
+  CommandParser::clear(pendingCommands);
+  updatePowerState();
+}
+
+/**
+ * @brief Handler for WebSocket events. A new client gets the complete state, text messages 
+ * contain one or more commands in the same format as the parameters of "/cmd" 
+ * (e.g. "col_hours=255-0-0&ledoff=1", separated by '&' or newlines). The commands of one 
+ * message are applied atomically.
+ * 
+ * @param num number of the client
+ * @param type type of the event
+ * @param payload payload of the message
+ * @param length length of the payload
+ */
+void handleWebSocketEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length) {
+  if(type == WStype_CONNECTED){
+    char json[STATE_JSON_MAX];
+    int jsonLength = formatStateJson(json, sizeof(json), true);
+    webSocket.sendTXT(num, json, jsonLength);
+  }
+  else if(type == WStype_TEXT){
+    // the payload is null terminated by the WebSocket library, so it can be tokenized in place
+    const char *failedCommand = "";
+    CommandParser::clear(pendingCommands);
+    if(!commandParser.parseList(pendingCommands, (char*)payload, length, &failedCommand)){
+      logger.logf(LOG_WARN, "Unknown or invalid WebSocket command: %s", failedCommand);
+      return;
+    }
+    applyPendingCommands();
+    // show the change with the next loop iteration and echo it to all clients
+    scheduler.runTaskNow(taskIdRender);
+    scheduler.runTaskNow(taskIdStatePush);
   }
-  
-  server.send(204, "text/plain", "No Content"); // this page doesn't send back content --> 204
 }
 
 /**
- * @brief Splits a string at given character and return specified element
+ * @brief Format the state of the clock as JSON object (same keys as "/data?key=mode", 
+ * extended by the colors and the NTP health)
  * 
- * @param s string to split
- * @param parser separating character
- * @param index index of the element to return
- * @return String 
+ * @param buffer output buffer
+ * @param size size of the buffer (STATE_JSON_MAX)
+ * @param full true: all fields, false: only the fields changed since the last call with full = false
+ * @return int length of the JSON object, 0 if nothing changed
  */
-String split(String s, char parser, int index) {
-  String rs="";
-  int parserCnt=0;
-  int rFromIndex=0, rToIndex=-1;
-  while (index >= parserCnt) {
-    rFromIndex = rToIndex+1;
-    rToIndex = s.indexOf(parser,rFromIndex);
-    if (index == parserCnt) {
-      if (rToIndex == 0 || rToIndex == -1) return "";
-      return s.substring(rFromIndex,rToIndex);
-    } else parserCnt++;
+int formatStateJson(char *buffer, size_t size, bool full) {
+  static const char* const keys[STATE_FIELD_COUNT] = {"ledoff", "nightMode", "nightModeStart", "nightModeEnd", 
+                      "brightnessIR", "brightnessOR", "colorHours", "colorMinutes", "colorSeconds", "ntpHealth"};
+  static char lastValues[STATE_FIELD_COUNT][STATE_VALUE_MAX];
+
+  int length = 0;
+  for(uint8_t field = 0; field < STATE_FIELD_COUNT; field++){
+    char value[STATE_VALUE_MAX];
+    switch(field){
+      case 0: snprintf(value, sizeof(value), "%d", ledOff); break;
+      case 1: snprintf(value, sizeof(value), "%d", nightMode); break;
+      case 2: snprintf(value, sizeof(value), "%02d-%02d", nightModeStartHour, nightModeStartMin); break;
+      case 3: snprintf(value, sizeof(value), "%02d-%02d", nightModeEndHour, nightModeEndMin); break;
+      case 4: snprintf(value, sizeof(value), "%u", ledrings.getBrightnessInnerRing()); break;
+      case 5: snprintf(value, sizeof(value), "%u", ledrings.getBrightnessOuterRing()); break;
+      case 6: snprintf(value, sizeof(value), "%lu-%lu-%lu", (colorHours >> 16) & 0xFFUL, (colorHours >> 8) & 0xFFUL, colorHours & 0xFFUL); break;
+      case 7: snprintf(value, sizeof(value), "%lu-%lu-%lu", (colorMinutes >> 16) & 0xFFUL, (colorMinutes >> 8) & 0xFFUL, colorMinutes & 0xFFUL); break;
+      case 8: snprintf(value, sizeof(value), "%lu-%lu-%lu", (colorSeconds >> 16) & 0xFFUL, (colorSeconds >> 8) & 0xFFUL, colorSeconds & 0xFFUL); break;
+      default: snprintf(value, sizeof(value), "%s", ntpHealthName(ntp.getHealth())); break;
+    }
+    if(!full){
+      if(strcmp(value, lastValues[field]) == 0) continue;
+      strcpy(lastValues[field], value);
+    }
+    length += snprintf(buffer + length, size - length, "%c\"%s\":\"%s\"", length == 0 ? '{' : ',', keys[field], value);
+  }
+  if(length == 0){
+    buffer[0] = '\0';
+    return 0;
   }
-  return rs;
+  length += snprintf(buffer + length, size - length, "}");
+  return length;
+}
+
+/**
+ * @brief Flush function of the JsonWriter, sends the buffered JSON text as one chunk of the 
+ * current HTTP response
+ * 
+ * @param data JSON text
+ * @param length length of the text
+ */
+void sendJsonChunk(const char *data, size_t length) {
+  server.sendContent(data, length);
 }
 
 /**
@@ -586,46 +1181,187 @@ String split(String s, char parser, int index) {
  */
 void handleDataRequest() {
   // receive data request and handle accordingly
-  for (uint8_t i = 0; i < server.args(); i++) {
-    Serial.print(server.argName(i));
-    Serial.print(F(": "));
-    Serial.println(server.arg(i));
-  }
-  
   if (server.argName(0) == "key") // the parameter which was sent to this server is led color
   {
-    String message = "{";
-    String keystr = server.arg(0);
-    if(keystr == "mode"){
-      message += "\"ledoff\":\"" + String(ledOff) + "\"";
-      message += ",";
-      message += "\"nightMode\":\"" + String(nightMode) + "\"";
-      message += ",";
-      message += "\"nightModeStart\":\"" + leadingZero2Digit(nightModeStartHour) + "-" + leadingZero2Digit(nightModeStartMin) + "\"";
-      message += ",";
-      message += "\"nightModeEnd\":\"" + leadingZero2Digit(nightModeEndHour) + "-" + leadingZero2Digit(nightModeEndMin) + "\"";
-      message += ",";
-      message += "\"brightnessIR\":\"" + String(ledrings.getBrightnessInnerRing()) + "\"";
-      message += ",";
-      message += "\"brightnessOR\":\"" + String(ledrings.getBrightnessOuterRing()) + "\"";
+    char buffer[JSON_CHUNK_SIZE];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    if(server.arg(0) == "mode"){
+      json.key("ledoff").valuef("%d", ledOff);
+      json.key("nightMode").valuef("%d", nightMode);
+      json.key("nightModeStart").valuef("%02d-%02d", nightModeStartHour, nightModeStartMin);
+      json.key("nightModeEnd").valuef("%02d-%02d", nightModeEndHour, nightModeEndMin);
+      json.key("brightnessIR").valuef("%u", ledrings.getBrightnessInnerRing());
+      json.key("brightnessOR").valuef("%u", ledrings.getBrightnessOuterRing());
     }
-    message += "}";
-    logger.logString(message);
-    server.send(200, "application/json", message);
+    json.endObject();
+    logger.logf(LOG_DEBUG, "%s", json.c_str());
+    server.send(200, "application/json", json.c_str());
   }
 }
 
 /**
- * @brief Convert Integer to String with leading zero
+ * @brief Write a 24bit color as JSON object with the members r, g and b
  * 
- * @param value 
- * @return String 
+ * @param json writer
+ * @param name key of the object
+ * @param color 24bit color
+ */
+void writeJsonColor(JsonWriter &json, const char *name, uint32_t color) {
+  json.beginObject(name);
+  json.member("r", (unsigned int)((color >> 16) & 0xFF));
+  json.member("g", (unsigned int)((color >> 8) & 0xFF));
+  json.member("b", (unsigned int)(color & 0xFF));
+  json.endObject();
+}
+
+/**
+ * @brief Handler for "/api/state" url, sends the complete state of the clock (settings, time, 
+ * NTP synchronisation and firmware) as one JSON document. The document is streamed in chunks 
+ * of JSON_CHUNK_SIZE bytes, so no String is allocated.
+ */
+void handleStateRequest() {
+  char buffer[JSON_CHUNK_SIZE];
+  JsonWriter json(buffer, sizeof(buffer), sendJsonChunk);
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+
+  json.beginObject();
+
+  json.beginObject("colors");
+  writeJsonColor(json, "hours", colorHours);
+  writeJsonColor(json, "minutes", colorMinutes);
+  writeJsonColor(json, "seconds", colorSeconds);
+  json.endObject();
+
+  json.beginObject("brightness");
+  json.member("innerRing", (unsigned int)ledrings.getBrightnessInnerRing());
+  json.member("outerRing", (unsigned int)ledrings.getBrightnessOuterRing());
+  json.endObject();
+
+  json.member("ledOff", ledOff);
+  json.beginObject("nightMode");
+  json.member("active", nightMode);
+  json.key("start").valuef("%02d:%02d", nightModeStartHour, nightModeStartMin);
+  json.key("end").valuef("%02d:%02d", nightModeEndHour, nightModeEndMin);
+  json.endObject();
+
+  json.beginObject("time");
+  json.member("epoch", ntp.getEpochTime());
+  json.key("local").valuef("%02d:%02d:%02d", ntp.getHours24(), ntp.getMinutes(), ntp.getSeconds());
+  json.member("utcOffset", ntp.getTimeOffset());
+  json.endObject();
+
+  json.beginObject("ntp");
+  json.member("health", ntpHealthName(ntp.getHealth()));
+  json.member("consecutiveFailures", (unsigned int)ntp.getConsecutiveFailures());
+  json.member("sinceSync", ntp.getTimeSinceSync());
+  json.member("offset", ntp.getLastOffset());
+  json.member("delay", ntp.getRoundTripDelay());
+  json.member("driftPpb", ntp.getDriftPpb());
+  json.endObject();
+
+  json.beginObject("power");
+  json.member("state", PowerManager::getStateName(power.getState()));
+  json.member("activeTime", power.getTimeInState(POWER_ACTIVE));
+  json.member("idleTime", power.getTimeInState(POWER_IDLE));
+  json.member("sleepTime", power.getTimeInState(POWER_SLEEP));
+  json.endObject();
+
+  json.beginObject("timesync");
+  json.member("mode", TimeBeacon::getModeName(timeBeacon.getMode()));
+  json.member("leader", timeBeacon.isLeader());
+  json.member("following", timeBeacon.isFollowing());
+  json.member("leaderId", (unsigned long)timeBeacon.getLeaderId());
+  json.endObject();
+
+  json.beginObject("fleet");
+  json.member("hostname", hostname.c_str());
+  json.key("id").valuef("%08lx", (unsigned long)ESP.getChipId());
+  json.member("group", fleet.getGroup());
+  json.endObject();
+
+  json.beginObject("firmware");
+  json.member("sketch", __FILE__);
+  json.member("build", __TIMESTAMP__);
+  json.member("sdk", ESP.getSdkVersion());
+  json.member("sketchSize", ESP.getSketchSize());
+  json.member("freeSketchSpace", ESP.getFreeSketchSpace());
+  json.key("chipId").valuef("%08lx", (unsigned long)ESP.getChipId());
+  json.member("uptime", millis() / 1000);
+  json.member("freeHeap", ESP.getFreeHeap());
+  json.member("resetReason", ESP.getResetInfoPtr()->reason);
+  json.endObject();
+
+  json.endObject();
+  json.flush();
+  server.sendContent("");
+}
+
+#if METRICS_ENABLED
+/**
+ * @brief Handler for "/metrics" url, sends the instrumentation in the Prometheus text format. 
+ * The response is streamed in chunks, so no large String is allocated.
+ */
+void handleMetricsRequest() {
+  char chunk[512];
+  size_t length = 0;
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain; version=0.0.4", "");
+  for(uint8_t line = 0; line < Metrics::getLineCount(); line++){
+    if(length + METRICS_LINE_MAX > sizeof(chunk)){
+      server.sendContent(chunk, length);
+      length = 0;
+    }
+    int lineLength = Metrics::formatLine(line, chunk + length, METRICS_LINE_MAX);
+    if(lineLength > 0){
+      length += lineLength < METRICS_LINE_MAX ? lineLength : METRICS_LINE_MAX - 1;
+    }
+  }
+  server.sendContent(chunk, length);
+  server.sendContent("");
+}
+#endif
+
+#if BENCHMARK_ENABLED
+/**
+ * @brief Handler for "/benchmark" url, runs the benchmarks of the hot paths (see benchmarks.h) 
+ * and sends the CPU cycles per operation as text table. The clock is blocked while the 
+ * benchmarks run, the rendering cases draw on the LED rings.
  */
-String leadingZero2Digit(int value){
-  String msg = "";
-  if(value < 10){
-    msg = "0";
+void handleBenchmarkRequest() {
+  char line[BENCHMARK_LINE_MAX];
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain", "");
+  Benchmarks::formatHeader("cycles", line, sizeof(line));
+  server.sendContent(line);
+  logger.logf(LOG_INFO, "Benchmark: %u cases with %u samples at %u MHz", Benchmarks::getCaseCount(), BENCHMARK_SAMPLES, ESP.getCpuFreqMHz());
+  if(!Benchmarks::run(readCycleCount, BENCHMARK_SAMPLES, sendBenchmarkResult)){
+    server.sendContent("not enough memory\n");
+    logger.logf(LOG_WARN, "Benchmark: not enough memory");
   }
-  msg += String(value);
-  return msg;
-}
\ No newline at end of file
+  server.sendContent("");
+}
+
+/**
+ * @brief Clock of the on-device benchmarks
+ * 
+ * @return uint32_t CPU cycles
+ */
+uint32_t readCycleCount() {
+  return ESP.getCycleCount();
+}
+
+/**
+ * @brief Send the result of one benchmark case to the client of "/benchmark" and log it
+ * 
+ * @param result result of the case
+ */
+void sendBenchmarkResult(const BenchmarkResult &result) {
+  char line[BENCHMARK_LINE_MAX];
+  Benchmarks::formatResult(result, line, sizeof(line));
+  server.sendContent(line);
+  line[strcspn(line, "\n")] = '\0';
+  logger.logf(LOG_INFO, "Benchmark: %s", line);
+}
+#endif
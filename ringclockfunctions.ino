@@ -6,81 +6,190 @@
 
 #include "constants.h"
 #define MILLIS_PER_MINUTE 60000
+#define SUBPIXEL_SHIFT 8                    // positions on the outer ring are calculated in 1/256 pixel
+
+static_assert(LEDRings::outerRingLedCount < 256, "subpixel math of showMinutes requires less than 256 LEDs on the outer ring");
+
+// subpixel position of the start of each minute on the outer ring
+static constexpr std::array<uint16_t, 60> minuteStartSubpixel = [](){
+    std::array<uint16_t, 60> table{};
+    for(uint32_t m = 0; m < 60; m++) {
+        table[m] = ((m * LEDRings::outerRingLedCount) << SUBPIXEL_SHIFT) / 60;
+    }
+    return table;
+}();
+
+// subpixels per millisecond of the seconds indicator, Q16 fixed point
+static constexpr uint32_t secondsSubpixelPerMilliQ16 = ((uint32_t)LEDRings::outerRingLedCount << (SUBPIXEL_SHIFT + 16)) / MILLIS_PER_MINUTE;
 
 
 /**
- * @brief Show the hour on the clock
+ * @brief Show the hour on the clock (hours layer)
  * 
  * @param hour hour to show
  * @param color color to use
  */
 void showHour(uint8_t hour, uint32_t color) {
-    // clear matrix
-    ledrings.flushInnerRing();
+    static int lastPixel = -1;
+    static uint32_t lastColor = 0;
+    static uint16_t lastFlushCount = 0;
 
     // convert 24h to 12h
     if(hour > 12) {
         hour -= 12;
     }
 
-    ledrings.setPixelInnerRing(hour-1, color);
-}
+    // only redraw the layer if the hour or the color changed
+    int pixel = hour - 1;
+    if(pixel == lastPixel && color == lastColor && ledrings.getFlushCountInnerRing(LAYER_HOURS) == lastFlushCount) {
+        return;
+    }
 
-void showMinutes(uint8_t minutes, uint32_t colorMinutes, uint32_t colorSeconds) {
+    // clear layer
+    ledrings.flushInnerRing(LAYER_HOURS);
+    ledrings.setPixelInnerRing(LAYER_HOURS, pixel, color);
 
-    static uint8_t lastMinutes = 0;
-    static uint32_t timeOfLastMinuteChange = 0;
-    static uint32_t black = LEDRings::Color24bit(0, 0, 0);
+    lastPixel = pixel;
+    lastColor = color;
+    lastFlushCount = ledrings.getFlushCountInnerRing(LAYER_HOURS);
+}
 
-    // check if minutes changed
-    if(minutes != lastMinutes) {
-        timeOfLastMinuteChange = millis();
-        lastMinutes = minutes;
-    }
+/**
+ * @brief Show the minutes bar (minutes layer) and the seconds indicator (seconds layer) on the clock.
+ * 
+ * Only the pixels which changed since the last call are written to the layers.
+ * 
+ * @param minutes minutes to show
+ * @param millisOfMinute milliseconds since the start of the minute (0-59999)
+ * @param colorMinutes color of the minutes bar
+ * @param colorSeconds color of the seconds indicator
+ */
+void showMinutes(uint8_t minutes, uint16_t millisOfMinute, uint32_t colorMinutes, uint32_t colorSeconds) {
 
-    // calculate time since last minute change
-    uint32_t timeSinceLastMinuteChange = millis() - timeOfLastMinuteChange;
+    static const uint32_t black = LEDRings::Color24bit(0, 0, 0);
 
-    // calculate seconds progress
-    float progressSeconds = (float)timeSinceLastMinuteChange / (float)MILLIS_PER_MINUTE;
-    int activePixelSeconds = (int)(progressSeconds * OUTER_RING_LED_COUNT);
-    float pixelProgressSeconds = progressSeconds * OUTER_RING_LED_COUNT - activePixelSeconds;
+    // state of the last rendered frame of both layers
+    static bool rendered = false;
+    static uint16_t lastFlushCountMinutes = 0;
+    static uint16_t lastFlushCountSeconds = 0;
+    static uint32_t lastColorMinutes = 0;
+    static uint32_t lastColorSeconds = 0;
+    static int lastPixelSeconds = 0;
+    static int lastPixelMinutes = 0;
 
-    // calculate minutes progress
-    float minutesContinuous = (float)minutes + progressSeconds;
-    float progressMinutes = (float)minutesContinuous / 60.0;
-    int activePixelMinutes = (int)(progressMinutes * OUTER_RING_LED_COUNT);
-    float pixelProgressMinutes = progressMinutes * OUTER_RING_LED_COUNT - activePixelMinutes;
+    minutes = minutes % 60;
+    if(millisOfMinute >= MILLIS_PER_MINUTE) {
+        millisOfMinute = MILLIS_PER_MINUTE - 1;
+    }
 
-    // clear led ring
-    ledrings.flushOuterRing();
+    // subpixel positions of seconds and minutes indicator (integer math only)
+    uint16_t subpixelSeconds = ((uint32_t)millisOfMinute * secondsSubpixelPerMilliQ16) >> 16;
+    uint16_t subpixelMinutes = minuteStartSubpixel[minutes] + subpixelSeconds / 60;
+    int activePixelSeconds = subpixelSeconds >> SUBPIXEL_SHIFT;
+    int activePixelMinutes = subpixelMinutes >> SUBPIXEL_SHIFT;
+    uint16_t weightSeconds = subpixelSeconds & (BLEND_WEIGHT_MAX - 1);
+    uint16_t weightMinutes = subpixelMinutes & (BLEND_WEIGHT_MAX - 1);
 
-    for(int i = 0; i < OUTER_RING_LED_COUNT; i++) {
+    // minutes layer: bar up to the current minute with anti-aliased end
+    if(!rendered || colorMinutes != lastColorMinutes || ledrings.getFlushCountOuterRing(LAYER_MINUTES) != lastFlushCountMinutes) {
+        ledrings.fillPixelsOuterRing(LAYER_MINUTES, 0, activePixelMinutes, colorMinutes);
+        ledrings.fillPixelsOuterRing(LAYER_MINUTES, activePixelMinutes, LEDRings::outerRingLedCount - activePixelMinutes, black);
+    }
+    else if(activePixelMinutes > lastPixelMinutes) {
+        // minutes bar has grown
+        ledrings.fillPixelsOuterRing(LAYER_MINUTES, lastPixelMinutes, activePixelMinutes - lastPixelMinutes, colorMinutes);
+    }
+    else if(activePixelMinutes < lastPixelMinutes) {
+        // minutes bar restarted with a new hour
+        ledrings.fillPixelsOuterRing(LAYER_MINUTES, activePixelMinutes, lastPixelMinutes - activePixelMinutes + 1, black);
+    }
+    ledrings.setPixelOuterRing(LAYER_MINUTES, activePixelMinutes, LEDRings::blendColor24bit(black, colorMinutes, weightMinutes));
 
-        if(i == activePixelSeconds - 1){
-            uint32_t color = LEDRings::interpolateColor24bit(black, colorSeconds, (1 - pixelProgressSeconds));
-            ledrings.setPixelOuterRing(i, color);
-        }
-        else if(i == activePixelSeconds){
-            uint32_t color = LEDRings::interpolateColor24bit(black, colorSeconds, pixelProgressSeconds);
-            ledrings.setPixelOuterRing(i, color);
+    // seconds layer: two anti-aliased pixels
+    if(!rendered || colorSeconds != lastColorSeconds || ledrings.getFlushCountOuterRing(LAYER_SECONDS) != lastFlushCountSeconds) {
+        ledrings.flushOuterRing(LAYER_SECONDS);
+    }
+    else if(activePixelSeconds != lastPixelSeconds) {
+        // remove previous seconds indicator
+        if(lastPixelSeconds > 0) {
+            ledrings.fillPixelsOuterRing(LAYER_SECONDS, lastPixelSeconds - 1, 2, black);
         }
         else {
-            if(i < activePixelMinutes) {
-                ledrings.setPixelOuterRing(i, colorMinutes);
-            }
-            else if(i == activePixelMinutes) {
-                uint32_t color = LEDRings::interpolateColor24bit(black, colorMinutes, pixelProgressMinutes);
-                ledrings.setPixelOuterRing(i, color);
-            }
-            else {
-                ledrings.setPixelOuterRing(i, black);
-            }
+            ledrings.setPixelOuterRing(LAYER_SECONDS, 0, black);
         }
     }
+    uint32_t colorSecondsCurrent = LEDRings::blendColor24bit(black, colorSeconds, weightSeconds);
+    if(activePixelSeconds > 0) {
+        uint32_t colors[2] = {LEDRings::blendColor24bit(black, colorSeconds, BLEND_WEIGHT_MAX - weightSeconds), colorSecondsCurrent};
+        ledrings.writePixelsOuterRing(LAYER_SECONDS, activePixelSeconds - 1, colors, 2);
+    }
+    else {
+        ledrings.setPixelOuterRing(LAYER_SECONDS, 0, colorSecondsCurrent);
+    }
+
+    rendered = true;
+    lastFlushCountMinutes = ledrings.getFlushCountOuterRing(LAYER_MINUTES);
+    lastFlushCountSeconds = ledrings.getFlushCountOuterRing(LAYER_SECONDS);
+    lastColorMinutes = colorMinutes;
+    lastColorSeconds = colorSeconds;
+    lastPixelSeconds = activePixelSeconds;
+    lastPixelMinutes = activePixelMinutes;
+}
+
+/**
+ * @brief Calculate the period until the clock face changes visibly. The anti-aliased 
+ * seconds indicator passes one pixel in MILLIS_PER_MINUTE/outerRingLedCount and shows 
+ * one output level step per (pixel time / output levels); the minutes bar moves 60x slower.
+ * A frame is due when the faster one advanced FRAME_MAX_LEVEL_STEP output levels.
+ * 
+ * @param colorMinutes color of the minutes bar
+ * @param colorSeconds color of the seconds indicator
+ * @return uint32_t frame period in milliseconds (PERIOD_LED_UPDATE - PERIOD_FRAME_MAX)
+ */
+uint32_t calcClockFramePeriod(uint32_t colorMinutes, uint32_t colorSeconds) {
+    const uint32_t millisPerStep = MILLIS_PER_MINUTE / LEDRings::outerRingLedCount * FRAME_MAX_LEVEL_STEP;
+    uint32_t period = PERIOD_FRAME_MAX;
+
+    uint16_t levelsSeconds = ledrings.getOutputLevelsOuterRing(colorSeconds);
+    if(levelsSeconds > 0 && millisPerStep / levelsSeconds < period) {
+        period = millisPerStep / levelsSeconds;
+    }
+    uint16_t levelsMinutes = ledrings.getOutputLevelsOuterRing(colorMinutes);
+    if(levelsMinutes > 0 && millisPerStep * 60 / levelsMinutes < period) {
+        period = millisPerStep * 60 / levelsMinutes;
+    }
+
+    if(period < PERIOD_LED_UPDATE) {
+        period = PERIOD_LED_UPDATE;
+    }
+    return period;
+}
+
+/**
+ * @brief Show a digit (1-12) on the overlay layer of the inner ring
+ * 
+ * @param digit digit to show
+ * @param color color to use
+ */
+void showDigitOnOverlay(uint8_t digit, uint32_t color) {
+    ledrings.flushInnerRing(LAYER_OVERLAY);
+    ledrings.setPixelInnerRing(LAYER_OVERLAY, digit - 1, color);
+}
+
+/**
+ * @brief Show a progress bar on the overlay layer of the outer ring
+ * 
+ * @param percent progress (0-100)
+ * @param color color to use
+ */
+void showProgressOnOverlay(uint8_t percent, uint32_t color) {
+    uint16_t count = (uint32_t)LEDRings::outerRingLedCount * (percent > 100 ? 100 : percent) / 100;
+    ledrings.flushOuterRing(LAYER_OVERLAY);
+    ledrings.fillPixelsOuterRing(LAYER_OVERLAY, 0, count, color);
 }
 
-void showTimeOnClock(uint8_t hour, uint8_t minutes, uint32_t colorHours, uint32_t colorMinutes, uint32_t colorSeconds) {
+void showTimeOnClock(uint8_t hour, uint8_t minutes, uint16_t millisOfMinute, uint32_t colorHours, uint32_t colorMinutes, uint32_t colorSeconds) {
+    METRIC_SCOPE(METRIC_SHOW_TIME);
     showHour(hour, colorHours);
-    showMinutes(minutes, colorMinutes, colorSeconds);
+    showMinutes(minutes, millisOfMinute, colorMinutes, colorSeconds);
 }
\ No newline at end of file
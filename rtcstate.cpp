@@ -0,0 +1,125 @@
+#include "rtcstate.h"
+#include <coredecls.h>
+
+extern "C" {
+#include <user_interface.h>
+}
+
+static_assert(sizeof(RTCStateData) % 4 == 0, "RTCStateData has to be a multiple of 4 bytes");
+static_assert(RTC_STATE_OFFSET * 4 + sizeof(RTCStateData) <= 512, "RTCStateData does not fit into the RTC user memory");
+
+/**
+ * @brief Load the snapshot of the last run, call once at boot
+ * 
+ * @return true valid snapshot of the time before the reset
+ * @return false no snapshot (e.g. after power on)
+ */
+bool RTCState::load(){
+    _valid = false;
+    _restartCount = 0;
+    if(!ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, (uint32_t*)&_data, sizeof(_data))){
+        return false;
+    }
+    if(_data.magic != RTC_STATE_MAGIC || _data.version != RTC_STATE_VERSION 
+        || _data.crc != crc32(&_data, offsetof(RTCStateData, crc))){
+        return false;
+    }
+    _restartCount = _data.restartCount + 1;
+
+    // the unsigned difference of the ticks is correct across the wrap of the RTC timer (every few hours), 
+    // after the reset pin (timer restarts at 0) it gives an age far above RTC_STATE_MAX_AGE
+    _age = calcAge(system_get_rtc_time(), system_rtc_clock_cali_proc());
+    _valid = _age <= RTC_STATE_MAX_AGE;
+    return _valid;
+}
+
+/**
+ * @brief Write a snapshot of the current time base and display mode
+ * 
+ * @param utcEpochMillis current time (UTC epoch ms)
+ * @param driftPpb estimated drift of the oscillator (ppb)
+ * @param timeSinceSync time since the last NTP sync (ms)
+ * @param flags display mode (RTC_FLAG_*)
+ * @param fleetTimestamp replay protection of the fleet configuration
+ */
+void RTCState::save(uint64_t utcEpochMillis, long driftPpb, unsigned long timeSinceSync, uint8_t flags, uint64_t fleetTimestamp){
+    RTCStateData data = {};
+    data.magic = RTC_STATE_MAGIC;
+    data.version = RTC_STATE_VERSION;
+    data.flags = flags;
+    data.restartCount = _restartCount;
+    data.rtcTime = system_get_rtc_time();
+    data.rtcCali = system_rtc_clock_cali_proc();
+    data.utcEpochMillis = utcEpochMillis;
+    data.driftPpb = driftPpb;
+    data.timeSinceSync = timeSinceSync;
+    data.fleetTimestamp = fleetTimestamp;
+    data.crc = crc32(&data, offsetof(RTCStateData, crc));
+    ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, (uint32_t*)&data, sizeof(data));
+}
+
+/**
+ * @brief Delete the snapshot, e.g. if the time is not valid
+ * 
+ */
+void RTCState::invalidate(){
+    uint32_t magic = 0;
+    ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, &magic, sizeof(magic));
+    _valid = false;
+}
+
+bool RTCState::isValid() const{
+    return _valid;
+}
+
+/**
+ * @brief Get the current time: time of the snapshot plus the elapsed time since then
+ * 
+ * @return uint64_t time (UTC epoch ms) at load()
+ */
+uint64_t RTCState::getUTCEpochMillis() const{
+    return _data.utcEpochMillis + _age;
+}
+
+long RTCState::getDriftPpb() const{
+    return _data.driftPpb;
+}
+
+unsigned long RTCState::getTimeSinceSync() const{
+    return _data.timeSinceSync + _age;
+}
+
+uint8_t RTCState::getFlags() const{
+    return _data.flags;
+}
+
+uint64_t RTCState::getFleetTimestamp() const{
+    return _data.fleetTimestamp;
+}
+
+/**
+ * @brief Get the number of restarts since power on (resets with a valid snapshot)
+ * 
+ */
+uint16_t RTCState::getRestartCount() const{
+    return _restartCount;
+}
+
+/**
+ * @brief Get the time between the snapshot and load()
+ * 
+ * @return uint32_t age in ms
+ */
+uint32_t RTCState::getAge() const{
+    return _age;
+}
+
+/**
+ * @brief (private) Elapsed time since the snapshot, the tick length is the mean of both calibrations
+ * 
+ */
+uint32_t RTCState::calcAge(uint32_t rtcTime, uint32_t rtcCali) const{
+    uint64_t cali = ((uint64_t)rtcCali + _data.rtcCali) / 2;
+    uint64_t elapsedUs = ((uint64_t)(rtcTime - _data.rtcTime) * cali) >> 12;
+    return elapsedUs / 1000;
+}
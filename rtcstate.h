@@ -0,0 +1,68 @@
+/**
+ * @file rtcstate.h
+ * @brief Snapshot of the time base and the display mode in the RTC user memory
+ * 
+ * The RTC user memory keeps its content across software, watchdog and exception resets 
+ * (not on power loss). The snapshot is written every PERIOD_RTC_SNAPSHOT ms and right 
+ * before a planned restart. Together with the RTC timer, which also keeps running across 
+ * these resets, the time at boot is the snapshot time plus the elapsed RTC time. 
+ * The snapshot is CRC32 checked, so garbage after power on is never used.
+ */
+
+#ifndef rtcstate_h
+#define rtcstate_h
+
+#include <Arduino.h>
+
+#define RTC_STATE_MAGIC 0x52544353          // "RTCS"
+#define RTC_STATE_VERSION 2
+#define RTC_STATE_OFFSET 32                 // in 4 byte blocks, the first 128 bytes of the RTC user memory are used by eboot for OTA
+#define RTC_STATE_MAX_AGE 120000            // snapshots older than this (ms) are not used
+
+// display mode
+#define RTC_FLAG_LED_OFF 0x01
+#define RTC_FLAG_NIGHTMODE 0x02
+
+/**
+ * @brief Content of the RTC user memory
+ * 
+ */
+struct __attribute__((packed, aligned(4))) RTCStateData {
+    uint32_t magic;             // RTC_STATE_MAGIC
+    uint8_t version;            // RTC_STATE_VERSION
+    uint8_t flags;              // RTC_FLAG_*
+    uint16_t restartCount;      // restarts since power on
+    uint32_t rtcTime;           // RTC timer (ticks) at the snapshot
+    uint32_t rtcCali;           // length of one RTC tick (µs, Q12 fixed point)
+    uint64_t utcEpochMillis;    // time (UTC epoch ms) at the snapshot
+    int32_t driftPpb;           // estimated drift of the oscillator
+    uint32_t timeSinceSync;     // time since the last NTP sync (ms) at the snapshot
+    uint64_t fleetTimestamp;    // replay protection of the fleet configuration (see Fleet::getReplayFloor())
+    uint32_t crc;               // CRC32 of all previous bytes
+};
+
+class RTCState{
+
+    public:
+        bool load();
+        void save(uint64_t utcEpochMillis, long driftPpb, unsigned long timeSinceSync, uint8_t flags, uint64_t fleetTimestamp);
+        void invalidate();
+        bool isValid() const;
+        uint64_t getUTCEpochMillis() const;
+        long getDriftPpb() const;
+        unsigned long getTimeSinceSync() const;
+        uint8_t getFlags() const;
+        uint64_t getFleetTimestamp() const;
+        uint16_t getRestartCount() const;
+        uint32_t getAge() const;
+
+    private:
+        uint32_t calcAge(uint32_t rtcTime, uint32_t rtcCali) const;
+
+        RTCStateData _data = {};
+        bool _valid = false;
+        uint32_t _age = 0;              // time between snapshot and load() (ms)
+        uint16_t _restartCount = 0;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "scheduler.h"
+
+/**
+ * @brief Construct a new Scheduler with an empty task table
+ * 
+ */
+Scheduler::Scheduler(){
+    _taskCount = 0;
+    _rejectedCount = 0;
+    _rejectedTask = nullptr;
+    _statsStart = millis();
+    _idleTime = 0;
+}
+
+/**
+ * @brief Register a new task
+ * 
+ * @param name name of the task (used for statistics)
+ * @param function function to execute
+ * @param period period in milliseconds (values < 1 are set to 1)
+ * @param priority priority of the task, higher value runs first if several tasks are due
+ * @param firstRunDelay delay of the first execution in milliseconds
+ * @return int8_t id of the task, -1 if the task table is full (see getRejectedCount())
+ */
+int8_t Scheduler::addTask(const char *name, TaskFunction function, uint32_t period, uint8_t priority, uint32_t firstRunDelay){
+    if(_taskCount >= SCHEDULER_MAX_TASKS){
+        if(_rejectedCount == 0) _rejectedTask = name;
+        if(_rejectedCount < UINT8_MAX) _rejectedCount++;
+        return -1;
+    }
+    Task &task = _tasks[_taskCount];
+    task.name = name;
+    task.function = function;
+    task.period = period > 0 ? period : 1;
+    task.priority = priority;
+    task.nextRun = millis() + firstRunDelay;
+    task.enabled = true;
+    task.stats = {0, 0, 0, 0, 0, 0};
+    return _taskCount++;
+}
+
+/**
+ * @brief Change the period of a task (takes effect after the next execution)
+ * 
+ * @param taskId id of the task
+ * @param period period in milliseconds
+ */
+void Scheduler::setPeriod(int8_t taskId, uint32_t period){
+    if(taskId < 0 || taskId >= _taskCount) return;
+    _tasks[taskId].period = period > 0 ? period : 1;
+}
+
+/**
+ * @brief Set the next execution of a task relative to now. Can be called from within 
+ * the task itself to override the next deadline (e.g. for retries or adaptive periods).
+ * 
+ * @param taskId id of the task
+ * @param delayMillis delay of the next execution in milliseconds
+ */
+void Scheduler::setNextRun(int8_t taskId, uint32_t delayMillis){
+    if(taskId < 0 || taskId >= _taskCount) return;
+    _tasks[taskId].nextRun = millis() + delayMillis;
+}
+
+/**
+ * @brief Make a task due immediately
+ * 
+ * @param taskId id of the task
+ */
+void Scheduler::runTaskNow(int8_t taskId){
+    setNextRun(taskId, 0);
+}
+
+/**
+ * @brief Enable or disable a task
+ * 
+ * @param taskId id of the task
+ * @param enabled true to enable the task
+ */
+void Scheduler::setEnabled(int8_t taskId, bool enabled){
+    if(taskId < 0 || taskId >= _taskCount) return;
+    _tasks[taskId].enabled = enabled;
+}
+
+/**
+ * @brief Execute all due tasks. Should be called in every loop() iteration.
+ * 
+ */
+void Scheduler::run(){
+    uint32_t sliceStart = millis();
+    while(true){
+        int8_t taskId = findDueTask(millis());
+        if(taskId < 0){
+            break;
+        }
+        runTask(taskId);
+        // let the WiFi stack run between two tasks
+        yield();
+        if(millis() - sliceStart >= SCHEDULER_SLICE_MAX){
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Sleep until the next task is due
+ * 
+ * @param maxIdle maximum sleep time in milliseconds
+ */
+void Scheduler::idle(uint32_t maxIdle){
+    uint32_t idleTime = getTimeUntilNextTask();
+    if(idleTime > maxIdle){
+        idleTime = maxIdle;
+    }
+    if(idleTime > 0){
+        delay(idleTime);
+        _idleTime += idleTime;
+    }
+}
+
+/**
+ * @brief Get the time until the next task is due
+ * 
+ * @return uint32_t time in milliseconds (0 if a task is due)
+ */
+uint32_t Scheduler::getTimeUntilNextTask(){
+    uint32_t now = millis();
+    uint32_t minTime = UINT32_MAX;
+    for(uint8_t i = 0; i < _taskCount; i++){
+        if(!_tasks[i].enabled) continue;
+        int32_t remaining = (int32_t)(_tasks[i].nextRun - now);
+        if(remaining <= 0){
+            return 0;
+        }
+        if((uint32_t)remaining < minTime){
+            minTime = remaining;
+        }
+    }
+    return minTime;
+}
+
+/**
+ * @brief Get the number of registered tasks
+ * 
+ * @return uint8_t number of tasks
+ */
+uint8_t Scheduler::getTaskCount(){
+    return _taskCount;
+}
+
+/**
+ * @brief Get the number of tasks which were not registered because the task table was full
+ * 
+ * @return uint8_t number of rejected tasks, 0 if all tasks were registered
+ */
+uint8_t Scheduler::getRejectedCount(){
+    return _rejectedCount;
+}
+
+/**
+ * @brief Get the name of the first task which was not registered because the task table was full
+ * 
+ * @return const char* name of the task, nullptr if all tasks were registered
+ */
+const char *Scheduler::getRejectedTask(){
+    return _rejectedTask;
+}
+
+/**
+ * @brief Get a task of the task table (for statistics)
+ * 
+ * @param taskId id of the task
+ * @return const Task* task, nullptr if the id is invalid
+ */
+const Task *Scheduler::getTask(int8_t taskId){
+    if(taskId < 0 || taskId >= _taskCount) return nullptr;
+    return &_tasks[taskId];
+}
+
+/**
+ * @brief Get the time since the last reset of the statistics
+ * 
+ * @return uint32_t time in milliseconds
+ */
+uint32_t Scheduler::getStatsDuration(){
+    return millis() - _statsStart;
+}
+
+/**
+ * @brief Get the time spent in idle() since the last reset of the statistics
+ * 
+ * @return uint32_t time in milliseconds
+ */
+uint32_t Scheduler::getIdleTime(){
+    return _idleTime;
+}
+
+/**
+ * @brief Reset the statistics of all tasks
+ * 
+ */
+void Scheduler::resetStats(){
+    for(uint8_t i = 0; i < _taskCount; i++){
+        _tasks[i].stats = {0, 0, 0, 0, 0, 0};
+    }
+    _statsStart = millis();
+    _idleTime = 0;
+}
+
+/**
+ * @brief Find the due task with the highest priority (earliest deadline among equal priorities)
+ * 
+ * @param now current time (millis)
+ * @return int8_t id of the task, -1 if no task is due
+ */
+int8_t Scheduler::findDueTask(uint32_t now){
+    int8_t best = -1;
+    for(uint8_t i = 0; i < _taskCount; i++){
+        Task &task = _tasks[i];
+        if(!task.enabled || (int32_t)(now - task.nextRun) < 0) continue;
+        if(best < 0 
+            || task.priority > _tasks[best].priority 
+            || (task.priority == _tasks[best].priority && (int32_t)(task.nextRun - _tasks[best].nextRun) < 0)){
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Execute a task, compute its next deadline and update its statistics
+ * 
+ * @param taskId id of the task
+ */
+void Scheduler::runTask(int8_t taskId){
+    Task &task = _tasks[taskId];
+    uint32_t now = millis();
+    uint32_t jitter = now - task.nextRun;
+
+    // next deadline, missed periods are skipped
+    bool missedPeriod = jitter >= task.period;
+    task.nextRun += task.period;
+    if(missedPeriod){
+        task.nextRun = now + task.period;
+    }
+
+    uint32_t start = micros();
+    task.function();
+    uint32_t duration = micros() - start;
+
+    task.stats.runs++;
+    if(missedPeriod || duration > task.period * 1000){
+        task.stats.overruns++;
+    }
+    task.stats.totalJitter += jitter;
+    if(jitter > task.stats.maxJitter){
+        task.stats.maxJitter = jitter;
+    }
+    task.stats.totalDuration += duration;
+    if(duration > task.stats.maxDuration){
+        task.stats.maxDuration = duration;
+    }
+}
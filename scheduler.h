@@ -0,0 +1,88 @@
+/**
+ * @file scheduler.h
+ * @brief Cooperative task scheduler for the periodic jobs of loop()
+ * 
+ * Tasks are registered with a period and a priority. Scheduler::run() executes 
+ * the due tasks one after another, the task with the highest priority first and 
+ * among equal priorities the one with the earliest deadline. Between two tasks 
+ * yield() is called, and run() returns after SCHEDULER_SLICE_MAX milliseconds 
+ * so the WiFi stack is never starved. All times use unsigned millis() arithmetic 
+ * and are safe against the overflow of millis().
+ * 
+ * For each task the scheduler records runs, overruns (deadline missed by a full 
+ * period or execution took longer than the period), jitter (start delay after the 
+ * deadline) and execution time, so the task eating the loop budget can be found.
+ */
+
+#ifndef scheduler_h
+#define scheduler_h
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 20          // maximum number of tasks (16 used by the sketch)
+#define SCHEDULER_SLICE_MAX 20          // maximum time (ms) of one run() before returning to the core
+
+typedef void (*TaskFunction)();
+
+/**
+ * @brief Runtime statistics of a task (since last resetStats())
+ * 
+ */
+struct TaskStats{
+    uint32_t runs;                      // number of executions
+    uint32_t overruns;                  // executions which missed a full period or took longer than the period
+    uint32_t maxJitter;                 // maximum start delay after the deadline (ms)
+    uint32_t totalJitter;               // sum of start delays (ms)
+    uint32_t maxDuration;               // maximum execution time (µs)
+    uint32_t totalDuration;             // sum of execution times (µs)
+};
+
+/**
+ * @brief Entry of the task table
+ * 
+ */
+struct Task{
+    const char *name;
+    TaskFunction function;
+    uint32_t period;                    // period in ms (>= 1)
+    uint8_t priority;                   // higher value runs first
+    uint32_t nextRun;                   // deadline of next execution (millis)
+    bool enabled;
+    TaskStats stats;
+};
+
+class Scheduler{
+
+    public:
+        Scheduler();
+        int8_t addTask(const char *name, TaskFunction function, uint32_t period, uint8_t priority, uint32_t firstRunDelay = 0);
+        void setPeriod(int8_t taskId, uint32_t period);
+        void setNextRun(int8_t taskId, uint32_t delayMillis);
+        void runTaskNow(int8_t taskId);
+        void setEnabled(int8_t taskId, bool enabled);
+
+        void run();
+        void idle(uint32_t maxIdle);
+        uint32_t getTimeUntilNextTask();
+
+        uint8_t getTaskCount();
+        uint8_t getRejectedCount();
+        const char *getRejectedTask();
+        const Task *getTask(int8_t taskId);
+        uint32_t getStatsDuration();
+        uint32_t getIdleTime();
+        void resetStats();
+
+    private:
+        Task _tasks[SCHEDULER_MAX_TASKS];
+        uint8_t _taskCount;
+        uint8_t _rejectedCount;         // number of addTask() calls with a full task table
+        const char *_rejectedTask;      // name of the first rejected task
+        uint32_t _statsStart;           // millis of last resetStats()
+        uint32_t _idleTime;             // time spent in idle() since last resetStats() (ms)
+
+        int8_t findDueTask(uint32_t now);
+        void runTask(int8_t taskId);
+};
+
+#endif
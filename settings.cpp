@@ -0,0 +1,310 @@
+#include "settings.h"
+#include <coredecls.h>
+#include <spi_flash.h>
+#include "timebeacon.h"
+#include "fleet.h"
+
+// address map of the old EEPROM layout (firmware before the settings records), only used for the migration
+#define LEGACY_ADR_NM_START_H 0
+#define LEGACY_ADR_NM_END_H 4
+#define LEGACY_ADR_NM_START_M 8
+#define LEGACY_ADR_NM_END_M 12
+#define LEGACY_ADR_BRIGHTNESS_OUTER 16
+#define LEGACY_ADR_BRIGHTNESS_INNER 17
+#define LEGACY_ADR_CS_RED 18
+#define LEGACY_ADR_CM_RED 21
+#define LEGACY_ADR_CH_RED 24
+#define LEGACY_SIZE 28
+
+// start of the EEPROM sector, defined by the linker script
+extern "C" uint32_t _EEPROM_start;
+
+/**
+ * @brief Construct a new Settings object with default values
+ * 
+ */
+Settings::Settings(){
+    memset(&_data, 0, sizeof(_data));
+    for(uint8_t color = 0; color < SETTINGS_COLOR_COUNT; color++){
+        _data.colors[color][0] = 200;
+        _data.colors[color][1] = 200;
+    }
+    _data.nightModeStartHour = 22;
+    _data.nightModeEndHour = 7;
+    _data.brightnessInner = 255;
+    _data.brightnessOuter = 255;
+    _committed = _data;
+}
+
+/**
+ * @brief Load the newest valid record from flash, or migrate the old EEPROM layout if there is none
+ * 
+ * @return SettingsSource where the settings are loaded from
+ */
+SettingsSource Settings::begin(){
+    SettingsRecord record;
+    bool found = false;
+    _nextSlot = SETTINGS_SLOT_COUNT;
+    for(uint16_t slot = 0; slot < SETTINGS_SLOT_COUNT; slot++){
+        if(!readSlot(slot, record)) continue;
+        if(record.magic == 0xFFFF && record.sequence == 0xFFFFFFFF){
+            // erased slot, everything behind is unused as the slots are written in order
+            _nextSlot = slot;
+            break;
+        }
+        if(isValid(record) && (!found || record.sequence > _sequence)){
+            found = true;
+            _sequence = record.sequence;
+            // fields unknown to the writing firmware keep their defaults
+            memcpy(&_data, &record.data, record.dataSize < sizeof(_data) ? record.dataSize : sizeof(_data));
+        }
+    }
+
+    if(!found){
+        loadLegacy();
+        sanitize();
+        // the old layout overlaps the slots, start with an erased sector
+        _nextSlot = SETTINGS_SLOT_COUNT;
+        commit();
+        return SETTINGS_SOURCE_MIGRATED;
+    }
+    sanitize();
+    _committed = _data;
+    _hasRecord = true;
+    return SETTINGS_SOURCE_FLASH;
+}
+
+/**
+ * @brief Commit the changes when the debounce time has passed, has to be called periodically
+ * 
+ * @return true nothing to do or settings are stored in flash
+ * @return false writing to flash failed (retried later)
+ */
+bool Settings::loop(){
+    if(!_dirty) return true;
+    unsigned long now = millis();
+    if(now - _lastChange >= SETTINGS_COMMIT_DELAY || now - _firstChange >= SETTINGS_COMMIT_DELAY_MAX){
+        return commit();
+    }
+    return true;
+}
+
+/**
+ * @brief Write the working copy to the next slot immediately (e.g. before a restart), 
+ * nothing is written if it equals the newest record
+ * 
+ * @return true settings are stored in flash
+ * @return false writing to flash failed, the changes stay marked and loop() retries after SETTINGS_COMMIT_DELAY
+ */
+bool Settings::commit(){
+    if(!_hasRecord || memcmp(&_data, &_committed, sizeof(_data)) != 0){
+        if(!writeRecord()){
+            _dirty = true;
+            _firstChange = millis();
+            _lastChange = _firstChange;
+            return false;
+        }
+    }
+    _dirty = false;
+    return true;
+}
+
+/**
+ * @brief (private) Append the working copy as new record, erase the sector first if all slots are used
+ * 
+ * @return true record is written
+ * @return false erasing or writing the flash failed
+ */
+bool Settings::writeRecord(){
+    if(_nextSlot >= SETTINGS_SLOT_COUNT){
+        if(!ESP.flashEraseSector(sectorAddress() / SPI_FLASH_SEC_SIZE)) return false;
+        _nextSlot = 0;
+    }
+
+    SettingsRecord record;
+    memset(&record, 0, sizeof(record));
+    record.magic = SETTINGS_MAGIC;
+    record.version = SETTINGS_VERSION;
+    record.dataSize = sizeof(SettingsData);
+    record.sequence = _sequence + 1;
+    record.data = _data;
+    record.crc = crc32(&record, offsetof(SettingsRecord, crc));
+
+    // a failed (or interrupted) write leaves an invalid record, the slot is skipped
+    bool written = ESP.flashWrite(sectorAddress() + _nextSlot * SETTINGS_RECORD_SIZE, (uint32_t*)&record, sizeof(record));
+    _nextSlot++;
+    if(!written) return false;
+    _sequence = record.sequence;
+    _committed = _data;
+    _hasRecord = true;
+    _commitCount++;
+    return true;
+}
+
+/**
+ * @brief Check if there are changes not committed to flash yet
+ * 
+ */
+bool Settings::isDirty() const{
+    return _dirty;
+}
+
+/**
+ * @brief Get the number of flash writes since begin()
+ * 
+ */
+uint32_t Settings::getCommitCount() const{
+    return _commitCount;
+}
+
+/**
+ * @brief Get a color as 24bit value
+ * 
+ * @param color which color
+ * @return uint32_t 24bit color
+ */
+uint32_t Settings::getColor(SettingsColor color) const{
+    const uint8_t* rgb = _data.colors[color];
+    return ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+}
+
+void Settings::setColor(SettingsColor color, uint8_t red, uint8_t green, uint8_t blue){
+    uint8_t* rgb = _data.colors[color];
+    if(rgb[0] == red && rgb[1] == green && rgb[2] == blue) return;
+    rgb[0] = red;
+    rgb[1] = green;
+    rgb[2] = blue;
+    markChanged();
+}
+
+void Settings::getNightMode(uint8_t &startHour, uint8_t &startMin, uint8_t &endHour, uint8_t &endMin) const{
+    startHour = _data.nightModeStartHour;
+    startMin = _data.nightModeStartMin;
+    endHour = _data.nightModeEndHour;
+    endMin = _data.nightModeEndMin;
+}
+
+void Settings::setNightMode(uint8_t startHour, uint8_t startMin, uint8_t endHour, uint8_t endMin){
+    if(startHour == _data.nightModeStartHour && startMin == _data.nightModeStartMin 
+        && endHour == _data.nightModeEndHour && endMin == _data.nightModeEndMin) return;
+    _data.nightModeStartHour = startHour;
+    _data.nightModeStartMin = startMin;
+    _data.nightModeEndHour = endHour;
+    _data.nightModeEndMin = endMin;
+    markChanged();
+}
+
+uint8_t Settings::getBrightnessInner() const{
+    return _data.brightnessInner;
+}
+
+uint8_t Settings::getBrightnessOuter() const{
+    return _data.brightnessOuter;
+}
+
+void Settings::setBrightness(uint8_t inner, uint8_t outer){
+    if(inner == _data.brightnessInner && outer == _data.brightnessOuter) return;
+    _data.brightnessInner = inner;
+    _data.brightnessOuter = outer;
+    markChanged();
+}
+
+uint8_t Settings::getTimeSyncMode() const{
+    return _data.timeSyncMode;
+}
+
+void Settings::setTimeSyncMode(uint8_t mode){
+    if(mode == _data.timeSyncMode) return;
+    _data.timeSyncMode = mode;
+    markChanged();
+}
+
+uint8_t Settings::getFleetGroup() const{
+    return _data.fleetGroup;
+}
+
+void Settings::setFleetGroup(uint8_t group){
+    if(group == _data.fleetGroup) return;
+    _data.fleetGroup = group;
+    markChanged();
+}
+
+/**
+ * @brief (private) Get the flash address of the EEPROM sector
+ * 
+ */
+uint32_t Settings::sectorAddress() const{
+    return (uint32_t)(uintptr_t)&_EEPROM_start - 0x40200000;
+}
+
+/**
+ * @brief (private) Read one slot from flash
+ * 
+ */
+bool Settings::readSlot(uint16_t slot, SettingsRecord &record) const{
+    return ESP.flashRead(sectorAddress() + slot * SETTINGS_RECORD_SIZE, (uint32_t*)&record, sizeof(record));
+}
+
+/**
+ * @brief (private) Check magic and CRC32 of a record
+ * 
+ */
+bool Settings::isValid(const SettingsRecord &record) const{
+    return record.magic == SETTINGS_MAGIC && record.version >= 1 
+        && record.crc == crc32(&record, offsetof(SettingsRecord, crc));
+}
+
+/**
+ * @brief (private) Read the settings from the old fixed EEPROM address map
+ * 
+ */
+void Settings::loadLegacy(){
+    uint32_t words[(LEGACY_SIZE + 3) / 4];
+    if(!ESP.flashRead(sectorAddress(), words, sizeof(words))) return;
+    const uint8_t* legacy = (const uint8_t*)words;
+    memcpy(_data.colors[SETTINGS_COLOR_HOURS], legacy + LEGACY_ADR_CH_RED, 3);
+    memcpy(_data.colors[SETTINGS_COLOR_MINUTES], legacy + LEGACY_ADR_CM_RED, 3);
+    memcpy(_data.colors[SETTINGS_COLOR_SECONDS], legacy + LEGACY_ADR_CS_RED, 3);
+    _data.nightModeStartHour = legacy[LEGACY_ADR_NM_START_H];
+    _data.nightModeStartMin = legacy[LEGACY_ADR_NM_START_M];
+    _data.nightModeEndHour = legacy[LEGACY_ADR_NM_END_H];
+    _data.nightModeEndMin = legacy[LEGACY_ADR_NM_END_M];
+    _data.brightnessInner = legacy[LEGACY_ADR_BRIGHTNESS_INNER];
+    _data.brightnessOuter = legacy[LEGACY_ADR_BRIGHTNESS_OUTER];
+}
+
+/**
+ * @brief (private) Replace invalid values by defaults
+ * 
+ * colors which are nearly black are set to yellow, brightness lower limit is 10 so that the 
+ * LEDs are not completely off
+ */
+void Settings::sanitize(){
+    for(uint8_t color = 0; color < SETTINGS_COLOR_COUNT; color++){
+        uint8_t* rgb = _data.colors[color];
+        if(int(rgb[0]) + int(rgb[1]) + int(rgb[2]) < 50){
+            rgb[0] = 200;
+            rgb[1] = 200;
+            rgb[2] = 0;
+        }
+    }
+    if(_data.nightModeStartHour > 23) _data.nightModeStartHour = 22; // set to 22 o'clock as default
+    if(_data.nightModeStartMin > 59) _data.nightModeStartMin = 0;
+    if(_data.nightModeEndHour > 23) _data.nightModeEndHour = 7; // set to 7 o'clock as default
+    if(_data.nightModeEndMin > 59) _data.nightModeEndMin = 0;
+    if(_data.timeSyncMode >= TIMESYNC_MODE_COUNT) _data.timeSyncMode = TIMESYNC_OFF;
+    if(_data.fleetGroup >= FLEET_GROUP_COUNT) _data.fleetGroup = 0;
+    if(_data.brightnessInner < 10) _data.brightnessInner = 10;
+    if(_data.brightnessOuter < 10) _data.brightnessOuter = 10;
+}
+
+/**
+ * @brief (private) Mark the working copy as changed and restart the debounce time
+ * 
+ */
+void Settings::markChanged(){
+    unsigned long now = millis();
+    if(!_dirty) _firstChange = now;
+    _lastChange = now;
+    _dirty = true;
+}
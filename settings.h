@@ -0,0 +1,107 @@
+/**
+ * @file settings.h
+ * @brief Persistent settings as versioned, CRC32 checked record with wear levelling
+ * 
+ * The working copy of the settings is kept in RAM. Changes are only marked and written 
+ * to flash by commit()/loop() after SETTINGS_COMMIT_DELAY ms without a further change 
+ * (at the latest SETTINGS_COMMIT_DELAY_MAX ms after the first change), so scrubbing a 
+ * color picker costs one flash write.
+ * 
+ * The records are appended to consecutive slots of the EEPROM flash sector. Flash bits 
+ * can be cleared without an erase, so the sector is only erased when all slots are used 
+ * (once per SETTINGS_SLOT_COUNT commits). The valid record (magic, CRC32) with the 
+ * highest sequence number is the current one. On the first boot with this firmware the 
+ * settings are migrated from the old fixed EEPROM address map.
+ */
+
+#ifndef settings_h
+#define settings_h
+
+#include <Arduino.h>
+
+#define SETTINGS_MAGIC 0x5343               // "CS", marks a settings record
+#define SETTINGS_VERSION 1                  // version of SettingsData, increase on changes of the layout
+#define SETTINGS_RECORD_SIZE 32             // size of one slot in bytes (multiple of 4)
+#define SETTINGS_SECTOR_SIZE 4096           // size of the flash sector of the EEPROM area
+#define SETTINGS_SLOT_COUNT (SETTINGS_SECTOR_SIZE / SETTINGS_RECORD_SIZE)
+#define SETTINGS_COMMIT_DELAY 5000          // commit after no change for this time (ms)
+#define SETTINGS_COMMIT_DELAY_MAX 30000     // commit at the latest this time (ms) after the first change
+
+enum SettingsColor {SETTINGS_COLOR_HOURS, SETTINGS_COLOR_MINUTES, SETTINGS_COLOR_SECONDS, SETTINGS_COLOR_COUNT};
+
+enum SettingsSource {SETTINGS_SOURCE_FLASH, SETTINGS_SOURCE_MIGRATED};
+
+/**
+ * @brief Content of the settings (version SETTINGS_VERSION), new fields are only appended
+ * 
+ */
+struct SettingsData {
+    uint8_t colors[SETTINGS_COLOR_COUNT][3];    // rgb of hours, minutes, seconds
+    uint8_t nightModeStartHour;
+    uint8_t nightModeStartMin;
+    uint8_t nightModeEndHour;
+    uint8_t nightModeEndMin;
+    uint8_t brightnessInner;
+    uint8_t brightnessOuter;
+    uint8_t timeSyncMode;                       // TimeSyncMode of the time beacons (see timebeacon.h)
+    uint8_t fleetGroup;                         // group for the bulk configuration (see fleet.h)
+};
+
+/**
+ * @brief One slot in flash
+ * 
+ */
+struct __attribute__((packed, aligned(4))) SettingsRecord {
+    uint16_t magic;         // SETTINGS_MAGIC
+    uint8_t version;        // SETTINGS_VERSION of the writing firmware
+    uint8_t dataSize;       // sizeof(SettingsData) of the writing firmware
+    uint32_t sequence;      // incremented with every commit
+    SettingsData data;
+    uint8_t reserved[SETTINGS_RECORD_SIZE - 12 - sizeof(SettingsData)];
+    uint32_t crc;           // CRC32 of all previous bytes
+};
+
+static_assert(sizeof(SettingsRecord) == SETTINGS_RECORD_SIZE, "SettingsRecord has to fill one slot");
+
+class Settings{
+
+    public:
+        Settings();
+        SettingsSource begin();
+        bool loop();
+        bool commit();
+        bool isDirty() const;
+        uint32_t getCommitCount() const;
+        uint32_t getColor(SettingsColor color) const;
+        void setColor(SettingsColor color, uint8_t red, uint8_t green, uint8_t blue);
+        void getNightMode(uint8_t &startHour, uint8_t &startMin, uint8_t &endHour, uint8_t &endMin) const;
+        void setNightMode(uint8_t startHour, uint8_t startMin, uint8_t endHour, uint8_t endMin);
+        uint8_t getBrightnessInner() const;
+        uint8_t getBrightnessOuter() const;
+        void setBrightness(uint8_t inner, uint8_t outer);
+        uint8_t getTimeSyncMode() const;
+        void setTimeSyncMode(uint8_t mode);
+        uint8_t getFleetGroup() const;
+        void setFleetGroup(uint8_t group);
+
+    private:
+        uint32_t sectorAddress() const;
+        bool readSlot(uint16_t slot, SettingsRecord &record) const;
+        bool isValid(const SettingsRecord &record) const;
+        void loadLegacy();
+        void sanitize();
+        void markChanged();
+        bool writeRecord();
+
+        SettingsData _data;             // working copy
+        SettingsData _committed;        // content of the newest record in flash
+        uint32_t _sequence = 0;
+        uint16_t _nextSlot = 0;
+        uint32_t _commitCount = 0;
+        bool _hasRecord = false;          // _committed is stored in flash
+        bool _dirty = false;
+        unsigned long _firstChange = 0;
+        unsigned long _lastChange = 0;
+};
+
+#endif
@@ -0,0 +1,65 @@
+/**
+ * @file telemetry.h
+ * @brief Layout of the binary telemetry packet, sent on the multicast group of the UDPLogger
+ * 
+ * The packet has a fixed little endian layout without padding. The magic starts with a byte 
+ * which is invalid in UTF-8, so receivers can tell telemetry and text log datagrams apart. 
+ * Fields are only appended at the end, TELEMETRY_VERSION is incremented on every change.
+ * multicastUDP_receiver.py contains the matching decoder.
+ */
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <Arduino.h>
+
+#define TELEMETRY_MAGIC 0xC1AB      // sent as bytes 0xAB 0xC1
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PERIOD_MIN 100        // minimum period of the packets (ms), shorter periods are raised
+#define TELEMETRY_PERIOD_MAX 3600000    // maximum period of the packets (ms), longer periods are rejected
+
+// flags
+#define TELEMETRY_FLAG_NTP_SYNCED 0x01
+#define TELEMETRY_FLAG_LED_OFF 0x02
+#define TELEMETRY_FLAG_NIGHTMODE 0x04
+#define TELEMETRY_FLAG_SETTLED 0x08
+#define TELEMETRY_FLAG_SLEEP 0x10
+
+struct __attribute__((packed)) TelemetryPacket {
+    uint16_t magic;                 // TELEMETRY_MAGIC
+    uint8_t  version;               // TELEMETRY_VERSION
+    uint8_t  flags;                 // TELEMETRY_FLAG_*
+    uint32_t sequence;              // incremented with every packet, detects lost packets and reboots
+    uint32_t uptime;                // millis() of the device (ms)
+
+    // loop timing, measured over the current statistics window of the scheduler
+    uint32_t statsDuration;         // length of the statistics window (ms)
+    uint32_t idleTime;              // time slept in the statistics window (ms)
+    uint32_t renderRuns;            // frames rendered in the statistics window
+    uint32_t renderMaxJitter;       // maximum start delay of a frame (ms)
+    uint32_t renderTotalDuration;   // sum of render durations (µs)
+    uint32_t renderMaxDuration;     // maximum render duration (µs)
+
+    // render statistics since start
+    uint32_t framesPushed;
+    uint32_t framesSkipped;
+
+    // NTP
+    int32_t  ntpOffset;             // offset of the last sync (ms)
+    uint32_t ntpDelay;              // round trip delay of the last sync (ms)
+    int32_t  ntpDrift;              // estimated drift of the oscillator (ppb)
+    uint32_t ntpTimeSinceSync;      // time since the last successful sync (ms)
+    uint8_t  ntpHealth;             // NTPHealth
+    uint8_t  ntpFailures;           // consecutive failed updates
+
+    // WiFi and heap
+    int8_t   rssi;                  // dBm
+    uint8_t  heapFragmentation;     // %
+    uint32_t freeHeap;              // bytes
+    uint32_t maxFreeBlock;          // bytes
+    uint32_t logDropped;            // dropped log messages since start
+};
+
+static_assert(sizeof(TelemetryPacket) == 76, "layout of TelemetryPacket changed, update TELEMETRY_VERSION and the decoder");
+
+#endif
@@ -0,0 +1,222 @@
+#include "timebeacon.h"
+
+TimeBeacon::TimeBeacon(){
+}
+
+/**
+ * @brief Set the id of this clock, which is sent in the beacons
+ * 
+ * @param id unique id (e.g. ESP.getChipId())
+ */
+void TimeBeacon::begin(uint32_t id){
+    _id = id;
+}
+
+void TimeBeacon::setMode(TimeSyncMode mode){
+    _mode = mode < TIMESYNC_MODE_COUNT ? mode : TIMESYNC_OFF;
+    _leading = false;
+    _hasLeader = false;
+    _filterCount = 0;
+    _filterLocked = false;
+}
+
+TimeSyncMode TimeBeacon::getMode() const{
+    return _mode;
+}
+
+/**
+ * @brief Check if this clock leads and the next beacon is due, call periodically
+ * 
+ * @param quality quality of the own time (TIMEBEACON_QUALITY_NONE: no valid time)
+ * @return true send a beacon now (buildPacket())
+ */
+bool TimeBeacon::isBeaconDue(uint8_t quality){
+    quality = getEffectiveQuality(quality);
+    uint8_t flags = _mode == TIMESYNC_LEADER ? TIMEBEACON_FLAG_FORCED : 0;
+    _leading = (_mode == TIMESYNC_LEADER || _mode == TIMESYNC_AUTO) && quality != TIMEBEACON_QUALITY_NONE
+                && (!isLeaderAlive() || isBetter(flags, quality, _id, _leaderFlags, _leaderQuality, _leaderId));
+    return _leading && millis() - _lastSent >= TIMEBEACON_PERIOD;
+}
+
+/**
+ * @brief Write a beacon with the current time
+ * 
+ * @param buffer buffer for the packet
+ * @param size size of the buffer
+ * @param utcEpochMillis own time (UTC epoch ms), taken immediately before sending
+ * @param quality quality of the own time
+ * @return size_t length of the packet (0 if the buffer is too small)
+ */
+size_t TimeBeacon::buildPacket(uint8_t* buffer, size_t size, uint64_t utcEpochMillis, uint8_t quality){
+    if(size < sizeof(TimeBeaconPacket)){
+        return 0;
+    }
+    TimeBeaconPacket packet = {};
+    packet.magic = TIMEBEACON_MAGIC;
+    packet.version = TIMEBEACON_VERSION;
+    packet.flags = _mode == TIMESYNC_LEADER ? TIMEBEACON_FLAG_FORCED : 0;
+    packet.senderId = _id;
+    packet.sequence = _sequence++;
+    packet.quality = quality;
+    packet.utcEpochMillis = utcEpochMillis;
+    memcpy(buffer, &packet, sizeof(packet));
+    _lastSent = millis();
+    return sizeof(packet);
+}
+
+/**
+ * @brief Handle a received datagram of the multicast group
+ * 
+ * @param data datagram
+ * @param length length of the datagram
+ * @param receiveMillis local millis() of the reception
+ * @param quality quality of the own time
+ * @return true filtered beacon of the leader, synchronize to getLeaderEpochMillis() at getLeaderLocalMillis()
+ * @return false no beacon, own beacon, not from the leader or filter window not complete
+ */
+bool TimeBeacon::handlePacket(const uint8_t* data, size_t length, unsigned long receiveMillis, uint8_t quality){
+    if(_mode == TIMESYNC_OFF || length < sizeof(TimeBeaconPacket)){
+        return false;
+    }
+    TimeBeaconPacket packet;
+    memcpy(&packet, data, sizeof(packet));
+    if(packet.magic != TIMEBEACON_MAGIC || packet.version != TIMEBEACON_VERSION 
+        || packet.senderId == _id || packet.quality == TIMEBEACON_QUALITY_NONE){
+        return false;
+    }
+
+    // follow the sender if it is the current leader, better than the current leader, or the leader was lost
+    if(_hasLeader && isLeaderAlive() && packet.senderId != _leaderId 
+        && !isBetter(packet.flags, packet.quality, packet.senderId, _leaderFlags, _leaderQuality, _leaderId)){
+        return false;
+    }
+    if(!isLeaderAlive() || packet.senderId != _leaderId){
+        _filterCount = 0;
+        _filterLocked = false;
+    }
+    _hasLeader = true;
+    _leaderId = packet.senderId;
+    _leaderFlags = packet.flags;
+    _leaderQuality = packet.quality;
+    _leaderSeen = receiveMillis;
+
+    // a leading clock only follows a better one
+    quality = getEffectiveQuality(quality);
+    uint8_t flags = _mode == TIMESYNC_LEADER ? TIMEBEACON_FLAG_FORCED : 0;
+    if(_mode == TIMESYNC_LEADER || (_mode == TIMESYNC_AUTO && quality != TIMEBEACON_QUALITY_NONE 
+        && isBetter(flags, quality, _id, _leaderFlags, _leaderQuality, _leaderId))){
+        _filterCount = 0;
+        _filterLocked = false;
+        return false;
+    }
+    _leading = false;
+
+    // keep the beacon with the shortest delay: it gives the latest time of the leader at the same local time
+    uint64_t epochMillis = packet.utcEpochMillis + TIMEBEACON_LATENCY;
+    if(_filterCount == 0 || epochMillis > _filterEpochMillis + (receiveMillis - _filterLocalMillis)){
+        _filterEpochMillis = epochMillis;
+        _filterLocalMillis = receiveMillis;
+    }
+    _filterCount++;
+    if(_filterLocked && _filterCount < TIMEBEACON_FILTER_WINDOW){
+        return false;
+    }
+    // move the filtered time to the reception of this beacon, so the time base is never synced to the past
+    _filterEpochMillis += receiveMillis - _filterLocalMillis;
+    _filterLocalMillis = receiveMillis;
+    _filterCount = 0;
+    _filterLocked = true;
+    _received++;
+    return true;
+}
+
+/**
+ * @brief Get the time of the leader of the filtered beacon (UTC epoch ms, incl. TIMEBEACON_LATENCY)
+ * 
+ */
+uint64_t TimeBeacon::getLeaderEpochMillis() const{
+    return _filterEpochMillis;
+}
+
+/**
+ * @brief Get the local millis() of the reception of the filtered beacon of the leader
+ * 
+ */
+unsigned long TimeBeacon::getLeaderLocalMillis() const{
+    return _filterLocalMillis;
+}
+
+bool TimeBeacon::isLeader() const{
+    return _mode != TIMESYNC_OFF && _leading;
+}
+
+/**
+ * @brief Check if the time base follows a leader (the own NTP updates can be skipped)
+ * 
+ */
+bool TimeBeacon::isFollowing() const{
+    return _mode != TIMESYNC_OFF && _mode != TIMESYNC_LEADER && !_leading && isLeaderAlive() && _received > 0;
+}
+
+uint32_t TimeBeacon::getLeaderId() const{
+    return _hasLeader ? _leaderId : 0;
+}
+
+/**
+ * @brief Get the number of beacons used for synchronization
+ * 
+ */
+uint32_t TimeBeacon::getReceivedCount() const{
+    return _received;
+}
+
+/**
+ * @brief Get the name of the mode
+ * 
+ * @param mode mode
+ * @return const char* name
+ */
+const char* TimeBeacon::getModeName(TimeSyncMode mode){
+    switch(mode){
+        case TIMESYNC_AUTO: return "auto";
+        case TIMESYNC_LEADER: return "leader";
+        case TIMESYNC_FOLLOWER: return "follower";
+        default: return "off";
+    }
+}
+
+/**
+ * @brief (private) Order of the clocks for the election: forced leader, then quality, then lowest id
+ * 
+ */
+bool TimeBeacon::isBetter(uint8_t flags, uint8_t quality, uint32_t id, uint8_t otherFlags, uint8_t otherQuality, uint32_t otherId) const{
+    bool forced = flags & TIMEBEACON_FLAG_FORCED;
+    bool otherForced = otherFlags & TIMEBEACON_FLAG_FORCED;
+    if(forced != otherForced){
+        return forced;
+    }
+    if(quality != otherQuality){
+        return quality < otherQuality;
+    }
+    return id < otherId;
+}
+
+/**
+ * @brief (private) Check if a beacon of the leader was received within TIMEBEACON_TIMEOUT
+ * 
+ */
+bool TimeBeacon::isLeaderAlive() const{
+    return _hasLeader && millis() - _leaderSeen < TIMEBEACON_TIMEOUT;
+}
+
+/**
+ * @brief (private) While following, the own time is one step worse than the time of the leader 
+ * (like the stratum of NTP), so a follower does not take over with the time it got from the leader
+ * 
+ */
+uint8_t TimeBeacon::getEffectiveQuality(uint8_t quality) const{
+    if(isFollowing() && _leaderQuality < TIMEBEACON_QUALITY_NONE - 1 && quality <= _leaderQuality){
+        return _leaderQuality + 1;
+    }
+    return quality;
+}
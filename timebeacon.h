@@ -0,0 +1,97 @@
+/**
+ * @file timebeacon.h
+ * @brief Time beacons on the multicast group of the UDPLogger, so several clocks show 
+ * the seconds in lockstep
+ * 
+ * The leader sends its millisecond time base every TIMEBEACON_PERIOD ms, the followers 
+ * synchronize their time base to it (stepped or slewed like an NTP sync) and skip their 
+ * own NTP updates. With modem sleep multicast datagrams are delivered with the next DTIM 
+ * beacon of the access point, so the delay varies by up to some 100 ms: a follower only 
+ * uses the beacon with the shortest delay of each TIMEBEACON_FILTER_WINDOW beacons (the 
+ * first beacon of a new leader is used immediately). In TIMESYNC_AUTO the best clock leads: clocks in TIMESYNC_LEADER, then 
+ * the best NTP health, then the lowest id. A clock stops leading as soon as it receives a 
+ * beacon of a better one, a follower takes over after TIMEBEACON_TIMEOUT without beacon.
+ * 
+ * The packet has a fixed little endian layout without padding and starts with the same 
+ * byte as the telemetry packet (invalid in UTF-8), see telemetry.h.
+ */
+
+#ifndef timebeacon_h
+#define timebeacon_h
+
+#include <Arduino.h>
+
+#define TIMEBEACON_MAGIC 0xC2AB         // sent as bytes 0xAB 0xC2
+#define TIMEBEACON_VERSION 1
+#define TIMEBEACON_PERIOD 1000          // period of the beacons of the leader (ms)
+#define TIMEBEACON_TIMEOUT 3500         // time without beacon until the leader is considered lost (ms)
+#define TIMEBEACON_LATENCY 2            // minimum transmission delay of a beacon in the local network (ms)
+#define TIMEBEACON_FILTER_WINDOW 8      // beacons of which the one with the shortest delay is used for synchronization
+
+#define TIMEBEACON_QUALITY_NONE 255     // no valid time, the clock can not lead
+#define TIMEBEACON_FLAG_FORCED 0x01     // sender is in TIMESYNC_LEADER
+
+enum TimeSyncMode {
+    TIMESYNC_OFF,                   // no beacons sent or used
+    TIMESYNC_AUTO,                  // lead if this is the best clock, otherwise follow
+    TIMESYNC_LEADER,                // always lead
+    TIMESYNC_FOLLOWER,              // never lead
+    TIMESYNC_MODE_COUNT
+};
+
+struct __attribute__((packed)) TimeBeaconPacket {
+    uint16_t magic;                 // TIMEBEACON_MAGIC
+    uint8_t  version;               // TIMEBEACON_VERSION
+    uint8_t  flags;                 // TIMEBEACON_FLAG_*
+    uint32_t senderId;              // chip id of the sender
+    uint32_t sequence;              // incremented with every beacon
+    uint8_t  quality;               // quality of the time of the sender (lower is better, e.g. NTP health)
+    uint8_t  reserved[3];
+    uint64_t utcEpochMillis;        // time of the sender (UTC epoch ms) when the beacon was sent
+};
+
+class TimeBeacon{
+
+    public:
+        TimeBeacon();
+        void begin(uint32_t id);
+        void setMode(TimeSyncMode mode);
+        TimeSyncMode getMode() const;
+        bool isBeaconDue(uint8_t quality);
+        size_t buildPacket(uint8_t* buffer, size_t size, uint64_t utcEpochMillis, uint8_t quality);
+        bool handlePacket(const uint8_t* data, size_t length, unsigned long receiveMillis, uint8_t quality);
+        uint64_t getLeaderEpochMillis() const;
+        unsigned long getLeaderLocalMillis() const;
+        bool isLeader() const;
+        bool isFollowing() const;
+        uint32_t getLeaderId() const;
+        uint32_t getReceivedCount() const;
+        static const char* getModeName(TimeSyncMode mode);
+
+    private:
+        bool isBetter(uint8_t flags, uint8_t quality, uint32_t id, uint8_t otherFlags, uint8_t otherQuality, uint32_t otherId) const;
+        bool isLeaderAlive() const;
+        uint8_t getEffectiveQuality(uint8_t quality) const;
+
+        TimeSyncMode _mode = TIMESYNC_OFF;
+        uint32_t _id = 0;
+        uint32_t _sequence = 0;
+        unsigned long _lastSent = 0;
+        bool _leading = false;
+
+        // best other clock heard within TIMEBEACON_TIMEOUT
+        bool _hasLeader = false;
+        uint32_t _leaderId = 0;
+        uint8_t _leaderFlags = 0;
+        uint8_t _leaderQuality = TIMEBEACON_QUALITY_NONE;
+        unsigned long _leaderSeen = 0;
+        uint32_t _received = 0;             // beacons used for synchronization
+
+        // beacon with the shortest delay of the current filter window
+        uint8_t _filterCount = 0;           // beacons in the current window
+        bool _filterLocked = false;         // a beacon of the current leader was used for synchronization
+        uint64_t _filterEpochMillis = 0;    // time of the leader at _filterLocalMillis
+        unsigned long _filterLocalMillis = 0;
+};
+
+#endif
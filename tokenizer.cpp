@@ -0,0 +1,69 @@
+#include "tokenizer.h"
+
+/**
+ * @brief Construct a new Tokenizer for a null terminated text
+ * 
+ * @param text text to split, is modified
+ */
+Tokenizer::Tokenizer(char* text){
+    _position = text;
+    _end = text + strlen(text);
+}
+
+/**
+ * @brief Construct a new Tokenizer for a text of given length
+ * 
+ * @param text text to split, is modified, text[length] has to be writable (it is set to '\0')
+ * @param length length of the text
+ */
+Tokenizer::Tokenizer(char* text, size_t length){
+    _position = text;
+    _end = text + length;
+    *_end = '\0';
+}
+
+/**
+ * @brief Get the next token
+ * 
+ * @param delimiters characters which end a token
+ * @return char* null terminated token (may be empty), nullptr if the text is consumed
+ */
+char* Tokenizer::next(const char* delimiters){
+    if(_position > _end) return nullptr;
+    char* token = _position;
+    while(_position < _end && strchr(delimiters, *_position) == nullptr) _position++;
+    *_position = '\0';
+    _position++;
+    return token;
+}
+
+/**
+ * @brief Check if there are characters left
+ * 
+ */
+bool Tokenizer::hasNext() const{
+    return _position < _end;
+}
+
+/**
+ * @brief Parse a list of decimal numbers (e.g. "255-128-0") in one pass
+ * 
+ * @param text null terminated text, is modified
+ * @param delimiter character between the numbers
+ * @param values array for the numbers
+ * @param maxCount size of the array
+ * @return int8_t count of numbers, -1 if a field is not a number or there are more than maxCount fields
+ */
+int8_t Tokenizer::parseNumbers(char* text, char delimiter, long* values, uint8_t maxCount){
+    const char delimiters[2] = {delimiter, '\0'};
+    Tokenizer tokenizer(text);
+    uint8_t count = 0;
+    char* field;
+    while((field = tokenizer.next(delimiters)) != nullptr){
+        char* fieldEnd;
+        long number = strtol(field, &fieldEnd, 10);
+        if(count >= maxCount || fieldEnd == field || *fieldEnd != '\0') return -1;
+        values[count++] = number;
+    }
+    return count;
+}
@@ -0,0 +1,30 @@
+/**
+ * @file tokenizer.h
+ * @brief Single-pass, in-place tokenizer for command payloads
+ * 
+ * The text is split at the given delimiter characters by overwriting each delimiter 
+ * with '\0', the returned tokens point into the original buffer. Nothing is copied 
+ * or allocated, and every character is visited only once. Used for the commands of 
+ * "/cmd" and the WebSocket (e.g. "col_hours=255-0-0&ledoff=1").
+ */
+
+#ifndef tokenizer_h
+#define tokenizer_h
+
+#include <Arduino.h>
+
+class Tokenizer{
+
+    public:
+        Tokenizer(char* text);
+        Tokenizer(char* text, size_t length);
+        char* next(const char* delimiters);
+        bool hasNext() const;
+        static int8_t parseNumbers(char* text, char delimiter, long* values, uint8_t maxCount);
+
+    private:
+        char* _position;
+        char* _end;
+};
+
+#endif
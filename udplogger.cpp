@@ -1,38 +1,242 @@
 #include "udplogger.h"
 
+static const char* const levelPrefix[] = {"ERROR: ", "WARN: ", "", ""};
+
 UDPLogger::UDPLogger(){
 
 }
 
 UDPLogger::UDPLogger(IPAddress interfaceAddr, IPAddress multicastAddr, int port){
+    begin(interfaceAddr, multicastAddr, port);
+}
+
+/**
+ * @brief Start sending the log via UDP multicast. Messages logged before are only sent via Serial.
+ * 
+ * @param interfaceAddr IP address of the network interface
+ * @param multicastAddr multicast group
+ * @param port UDP port
+ */
+void UDPLogger::begin(IPAddress interfaceAddr, IPAddress multicastAddr, int port){
     _multicastAddr = multicastAddr;
     _port = port;
     _interfaceAddr = interfaceAddr;
-    _name = "Log";
     _Udp.beginMulticast(_interfaceAddr, _multicastAddr, _port);
+    _udpTail = _serialTail;
+    _udpActive = true;
+}
+
+/**
+ * @brief Set the name which is prepended to every line
+ * 
+ * @param name name (truncated to 15 characters)
+ */
+void UDPLogger::setName(const char* name){
+    strncpy(_name, name, sizeof(_name) - 1);
+    _name[sizeof(_name) - 1] = '\0';
+}
+
+void UDPLogger::setLevel(LogLevel level){
+    _level = level;
+}
+
+LogLevel UDPLogger::getLevel() const{
+    return _level;
+}
+
+/**
+ * @brief Log a printf-style formatted message
+ * 
+ * @param level log level of the message
+ * @param format printf format string
+ */
+void UDPLogger::logf(LogLevel level, const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    vlogf(level, format, args);
+    va_end(args);
 }
 
-void UDPLogger::setName(String name){
-    _name = name;
+/**
+ * @brief Log a String with level LOG_INFO
+ * 
+ * @param logmessage message
+ */
+void UDPLogger::logString(const String &logmessage){
+    logf(LOG_INFO, "%s", logmessage.c_str());
 }
 
-void UDPLogger::logString(String logmessage){
-    // wait 5 milliseconds if last send was less than 5 milliseconds before 
-    if(millis() < (_lastSend + 5)){
-        delay(5);
+void UDPLogger::logColor24bit(uint32_t color){
+    logf(LOG_INFO, "%u, %u, %u", (unsigned int)(color >> 16 & 0xff), (unsigned int)(color >> 8 & 0xff), (unsigned int)(color & 0xff));
+}
+
+/**
+ * @brief Get the number of messages which were dropped because the ring buffer was full
+ * 
+ * @return uint32_t number of dropped messages since start
+ */
+uint32_t UDPLogger::getDroppedCount() const{
+    return _dropped;
+}
+
+/**
+ * @brief Send the buffered lines via UDP multicast and Serial, never blocks
+ * 
+ */
+void UDPLogger::flush(){
+    flushUDP();
+    flushSerial();
+}
+
+/**
+ * @brief Send a binary datagram (e.g. telemetry) immediately on the multicast group, bypassing the ring buffer
+ * 
+ * @param data payload
+ * @param length length of the payload in bytes
+ * @return true datagram sent
+ * @return false logger not started or sending failed
+ */
+bool UDPLogger::sendBinary(const uint8_t* data, size_t length){
+    if(!_udpActive){
+        return false;
     }
-    logmessage = _name + ": " + logmessage;
-    Serial.println(logmessage);
     _Udp.beginPacketMulticast(_multicastAddr, _port, _interfaceAddr);
-    logmessage.toCharArray(_packetBuffer, 100);
-    _Udp.print(_packetBuffer);
-    _Udp.endPacket();
-    _lastSend=millis();
+    _Udp.write(data, length);
+    return _Udp.endPacket() == 1;
 }
 
-void UDPLogger::logColor24bit(uint32_t color){
-  uint8_t resultRed = color >> 16 & 0xff;
-  uint8_t resultGreen = color >> 8 & 0xff;
-  uint8_t resultBlue = color & 0xff;
-  logString(String(resultRed) + ", " + String(resultGreen) + ", " + String(resultBlue));
-}
\ No newline at end of file
+/**
+ * @brief Read the next datagram received on the multicast group (other clocks, tools), longer 
+ * datagrams are truncated. Call regularly, unread datagrams stay in memory.
+ * 
+ * @param buffer buffer for the datagram
+ * @param size size of the buffer
+ * @param sender IP address of the sender (optional)
+ * @return size_t length of the datagram in the buffer, 0 if nothing was received
+ */
+size_t UDPLogger::receiveBinary(uint8_t* buffer, size_t size, IPAddress* sender){
+    if(!_udpActive || _Udp.parsePacket() <= 0){
+        return 0;
+    }
+    if(sender){
+        *sender = _Udp.remoteIP();
+    }
+    // the rest of a truncated datagram is discarded by the next parsePacket()
+    int length = _Udp.read(buffer, size);
+    return length > 0 ? length : 0;
+}
+
+/**
+ * @brief (private) Format one line «name: [level] message\n» and append it to the ring buffer
+ * 
+ */
+void UDPLogger::vlogf(LogLevel level, const char* format, va_list args){
+    if(level > _level){
+        return;
+    }
+
+    char line[LOGGER_LINE_MAX];
+    int prefixLength = snprintf(line, sizeof(line), "%s: %s", _name, levelPrefix[level]);
+    int length = prefixLength + vsnprintf(line + prefixLength, sizeof(line) - prefixLength, format, args);
+    if(length >= (int)sizeof(line)){
+        // mark truncated lines
+        length = sizeof(line) - 1;
+        line[length - 1] = '~';
+    }
+    // every line ends with exactly one newline
+    while(length > prefixLength && (line[length - 1] == '\n' || line[length - 1] == '\r')){
+        length--;
+    }
+    line[length++] = '\n';
+
+    // report dropped messages as soon as there is space again
+    if(_dropped != _droppedReported){
+        char note[48];
+        int noteLength = snprintf(note, sizeof(note), "%s: WARN: %lu log messages dropped\n", _name, (unsigned long)(_dropped - _droppedReported));
+        if(!push(note, noteLength)){
+            _dropped++;
+            return;
+        }
+        _droppedReported = _dropped;
+    }
+    if(!push(line, length)){
+        _dropped++;
+    }
+}
+
+/**
+ * @brief (private) Append a line to the ring buffer
+ * 
+ * @return true line appended
+ * @return false not enough space, nothing appended
+ */
+bool UDPLogger::push(const char* line, uint16_t length){
+    uint16_t usedUDP = _udpActive ? (uint16_t)(_head - _udpTail) : 0;
+    uint16_t usedSerial = _head - _serialTail;
+    uint16_t used = usedUDP > usedSerial ? usedUDP : usedSerial;
+    if(length > LOGGER_BUFFER_SIZE - used){
+        return false;
+    }
+    uint16_t start = _head & (LOGGER_BUFFER_SIZE - 1);
+    uint16_t first = LOGGER_BUFFER_SIZE - start;
+    if(first > length){
+        first = length;
+    }
+    memcpy(_buffer + start, line, first);
+    memcpy(_buffer, line + first, length - first);
+    _head += length;
+    return true;
+}
+
+/**
+ * @brief (private) Send complete lines packed into datagrams of up to LOGGER_PACKET_MAX bytes
+ * 
+ */
+void UDPLogger::flushUDP(){
+    if(!_udpActive){
+        return;
+    }
+    for(uint8_t packet = 0; packet < LOGGER_PACKETS_PER_FLUSH && _head != _udpTail; packet++){
+        uint16_t available = _head - _udpTail;
+        uint16_t length = available < LOGGER_PACKET_MAX ? available : LOGGER_PACKET_MAX;
+        // only whole lines (the buffer always ends with a complete line)
+        while(length > 0 && _buffer[(_udpTail + length - 1) & (LOGGER_BUFFER_SIZE - 1)] != '\n'){
+            length--;
+        }
+        if(length == 0){
+            length = available < LOGGER_PACKET_MAX ? available : LOGGER_PACKET_MAX;
+        }
+
+        uint16_t start = _udpTail & (LOGGER_BUFFER_SIZE - 1);
+        uint16_t first = LOGGER_BUFFER_SIZE - start;
+        if(first > length){
+            first = length;
+        }
+        _Udp.beginPacketMulticast(_multicastAddr, _port, _interfaceAddr);
+        _Udp.write((const uint8_t*)_buffer + start, first);
+        _Udp.write((const uint8_t*)_buffer, length - first);
+        _Udp.endPacket();
+        _udpTail += length;
+    }
+}
+
+/**
+ * @brief (private) Write as many bytes to Serial as fit into its transmit FIFO
+ * 
+ */
+void UDPLogger::flushSerial(){
+    uint16_t available = _head - _serialTail;
+    int space = Serial.availableForWrite();
+    if(available == 0 || space <= 0){
+        return;
+    }
+    uint16_t length = available < space ? available : space;
+    uint16_t start = _serialTail & (LOGGER_BUFFER_SIZE - 1);
+    uint16_t first = LOGGER_BUFFER_SIZE - start;
+    if(first > length){
+        first = length;
+    }
+    Serial.write((const uint8_t*)_buffer + start, first);
+    Serial.write((const uint8_t*)_buffer, length - first);
+    _serialTail += length;
+}
@@ -1,12 +1,16 @@
 /**
  * @file udplogger.h
  * @author techniccontroller (mail[at]techniccontroller.com)
- * @brief Class for sending logging Strings as multicast messages 
- * @version 0.1
+ * @brief Class for sending logging messages as multicast messages 
+ * @version 0.2
  * @date 2022-03-21
  * 
  * @copyright Copyright (c) 2022
  * 
+ * Messages are formatted printf-style into a preallocated ring buffer (no heap allocation) 
+ * and sent by flush(), which is called periodically from the scheduler. Several lines are 
+ * packed into one multicast datagram, Serial output is written only as far as the hardware 
+ * FIFO has space, so logging never blocks or calls delay().
  */
 
 #ifndef udplogger_h
@@ -15,23 +19,61 @@
 #include <Arduino.h>
 #include <WiFiUdp.h>
 
+#define LOGGER_BUFFER_SIZE 2048     // size of the ring buffer in bytes (power of two)
+#define LOGGER_LINE_MAX 128         // maximum length of one line incl. name, longer lines are truncated
+#define LOGGER_PACKET_MAX 512       // maximum payload of one multicast datagram
+#define LOGGER_PACKETS_PER_FLUSH 2  // maximum number of datagrams sent per flush()
+
+static_assert((LOGGER_BUFFER_SIZE & (LOGGER_BUFFER_SIZE - 1)) == 0, "LOGGER_BUFFER_SIZE must be a power of two");
+
+/**
+ * @brief Log levels, messages above the configured level are discarded
+ * 
+ */
+enum LogLevel {
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+};
 
 class UDPLogger{
 
     public:
         UDPLogger();
         UDPLogger(IPAddress interfaceAddr, IPAddress multicastAddr, int port);
-        void setName(String name);
-        void logString(String logmessage);
+        void begin(IPAddress interfaceAddr, IPAddress multicastAddr, int port);
+        void setName(const char* name);
+        void setLevel(LogLevel level);
+        LogLevel getLevel() const;
+        void logf(LogLevel level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+        void logString(const String &logmessage);
         void logColor24bit(uint32_t color);
+        void flush();
+        bool sendBinary(const uint8_t* data, size_t length);
+        size_t receiveBinary(uint8_t* buffer, size_t size, IPAddress* sender = nullptr);
+        uint32_t getDroppedCount() const;
     private:
-        String _name;
+        void vlogf(LogLevel level, const char* format, va_list args);
+        bool push(const char* line, uint16_t length);
+        void flushUDP();
+        void flushSerial();
+
+        char _name[16] = "Log";
+        LogLevel _level = LOG_INFO;
         IPAddress _multicastAddr;
         IPAddress _interfaceAddr;
-        int _port;
+        int _port = 0;
+        bool _udpActive = false;
         WiFiUDP _Udp;
-        char _packetBuffer[100];
-        unsigned long _lastSend;
+
+        // ring buffer with free running indices, _udpTail and _serialTail are the read positions
+        char _buffer[LOGGER_BUFFER_SIZE];
+        uint16_t _head = 0;
+        uint16_t _udpTail = 0;
+        uint16_t _serialTail = 0;
+        uint32_t _dropped = 0;          // messages dropped since start
+        uint32_t _droppedReported = 0;  // dropped messages already reported in the log
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,217 @@
+#include "uploadpipeline.h"
+#include <Updater.h>
+#include <flash_hal.h>
+
+/**
+ * @brief Start a new upload (a running upload is aborted)
+ * 
+ * @param target where the data is written to
+ * @param path path of the file (only UPLOAD_TARGET_FILE)
+ * @param expectedSize exact size of the data, 0 = unknown
+ * @param expectedMD5 expected MD5 digest as 32 hex characters, nullptr or empty = no check
+ * @param progressTotal estimated size for the progress if the exact size is unknown (e.g. content length)
+ * @return true upload started
+ * @return false upload could not be started (see getError())
+ */
+bool UploadPipeline::begin(UploadTarget target, const char* path, size_t expectedSize, const char* expectedMD5, size_t progressTotal){
+    if(_state == UPLOAD_RUNNING) abort();
+    _state = UPLOAD_RUNNING;
+    _target = target;
+    _expectedSize = expectedSize;
+    _progressTotal = expectedSize ? expectedSize : progressTotal;
+    _written = 0;
+    _buffered = 0;
+    _error = "";
+    _md5[0] = '\0';
+    if(strlcpy(_path, path ? path : "", sizeof(_path)) >= sizeof(_path)) return fail("path too long");
+    if(strlcpy(_expectedMD5, expectedMD5 ? expectedMD5 : "", sizeof(_expectedMD5)) >= sizeof(_expectedMD5)) return fail("invalid md5");
+    if(_expectedMD5[0] && strlen(_expectedMD5) != 32) return fail("invalid md5");
+    for(char* c = _expectedMD5; *c; c++) *c = tolower(*c);
+    _hash.begin();
+
+    if(target == UPLOAD_TARGET_FILE){
+        if(_path[0] != '/' || strcmp(_path, UPLOAD_TEMP_PATH) == 0) return fail("invalid path");
+        _buffer = (uint8_t*)malloc(UPLOAD_BUFFER_SIZE);
+        if(!_buffer) return fail("out of memory");
+        _file = LittleFS.open(UPLOAD_TEMP_PATH, "w");
+        if(!_file) return fail("cannot create file");
+        return true;
+    }
+
+    size_t partitionSize;
+    int command;
+    if(target == UPLOAD_TARGET_FIRMWARE){
+        partitionSize = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+        command = U_FLASH;
+    }
+    else {
+        partitionSize = FS_PHYS_SIZE;
+        command = U_FS;
+        LittleFS.end();                     // the filesystem is overwritten
+    }
+    if(expectedSize > partitionSize) return fail("image too large");
+    if(!Update.begin(expectedSize ? expectedSize : partitionSize, command)) return fail("update begin failed");
+    if(_expectedMD5[0]) Update.setMD5(_expectedMD5);
+    return true;
+}
+
+/**
+ * @brief Write the next chunk of data
+ * 
+ * @param data data
+ * @param length length of the data
+ * @return true data written (or buffered)
+ * @return false write failed, the upload is aborted (see getError())
+ */
+bool UploadPipeline::write(const uint8_t* data, size_t length){
+    if(_state != UPLOAD_RUNNING) return false;
+    if(_expectedSize && _written + length > _expectedSize) return fail("more data than expected");
+    _hash.add(data, length);
+    _written += length;
+
+    if(_target != UPLOAD_TARGET_FILE){
+        if(Update.write((uint8_t*)data, length) != length) return fail("update write failed");
+        return true;
+    }
+    while(length > 0){
+        size_t part = UPLOAD_BUFFER_SIZE - _buffered;
+        if(part > length) part = length;
+        memcpy(_buffer + _buffered, data, part);
+        _buffered += part;
+        data += part;
+        length -= part;
+        if(_buffered == UPLOAD_BUFFER_SIZE && !flushBuffer()) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finish the upload: write the rest, check size and digest and activate the data 
+ * (rename the file, mark the image for the next boot)
+ * 
+ * @return true upload complete and verified
+ * @return false upload failed (see getError())
+ */
+bool UploadPipeline::end(){
+    if(_state != UPLOAD_RUNNING) return false;
+    _hash.calculate();
+    _hash.getChars(_md5);
+    if(_expectedSize && _written != _expectedSize) return fail("less data than expected");
+    if(_expectedMD5[0] && strcmp(_md5, _expectedMD5) != 0) return fail("md5 mismatch");
+
+    if(_target != UPLOAD_TARGET_FILE){
+        if(!Update.end(true)) return fail("update end failed");
+        _state = UPLOAD_DONE;
+        return true;
+    }
+    if(!flushBuffer()) return false;
+    _file.close();
+    free(_buffer);
+    _buffer = nullptr;
+    LittleFS.remove(_path);
+    if(!LittleFS.rename(UPLOAD_TEMP_PATH, _path)) return fail("rename failed");
+    _state = UPLOAD_DONE;
+    return true;
+}
+
+/**
+ * @brief Abort the upload, the target is not changed
+ * 
+ */
+void UploadPipeline::abort(){
+    if(_state == UPLOAD_RUNNING) fail("aborted");
+}
+
+UploadState UploadPipeline::getState() const{
+    return _state;
+}
+
+UploadTarget UploadPipeline::getTarget() const{
+    return _target;
+}
+
+const char* UploadPipeline::getPath() const{
+    return _path;
+}
+
+size_t UploadPipeline::getWritten() const{
+    return _written;
+}
+
+size_t UploadPipeline::getExpectedSize() const{
+    return _expectedSize;
+}
+
+/**
+ * @brief Get the progress of the upload
+ * 
+ * @return uint8_t 0-100 %, 0 if the size is unknown
+ */
+uint8_t UploadPipeline::getProgress() const{
+    if(_state == UPLOAD_DONE) return 100;
+    if(_progressTotal == 0) return 0;
+    if(_written >= _progressTotal) return 99;
+    return (uint64_t)_written * 100 / _progressTotal;
+}
+
+/**
+ * @brief Get the MD5 digest of the received data (available after end())
+ * 
+ * @return const char* 32 hex characters, empty if not calculated
+ */
+const char* UploadPipeline::getMD5() const{
+    return _md5;
+}
+
+const char* UploadPipeline::getError() const{
+    return _error;
+}
+
+const char* UploadPipeline::getTargetName(UploadTarget target){
+    switch(target){
+        case UPLOAD_TARGET_FIRMWARE: return "firmware";
+        case UPLOAD_TARGET_FILESYSTEM: return "filesystem";
+        default: return "file";
+    }
+}
+
+const char* UploadPipeline::getStateName(UploadState state){
+    switch(state){
+        case UPLOAD_RUNNING: return "running";
+        case UPLOAD_DONE: return "done";
+        case UPLOAD_FAILED: return "failed";
+        default: return "idle";
+    }
+}
+
+/**
+ * @brief (private) Write the buffered data to the temporary file
+ * 
+ */
+bool UploadPipeline::flushBuffer(){
+    if(_buffered > 0 && _file.write(_buffer, _buffered) != _buffered) return fail("file write failed");
+    _buffered = 0;
+    return true;
+}
+
+/**
+ * @brief (private) Abort the upload with an error, the target is not changed
+ * 
+ * @param error description of the error
+ * @return false always
+ */
+bool UploadPipeline::fail(const char* error){
+    _state = UPLOAD_FAILED;
+    _error = error;
+    if(_target == UPLOAD_TARGET_FILE){
+        if(_file) _file.close();
+        LittleFS.remove(UPLOAD_TEMP_PATH);
+        free(_buffer);
+        _buffer = nullptr;
+    }
+    else {
+        Update.end(false);                  // incomplete update is discarded
+        if(_target == UPLOAD_TARGET_FILESYSTEM) LittleFS.begin();
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file uploadpipeline.h
+ * @brief Buffered upload of files (LittleFS), firmware and filesystem images with MD5 check
+ * 
+ * The received chunks are hashed (MD5) as they arrive. Files are collected in a buffer 
+ * of UPLOAD_BUFFER_SIZE bytes (one flash sector) and written in whole blocks to a 
+ * temporary file, which replaces the target file only if size and digest are correct. 
+ * Firmware and filesystem images are passed to Update, which writes whole flash sectors 
+ * itself and only activates the image if the expected MD5 matches.
+ */
+
+#ifndef uploadpipeline_h
+#define uploadpipeline_h
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <MD5Builder.h>
+
+#define UPLOAD_BUFFER_SIZE 4096             // flash sector size, files are written in blocks of this size
+#define UPLOAD_TEMP_PATH "/upload.tmp"      // file receiving the data until it is verified
+#define UPLOAD_PATH_MAX 64                  // maximum length of the target path
+
+enum UploadTarget {UPLOAD_TARGET_FILE, UPLOAD_TARGET_FIRMWARE, UPLOAD_TARGET_FILESYSTEM};
+
+enum UploadState {UPLOAD_IDLE, UPLOAD_RUNNING, UPLOAD_DONE, UPLOAD_FAILED};
+
+class UploadPipeline{
+
+    public:
+        bool begin(UploadTarget target, const char* path, size_t expectedSize = 0, const char* expectedMD5 = nullptr, size_t progressTotal = 0);
+        bool write(const uint8_t* data, size_t length);
+        bool end();
+        void abort();
+        UploadState getState() const;
+        UploadTarget getTarget() const;
+        const char* getPath() const;
+        size_t getWritten() const;
+        size_t getExpectedSize() const;
+        uint8_t getProgress() const;
+        const char* getMD5() const;
+        const char* getError() const;
+        static const char* getTargetName(UploadTarget target);
+        static const char* getStateName(UploadState state);
+
+    private:
+        bool flushBuffer();
+        bool fail(const char* error);
+
+        UploadState _state = UPLOAD_IDLE;
+        UploadTarget _target = UPLOAD_TARGET_FILE;
+        char _path[UPLOAD_PATH_MAX] = "";
+        char _expectedMD5[33] = "";
+        char _md5[33] = "";
+        const char* _error = "";
+        size_t _expectedSize = 0;
+        size_t _progressTotal = 0;
+        size_t _written = 0;
+        MD5Builder _hash;
+        File _file;
+        uint8_t* _buffer = nullptr;
+        size_t _buffered = 0;
+};
+
+#endif
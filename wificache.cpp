@@ -0,0 +1,92 @@
+#include "wificache.h"
+#include <LittleFS.h>
+#include <coredecls.h>
+
+/**
+ * @brief Load the cached connection from LittleFS (has to be mounted)
+ * 
+ * @return true valid data loaded
+ * @return false no (valid) cache
+ */
+bool WiFiCache::load(){
+    _valid = false;
+    File file = LittleFS.open(WIFI_CACHE_PATH, "r");
+    if(!file) return false;
+    size_t length = file.read((uint8_t*)&_data, sizeof(_data));
+    file.close();
+    _valid = length == sizeof(_data) && _data.magic == WIFI_CACHE_MAGIC && _data.crc == calcCRC(_data) 
+                && _data.channel >= 1 && _data.channel <= 14 && _data.ip != 0;
+    return _valid;
+}
+
+/**
+ * @brief Store the data of the current connection, nothing is written if it is unchanged
+ * 
+ * @return true data stored
+ * @return false writing failed
+ */
+bool WiFiCache::save(const uint8_t* bssid, uint8_t channel, IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns){
+    WiFiCacheData data = {};
+    data.magic = WIFI_CACHE_MAGIC;
+    memcpy(data.bssid, bssid, sizeof(data.bssid));
+    data.channel = channel;
+    data.ip = (uint32_t)ip;
+    data.gateway = (uint32_t)gateway;
+    data.subnet = (uint32_t)subnet;
+    data.dns = (uint32_t)dns;
+    data.crc = calcCRC(data);
+    if(_valid && memcmp(&data, &_data, sizeof(data)) == 0) return true;
+
+    File file = LittleFS.open(WIFI_CACHE_PATH, "w");
+    if(!file) return false;
+    bool written = file.write((const uint8_t*)&data, sizeof(data)) == sizeof(data);
+    file.close();
+    _data = data;
+    _valid = written;
+    return written;
+}
+
+/**
+ * @brief Delete the cache (e.g. when the one shot connection failed)
+ * 
+ */
+void WiFiCache::clear(){
+    _valid = false;
+    LittleFS.remove(WIFI_CACHE_PATH);
+}
+
+bool WiFiCache::isValid() const{
+    return _valid;
+}
+
+const uint8_t* WiFiCache::getBSSID() const{
+    return _data.bssid;
+}
+
+uint8_t WiFiCache::getChannel() const{
+    return _data.channel;
+}
+
+IPAddress WiFiCache::getIP() const{
+    return IPAddress(_data.ip);
+}
+
+IPAddress WiFiCache::getGateway() const{
+    return IPAddress(_data.gateway);
+}
+
+IPAddress WiFiCache::getSubnet() const{
+    return IPAddress(_data.subnet);
+}
+
+IPAddress WiFiCache::getDNS() const{
+    return IPAddress(_data.dns);
+}
+
+/**
+ * @brief (private) CRC32 of the data without the crc field
+ * 
+ */
+uint32_t WiFiCache::calcCRC(const WiFiCacheData &data) const{
+    return crc32(&data, offsetof(WiFiCacheData, crc));
+}
@@ -0,0 +1,52 @@
+/**
+ * @file wificache.h
+ * @brief Cache of the last WiFi connection (BSSID, channel, IP configuration) for a fast boot
+ * 
+ * With the cached data the station connects in one shot: no scan for the access point and 
+ * no DHCP exchange. The data is stored CRC32 checked in a small LittleFS file and only 
+ * written when it changes.
+ */
+
+#ifndef wificache_h
+#define wificache_h
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#define WIFI_CACHE_PATH "/wifi.cache"
+#define WIFI_CACHE_MAGIC 0x57494643         // "WIFC"
+
+struct WiFiCacheData {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t crc;                           // CRC32 of all previous bytes
+};
+
+class WiFiCache{
+
+    public:
+        bool load();
+        bool save(const uint8_t* bssid, uint8_t channel, IPAddress ip, IPAddress gateway, IPAddress subnet, IPAddress dns);
+        void clear();
+        bool isValid() const;
+        const uint8_t* getBSSID() const;
+        uint8_t getChannel() const;
+        IPAddress getIP() const;
+        IPAddress getGateway() const;
+        IPAddress getSubnet() const;
+        IPAddress getDNS() const;
+
+    private:
+        uint32_t calcCRC(const WiFiCacheData &data) const;
+
+        WiFiCacheData _data = {};
+        bool _valid = false;
+};
+
+#endif
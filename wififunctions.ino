@@ -0,0 +1,149 @@
+/**
+ * @file wififunctions.ino
+ * @brief WiFi connection without blocking the boot: one shot connection with the cached
+ * data of the last connection (see wificache.h), fallback to the normal connection and
+ * the WiFi setup portal of the WiFiManager in the background.
+ */
+
+#define WIFI_CONNECT_FAST 0         // one shot connection with BSSID, channel and static IP of the cache
+#define WIFI_CONNECT_NORMAL 1       // scan for the SSID and DHCP
+
+WiFiCache wifiCache;
+uint8_t wifiConnectMode = WIFI_CONNECT_NORMAL;
+unsigned long wifiConnectStart = 0;     // start of the current connection attempt (or of the disconnection)
+bool wifiConnected = false;
+bool wifiEverConnected = false;
+
+/**
+ * @brief Start the connection with the credentials stored by the WiFiManager, returns
+ * immediately. The connection is checked by taskWiFi(). LittleFS has to be mounted.
+ *
+ */
+void startWiFi(){
+  WiFi.mode(WIFI_STA);
+  WiFi.hostname(hostname);
+  WiFi.setAutoReconnect(true);
+  wifiConnectStart = millis();
+
+  String ssid = WiFi.SSID();
+  if(ssid.length() == 0){
+    // not configured yet
+    startWiFiPortal();
+    return;
+  }
+
+  if(FASTBOOT_ENABLED && wifiCache.load()){
+    wifiConnectMode = WIFI_CONNECT_FAST;
+    WiFi.config(wifiCache.getIP(), wifiCache.getGateway(), wifiCache.getSubnet(), wifiCache.getDNS());
+    // BSSID and channel only for this connection, the stored station config stays unchanged
+    WiFi.persistent(false);
+    WiFi.begin(ssid.c_str(), WiFi.psk().c_str(), wifiCache.getChannel(), wifiCache.getBSSID());
+    WiFi.persistent(true);
+    logger.logf(LOG_INFO, "WiFi: fast connect to %s, channel %u", ssid.c_str(), wifiCache.getChannel());
+  }
+  else{
+    startWiFiNormal();
+  }
+}
+
+/**
+ * @brief (Re)start the normal connection: scan for the stored SSID and DHCP
+ *
+ */
+void startWiFiNormal(){
+  wifiConnectMode = WIFI_CONNECT_NORMAL;
+  wifiConnectStart = millis();
+  WiFi.config(INADDR_ANY, INADDR_ANY, INADDR_ANY);
+  WiFi.begin();
+  logger.logf(LOG_INFO, "WiFi: connect to %s", WiFi.SSID().c_str());
+}
+
+/**
+ * @brief Start the WiFi setup portal of the WiFiManager without blocking, it is handled by taskWiFi()
+ *
+ */
+void startWiFiPortal(){
+  wifiManager.setHostname(hostname);
+  wifiManager.setConfigPortalBlocking(false);
+  wifiManager.startConfigPortal(AP_SSID);
+  logger.logf(LOG_INFO, "WiFi: setup portal %s started", AP_SSID);
+}
+
+/**
+ * @brief Task: check the WiFi connection. A failed fast connection falls back to the normal
+ * connection, if there was no connection since boot the setup portal is started after
+ * WIFI_CONNECT_TIMEOUT. Later disconnections are handled by the auto reconnect of the SDK.
+ *
+ */
+void taskWiFi(){
+  if(wifiManager.getConfigPortalActive()){
+    wifiManager.process();
+  }
+
+  if(WiFi.status() == WL_CONNECTED){
+    if(!wifiConnected){
+      wifiConnected = true;
+      handleWiFiConnected();
+    }
+    return;
+  }
+
+  if(wifiConnected){
+    wifiConnected = false;
+    wifiConnectStart = millis();
+    logger.logf(LOG_WARN, "WiFi: connection lost");
+  }
+
+  // short timeout for the fast connection at boot only, a reconnection after a lost connection may take longer
+  unsigned long timeout = (wifiConnectMode == WIFI_CONNECT_FAST && !wifiEverConnected) ? FASTBOOT_CONNECT_TIMEOUT : WIFI_CONNECT_TIMEOUT;
+  if(millis() - wifiConnectStart < timeout){
+    return;
+  }
+  if(wifiConnectMode == WIFI_CONNECT_FAST){
+    // access point, channel or IP configuration changed
+    logger.logf(LOG_WARN, "WiFi: fast connect failed, cache dropped");
+    wifiCache.clear();
+    startWiFiNormal();
+  }
+  else if(!wifiEverConnected && !wifiManager.getConfigPortalActive()){
+    startWiFiPortal();
+  }
+}
+
+/**
+ * @brief Start everything which needs the network, called by taskWiFi() on every connection
+ *
+ */
+void handleWiFiConnected(){
+  logger.begin(WiFi.localIP(), logMulticastIP, logMulticastPort);
+  logger.logf(LOG_INFO, "WiFi: connected to %s (%s), channel %d, IP: %s, after %lu ms since boot", WiFi.SSID().c_str(),
+                wifiConnectMode == WIFI_CONNECT_FAST ? "fast" : "normal", WiFi.channel(), WiFi.localIP().toString().c_str(), millis());
+
+  if(wifiManager.getConfigPortalActive()){
+    wifiManager.stopConfigPortal();
+  }
+  if(wifiConnectMode == WIFI_CONNECT_NORMAL && FASTBOOT_ENABLED){
+    // only written if something changed
+    if(!wifiCache.save(WiFi.BSSID(), WiFi.channel(), WiFi.localIP(), WiFi.gatewayIP(), WiFi.subnetMask(), WiFi.dnsIP())){
+      logger.logf(LOG_WARN, "WiFi: writing the connection cache failed");
+    }
+  }
+
+  if(!wifiEverConnected){
+    wifiEverConnected = true;
+    setupOTA(hostname);
+    // DNS-SD: webserver and the multicast protocols (time beacons, fleet configuration, see fleet.h)
+    MDNS.addService("http", "tcp", HTTPPort);
+    MDNS.addService("ringclock", "udp", logMulticastPort);
+    MDNS.addServiceTxt("ringclock", "udp", "multicast", logMulticastIP.toString().c_str());
+    logStartupInfo();
+    if(bootShowIP){
+      startIPDisplay();
+    }
+  }
+
+  // first (or next) NTP update now
+  if(!ntp.isUpdatePending()){
+    scheduler.runTaskNow(taskIdNTPUpdate);
+  }
+}